@@ -0,0 +1,133 @@
+/*
+ * Time taken by iniparser_dump_ini() on a file with many sections.
+ *
+ * Loads an ini file, dumps it with iniparser_dump_ini() and with the
+ * former implementation, which looked up every section with a scan of
+ * the whole dictionary, checks that both outputs are identical and
+ * prints their timings. The former implementation is quadratic in the
+ * number of sections, iniparser_dump_ini() should stay linear.
+ *
+ * Generate the input with example/twisted-gensections.py.
+ *
+ * Usage: bench_dump [twisted-sections.ini]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iniparser.h"
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void escape_value(char *escaped, const char *value)
+{
+    char c;
+
+    if (!value)
+        return;
+    while ((c = *value++) != '\0') {
+        if (c == '\\' || c == '"')
+            *escaped++ = '\\';
+        *escaped++ = c;
+    }
+    *escaped = '\0';
+}
+
+/* iniparser_dump_ini() as it was, one full scan per section */
+static void dump_ini_scan(const dictionary *d, FILE *f)
+{
+    static char escaped[2 * 1024 + 2];
+    static char keym[1024 + 1];
+    size_t i, j, seclen;
+
+    for (i = 0; i < d->size; i++) {
+        if (d->key[i] == NULL || strchr(d->key[i], ':') != NULL)
+            continue;
+        /* Section found: find its keys */
+        seclen = strlen(d->key[i]);
+        fprintf(f, "\n[%s]\n", d->key[i]);
+        sprintf(keym, "%s:", d->key[i]);
+        for (j = 0; j < d->size; j++) {
+            if (d->key[j] == NULL)
+                continue;
+            if (!strncmp(d->key[j], keym, seclen + 1)) {
+                escaped[0] = '\0';
+                escape_value(escaped, d->val[j]);
+                fprintf(f, "%-30s = \"%s\"\n", d->key[j] + seclen + 1, escaped);
+            }
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "\n");
+}
+
+static char *slurp(FILE *f, long *len)
+{
+    char *buf;
+
+    *len = ftell(f);
+    rewind(f);
+    buf = malloc(*len + 1);
+    if (buf && fread(buf, 1, *len, f) != (size_t)*len) {
+        free(buf);
+        buf = NULL;
+    }
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = argc > 1 ? argv[1] : "twisted-sections.ini";
+    dictionary *d;
+    FILE *out, *ref;
+    char *out_buf, *ref_buf;
+    long out_len, ref_len;
+    double t, t_dump, t_scan;
+
+    d = iniparser_load(name);
+    if (!d) {
+        fprintf(stderr, "cannot load %s, generate it with "
+                "example/twisted-gensections.py\n", name);
+        return 1;
+    }
+    out = tmpfile();
+    ref = tmpfile();
+    if (!out || !ref) {
+        fprintf(stderr, "cannot create temporary files\n");
+        return 1;
+    }
+
+    t = now_s();
+    iniparser_dump_ini(d, out);
+    t_dump = now_s() - t;
+    t = now_s();
+    dump_ini_scan(d, ref);
+    t_scan = now_s() - t;
+
+    printf("%d sections, %u entries\n", iniparser_getnsec(d), d->n);
+    printf("iniparser_dump_ini: %10.2f ms\n", t_dump * 1e3);
+    printf("full scan per section: %7.2f ms\n", t_scan * 1e3);
+
+    out_buf = slurp(out, &out_len);
+    ref_buf = slurp(ref, &ref_len);
+    if (!out_buf || !ref_buf || out_len != ref_len
+        || memcmp(out_buf, ref_buf, out_len)) {
+        fprintf(stderr, "outputs differ\n");
+        return 1;
+    }
+    printf("outputs are identical (%ld bytes)\n", out_len);
+
+    free(out_buf);
+    free(ref_buf);
+    fclose(out);
+    fclose(ref);
+    iniparser_freedict(d);
+    return 0;
+}
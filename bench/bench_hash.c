@@ -0,0 +1,160 @@
+/*
+ * Throughput and quality of dictionary_hash().
+ *
+ * Builds corpora of realistic "section:key" strings and compares the
+ * current dictionary hash against the Jenkins one-at-a-time function
+ * used previously: hashing throughput, number of full 32-bit collisions,
+ * and average probe count in a half-full linear probing table like the
+ * dictionary index.
+ *
+ * Usage: bench_hash [number of keys per corpus]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dictionary.h"
+
+typedef unsigned (*hash_fn)(const char *key, size_t len);
+
+/* Jenkins one-at-a-time, the former dictionary_hash() */
+static unsigned hash_oaat(const char *key, size_t len)
+{
+    unsigned hash;
+    size_t i;
+
+    for (hash = 0, i = 0; i < len; i++) {
+        hash += (unsigned)key[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return hash;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_unsigned(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *)a;
+    unsigned y = *(const unsigned *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void run(const char *corpus, const char *name, hash_fn fn,
+                char **keys, size_t *lens, size_t n)
+{
+    unsigned *h = malloc(n * sizeof *h);
+    unsigned *table;
+    size_t i, pos, isize, mask, rounds, bytes = 0, collisions = 0;
+    double t, probes = 0;
+    volatile unsigned sink = 0;
+
+    for (i = 0; i < n; i++)
+        bytes += lens[i];
+    /* Throughput: hash the corpus over and over for a while */
+    rounds = 0;
+    t = now_s();
+    do {
+        for (i = 0; i < n; i++)
+            sink += fn(keys[i], lens[i]);
+        rounds++;
+    } while (now_s() - t < 0.5);
+    t = now_s() - t;
+
+    /* Full 32-bit collisions */
+    for (i = 0; i < n; i++)
+        h[i] = fn(keys[i], lens[i]);
+    qsort(h, n, sizeof *h, cmp_unsigned);
+    for (i = 1; i < n; i++)
+        collisions += (h[i] == h[i - 1]);
+
+    /* Average probes in a half-full linear probing table */
+    for (isize = 1; isize < 2 * n; isize <<= 1)
+        ;
+    mask = isize - 1;
+    table = calloc(isize, sizeof *table);
+    for (i = 0; i < n; i++) {
+        for (pos = fn(keys[i], lens[i]) & mask; table[pos]; pos = (pos + 1) & mask)
+            probes++;
+        table[pos] = 1;
+        probes++;
+    }
+
+    printf("%-14s %-10s %9.1f MB/s %8.2f ns/key %6lu collisions %6.3f probes/key\n",
+           corpus, name, bytes * rounds / t / 1e6, t * 1e9 / (rounds * n),
+           (unsigned long)collisions, probes / n);
+    free(table);
+    free(h);
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *words[] = {
+        "server", "timeout", "port", "host", "db", "cache", "user",
+        "password", "max_connections", "log", "level", "path", "enabled",
+        "retry", "backoff", "tls", "cert", "feature", "flag", "pool"
+    };
+    static const char *names[3] = { "genhuge", "words", "feature-flags" };
+    const size_t nwords = sizeof(words) / sizeof(words[0]);
+    size_t n = 100000, i, c;
+    char **keys;
+    size_t *lens;
+    char buf[256];
+
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+    keys = malloc(n * sizeof *keys);
+    lens = malloc(n * sizeof *lens);
+    if (!keys || !lens) {
+        fprintf(stderr, "allocation failure\n");
+        return 1;
+    }
+
+    for (c = 0; c < 3; c++) {
+        const char *corpus = names[c];
+
+        for (i = 0; i < n; i++) {
+            switch (c) {
+            case 0:
+                /* twisted-genhuge.py style: [000] key-000 */
+                sprintf(buf, "%03lu:key-%03lu", (unsigned long)(i / 100),
+                        (unsigned long)(i % 100));
+                break;
+            case 1:
+                /* Short words combined into sections and keys */
+                sprintf(buf, "%s.%lu:%s_%s", words[i % nwords],
+                        (unsigned long)(i / (nwords * nwords)),
+                        words[(i / nwords) % nwords], words[(i * 7) % nwords]);
+                break;
+            default:
+                /* Long generated feature flag names */
+                sprintf(buf, "features.%s.%s:flag_%08lx_rollout_percentage",
+                        words[i % nwords], words[(i / nwords) % nwords],
+                        (unsigned long)i);
+                break;
+            }
+            lens[i] = strlen(buf);
+            keys[i] = malloc(lens[i] + 1);
+            memcpy(keys[i], buf, lens[i] + 1);
+        }
+        run(corpus, "oaat", hash_oaat, keys, lens, n);
+        run(corpus, "dictionary", dictionary_hash_n, keys, lens, n);
+        for (i = 0; i < n; i++)
+            free(keys[i]);
+    }
+    free(keys);
+    free(lens);
+    return 0;
+}
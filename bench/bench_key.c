@@ -0,0 +1,80 @@
+/*
+ * Lookups through compiled keys against lookups through key strings.
+ *
+ * Fills a dictionary like a large ini file would, then looks up a small
+ * set of hot keys over and over, as request handlers reading their
+ * configuration do, with iniparser_getint() and with
+ * iniparser_getint_key() on keys compiled once by iniparser_key_compile().
+ *
+ * Usage: bench_key [number of lookups]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iniparser.h"
+
+#define NHOT    16
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    dictionary *d;
+    iniparser_key *hot_keys[NHOT];
+    char hot[NHOT][64];
+    char key[64];
+    double t0, t_str, t_key;
+    long i, n = 10000000;
+    long sum_str = 0, sum_key = 0;
+
+    if (argc > 1)
+        n = atol(argv[1]);
+    d = dictionary_new(0);
+    if (!d) {
+        fprintf(stderr, "allocation failure\n");
+        return 1;
+    }
+    for (i = 0; i < 100000; i++) {
+        sprintf(key, "section%ld:key%ld", i / 100, i);
+        sprintf(hot[0], "%ld", i);
+        iniparser_set(d, key, hot[0]);
+    }
+    for (i = 0; i < NHOT; i++) {
+        /* Mixed case keys, as found in application code */
+        sprintf(hot[i], "Section%ld:Key%ld", i * 61, i * 6173);
+        hot_keys[i] = iniparser_key_compile(hot[i]);
+        if (!hot_keys[i]) {
+            fprintf(stderr, "allocation failure\n");
+            return 1;
+        }
+    }
+
+    t0 = now_ns();
+    for (i = 0; i < n; i++)
+        sum_str += iniparser_getint(d, hot[i % NHOT], 0);
+    t_str = now_ns() - t0;
+    t0 = now_ns();
+    for (i = 0; i < n; i++)
+        sum_key += iniparser_getint_key(d, hot_keys[i % NHOT], 0);
+    t_key = now_ns() - t0;
+
+    if (sum_str != sum_key) {
+        fprintf(stderr, "results differ\n");
+        return 1;
+    }
+    printf("iniparser_getint:     %6.1f ns per lookup\n", t_str / n);
+    printf("iniparser_getint_key: %6.1f ns per lookup\n", t_key / n);
+
+    for (i = 0; i < NHOT; i++)
+        iniparser_key_free(hot_keys[i]);
+    iniparser_freedict(d);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Load throughput of iniparser_load_opts(), iniparser_load_mmap() and
+ * iniparser_load_buffer().
+ *
+ * Loads an ini file repeatedly with the default options, with
+ * INIPARSER_CASE_SENSITIVE, which does not lowercase sections and keys,
+ * through a memory mapping, on one thread, on 4 threads and with
+ * INIPARSER_LAZY, which only locates the sections, and from a copy of the
+ * file in memory, and prints the throughput of each.
+ *
+ * Generate the input with example/twisted-genhuge.py.
+ *
+ * Usage: bench_load [twisted-massive.ini] [number of loads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "iniparser.h"
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Contents of the file, for load_buffer() */
+static char *data;
+static size_t datalen;
+
+static dictionary *load_buffer(const char *path, const iniparser_options *opts)
+{
+    return iniparser_load_buffer(data, datalen, path, opts);
+}
+
+static int read_data(const char *path, off_t size)
+{
+    FILE *in = fopen(path, "rb");
+
+    if (!in)
+        return -1;
+    data = malloc(size);
+    datalen = data ? fread(data, 1, size, in) : 0;
+    fclose(in);
+    return datalen == (size_t)size ? 0 : -1;
+}
+
+static int bench(const char *name,
+                 dictionary *(*load)(const char *, const iniparser_options *),
+                 const char *path, const iniparser_options *opts,
+                 long runs, off_t size)
+{
+    dictionary *d;
+    double t, best = 0;
+    long i;
+
+    for (i = 0; i < runs; i++) {
+        t = now_s();
+        d = load(path, opts);
+        t = now_s() - t;
+        if (!d) {
+            fprintf(stderr, "cannot load %s\n", path);
+            return -1;
+        }
+        iniparser_freedict(d);
+        if (i == 0 || t < best)
+            best = t;
+    }
+    printf("%-24s %8.1f MB/s %10.3f ms per load\n", name,
+           size / best / 1e6, best * 1e3);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = "twisted-massive.ini";
+    iniparser_options opts;
+    struct stat st;
+    long runs = 200;
+
+    if (argc > 1)
+        path = argv[1];
+    if (argc > 2)
+        runs = atol(argv[2]);
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "cannot stat %s\n", path);
+        return 1;
+    }
+
+    memset(&opts, 0, sizeof(opts));
+    if (bench("default", iniparser_load_opts, path, &opts, runs, st.st_size) != 0)
+        return 1;
+    opts.flags = INIPARSER_CASE_SENSITIVE;
+    if (bench("INIPARSER_CASE_SENSITIVE", iniparser_load_opts, path, &opts, runs,
+              st.st_size) != 0)
+        return 1;
+    opts.flags = 0;
+    if (bench("iniparser_load_mmap", iniparser_load_mmap, path, &opts, runs,
+              st.st_size) != 0)
+        return 1;
+    opts.threads = 4;
+    if (bench("iniparser_load_mmap x4", iniparser_load_mmap, path, &opts, runs,
+              st.st_size) != 0)
+        return 1;
+    opts.threads = 0;
+    opts.flags = INIPARSER_LAZY;
+    if (bench("iniparser_load_mmap lazy", iniparser_load_mmap, path, &opts, runs,
+              st.st_size) != 0)
+        return 1;
+    opts.flags = 0;
+    if (read_data(path, st.st_size) != 0) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    if (bench("iniparser_load_buffer", load_buffer, path, &opts, runs, st.st_size) != 0)
+        return 1;
+    free(data);
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Latency of iniparser_set() while a dictionary grows.
+ *
+ * Inserts keys one at a time into an empty dictionary, timing every call,
+ * and prints latency percentiles for each doubling of the entry count.
+ * With incremental resizing the p99 and maximum latencies should stay
+ * flat as the dictionary grows, instead of spiking on every doubling.
+ *
+ * Usage: bench_set [number of keys]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iniparser.h"
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    dictionary *d;
+    double *lat;
+    double t0, total = 0;
+    long i, n = 1L << 21;
+    long lo, hi;
+    char key[64];
+
+    if (argc > 1)
+        n = atol(argv[1]);
+    lat = malloc(n * sizeof *lat);
+    d = dictionary_new(0);
+    if (!lat || !d) {
+        fprintf(stderr, "allocation failure\n");
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        sprintf(key, "section%ld:key%ld", i / 64, i);
+        t0 = now_ns();
+        iniparser_set(d, key, "value");
+        lat[i] = now_ns() - t0;
+        total += lat[i];
+    }
+
+    printf("%10s %10s %10s %10s %12s\n",
+           "entries", "p50 (ns)", "p99 (ns)", "p99.9", "max (ns)");
+    for (lo = 0, hi = 1024; lo < n; lo = hi, hi *= 2) {
+        if (hi > n)
+            hi = n;
+        qsort(lat + lo, hi - lo, sizeof *lat, cmp_double);
+        printf("%10ld %10.0f %10.0f %10.0f %12.0f\n", hi,
+               lat[lo + (hi - lo) / 2],
+               lat[lo + (hi - lo) * 99 / 100],
+               lat[lo + (hi - lo) * 999 / 1000],
+               lat[hi - 1]);
+    }
+    printf("mean: %.1f ns per insert, final size %lu\n",
+           total / n, (unsigned long)d->size);
+
+    iniparser_freedict(d);
+    free(lat);
+    return 0;
+}
@@ -0,0 +1,11 @@
+# -*- coding: utf-8 -*-
+import os
+import sys
+
+if __name__=="__main__":
+    f=open('twisted-sections.ini', 'w')
+    for i in range(5000):
+        f.write('[section-%04d]\n' % i)
+        for j in range(10):
+            f.write('key-%03d=value %d/%d;\n' % (j, i, j))
+    f.close()
@@ -15,84 +15,1303 @@
  ---------------------------------------------------------------------------*/
 #include "dictionary.h"
 
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /** Minimal allocated number of entries in a dictionary */
 #define DICTMINSZ   128
 
+/** Number of slots migrated by each operation during an incremental resize */
+#define DICTREHASHSTEP  8
+
+/** Minimal allocated number of sections in a dictionary */
+#define DICTMINSEC  16
+
+/** Size of the chunks strings are allocated from in DICTIONARY_ARENA mode */
+#define DICTARENASZ     (64 * 1024)
+
+/** Keys and values shorter than this are stored inline in a cell */
+#define DICTSSOSZ       16
+
+/** Number of cells allocated at once */
+#define DICTCELLPAGE    128
+
+/** Whether a string of a given length is stored inline */
+#define DICTINLINE(len) ((len) < DICTSSOSZ)
+
+/** Whether the *_lower functions fold the case of keys in a dictionary */
+#define DICTFOLD(d)     (!((d)->flags & DICTIONARY_CASE_SENSITIVE))
+
+/**
+  State of an incremental resize.
+
+  When the used part of the storage (entries and holes) reaches 3/4 of
+  its size, a storage twice as large is allocated together with its
+  index, and every subsequent
+  dictionary_set or dictionary_unset migrates DICTREHASHSTEP slots to it,
+  so that no single operation pays for the whole copy. The migration is
+  over before the current storage is full.
+
+  The current storage (d->key, d->val, ...) always holds every entry and
+  remains the one seen by callers. Entries in slots below 'next' are
+  indexed in the new index, the other ones in d->index.
+ */
+struct _dictionary_resize_ {
+    dictionary      to ;    /** New storage and index, n is unused */
+    size_t          next ;  /** Next slot of the current storage to migrate */
+} ;
+
+/**
+  Chunk of memory keys and values are allocated from in DICTIONARY_ARENA
+  mode. Strings are laid out one after the other right after this header
+  and are never freed individually: the whole list of chunks is released
+  at once by dictionary_del(), and space left by overwritten or deleted
+  strings is only reclaimed by dictionary_compact().
+ */
+struct _dictionary_chunk_ {
+    struct _dictionary_chunk_ * next ;  /** Next chunk, or NULL */
+    size_t          size ;  /** Number of bytes available after the header */
+    size_t          used ;  /** Number of bytes already allocated */
+} ;
+
+/**
+  Inline storage for the short key and value of an entry.
+
+  An entry whose key or value is shorter than DICTSSOSZ owns a cell, and
+  its short strings are stored in it instead of being allocated on their
+  own. Cells are allocated DICTCELLPAGE at a time and never move, so that
+  d->key and d->val point into them like they point to any other string.
+  The cell of an entry is found from its key if the key is short, or else
+  from its value.
+ */
+union _dictionary_cell_ {
+    struct {
+        char        key[DICTSSOSZ] ;    /** Short key */
+        char        val[DICTSSOSZ] ;    /** Short value */
+    } s ;
+    union _dictionary_cell_ * next ;    /** Next free cell */
+} ;
+
+/** Page of cells */
+struct _dictionary_cellpage_ {
+    struct _dictionary_cellpage_ * next ;   /** Next page, or NULL */
+    union _dictionary_cell_ cell[DICTCELLPAGE] ; /** Cells of the page */
+} ;
+
 /*---------------------------------------------------------------------------
                             Private functions
  ---------------------------------------------------------------------------*/
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Duplicate a string
-  @param    s String to duplicate
+  @brief    Duplicate a string of known length
+  @param    s   String to duplicate, need not be NUL-terminated
+  @param    len Number of bytes to copy from s
   @return   Pointer to a newly allocated string, to be freed with free()
 
-  This is a replacement for strdup(). This implementation is provided
-  for systems that do not have it.
+  The copy is always NUL-terminated.
  */
 /*--------------------------------------------------------------------------*/
-static char * xstrdup(const char * s)
+static char * xmemdup(const char * s, size_t len)
 {
     char * t ;
-    size_t len ;
-    if (!s)
-        return NULL ;
 
-    len = strlen(s) + 1 ;
-    t = (char*) malloc(len) ;
+    t = (char*) malloc(len + 1) ;
     if (t) {
         memcpy(t, s, len) ;
+        t[len] = '\0' ;
     }
     return t ;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Double the size of the dictionary
-  @param    d Dictionary to grow
+  @brief    Allocate a new arena chunk
+  @param    size Minimal number of bytes the chunk must hold
+  @return   Pointer to the new chunk, or NULL in case of failure
+ */
+/*--------------------------------------------------------------------------*/
+static struct _dictionary_chunk_ * dictionary_chunk_new(size_t size)
+{
+    struct _dictionary_chunk_ * c ;
+
+    if (size < DICTARENASZ)
+        size = DICTARENASZ ;
+    c = (struct _dictionary_chunk_*) malloc(sizeof *c + size);
+    if (c) {
+        c->next = NULL ;
+        c->size = size ;
+        c->used = 0 ;
+    }
+    return c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Duplicate a string of known length into a dictionary
+  @param    d   Dictionary that will own the copy
+  @param    s   String to duplicate, need not be NUL-terminated
+  @param    len Number of bytes to copy from s
+  @return   Pointer to the NUL-terminated copy, or NULL in case of failure
+
+  In DICTIONARY_ARENA mode the copy is bump-allocated from the first
+  chunk of the arena, otherwise it is allocated with malloc().
+ */
+/*--------------------------------------------------------------------------*/
+static char * dictionary_strdup(dictionary * d, const char * s, size_t len)
+{
+    struct _dictionary_chunk_ * c ;
+    char * t ;
+
+    if (!(d->flags & DICTIONARY_ARENA))
+        return xmemdup(s, len) ;
+
+    c = d->arena ;
+    if (c == NULL || c->size - c->used < len + 1) {
+        c = dictionary_chunk_new(len + 1) ;
+        if (c == NULL)
+            return NULL ;
+        if (d->arena && len + 1 > DICTARENASZ / 4) {
+            /* Large string: do not give up the room left in the first chunk */
+            c->next = d->arena->next ;
+            d->arena->next = c ;
+        } else {
+            c->next = d->arena ;
+            d->arena = c ;
+        }
+    }
+    t = (char*)(c + 1) + c->used ;
+    c->used += len + 1 ;
+    memcpy(t, s, len) ;
+    t[len] = '\0' ;
+    return t ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Tell whether a string is borrowed from the attached buffer
+  @param    d   Dictionary
+  @param    s   String of the dictionary
+  @return   1 if s points into d->ext, 0 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_borrowed(const dictionary * d, const char * s)
+{
+    return d->ext != NULL && (uintptr_t)s >= (uintptr_t)d->ext &&
+           (uintptr_t)s - (uintptr_t)d->ext < d->extsize ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release a string owned by a dictionary
+  @param    d   Dictionary owning the string
+  @param    s   String to release, may be NULL
+  @param    len Length of the string
+
+  In DICTIONARY_ARENA mode the space is only accounted for, to be reclaimed
+  by dictionary_compact(). Borrowed strings are left alone.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_strfree(dictionary * d, char * s, size_t len)
+{
+    if (s == NULL || dictionary_borrowed(d, s))
+        return ;
+    if (d->flags & DICTIONARY_ARENA)
+        d->waste += len + 1 ;
+    else
+        free(s) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a list of arena chunks
+  @param    c First chunk of the list
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_chunk_free(struct _dictionary_chunk_ * c)
+{
+    struct _dictionary_chunk_ * next ;
+
+    for ( ; c ; c = next) {
+        next = c->next ;
+        free(c) ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Allocate a cell
+  @param    d Dictionary that will own the cell
+  @return   Pointer to the cell, or NULL in case of failure
+
+  Cells of a new page are handed out in address order, so that the short
+  strings of entries inserted one after the other are contiguous.
+ */
+/*--------------------------------------------------------------------------*/
+static union _dictionary_cell_ * dictionary_cell_new(dictionary * d)
+{
+    struct _dictionary_cellpage_ * page ;
+    union _dictionary_cell_ * c ;
+    size_t i ;
+
+    if (d->freecell == NULL) {
+        page = (struct _dictionary_cellpage_*) malloc(sizeof *page) ;
+        if (page == NULL)
+            return NULL ;
+        page->next = d->cellpages ;
+        d->cellpages = page ;
+        for (i = DICTCELLPAGE ; i > 0 ; i--) {
+            page->cell[i-1].next = d->freecell ;
+            d->freecell = page->cell + i - 1 ;
+        }
+    }
+    c = d->freecell ;
+    d->freecell = c->next ;
+    return c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release a cell
+  @param    d Dictionary owning the cell
+  @param    c Cell to release, may be NULL
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_cell_free(dictionary * d, union _dictionary_cell_ * c)
+{
+    if (c == NULL)
+        return ;
+    c->next = d->freecell ;
+    d->freecell = c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the cell of an entry
+  @param    d Dictionary
+  @param    i Slot of the entry
+  @return   Pointer to the cell, or NULL if neither key nor value is short
+ */
+/*--------------------------------------------------------------------------*/
+static union _dictionary_cell_ * dictionary_cell(const dictionary * d, size_t i)
+{
+    if (DICTINLINE(d->klen[i]))
+        return (union _dictionary_cell_*) d->key[i] ;
+    if (d->val[i] && DICTINLINE(d->vlen[i]))
+        return (union _dictionary_cell_*) (d->val[i] - DICTSSOSZ) ;
+    return NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Store a string in a cell
+  @param    t   Cell member to store the string in
+  @param    s   String, need not be NUL-terminated, may overlap t
+  @param    len Length of s, less than DICTSSOSZ
+  @return   t
+ */
+/*--------------------------------------------------------------------------*/
+static char * dictionary_cell_str(char * t, const char * s, size_t len)
+{
+    memmove(t, s, len) ;
+    t[len] = '\0' ;
+    return t ;
+}
+
+/** Mask of the most significant bit of every byte of a word */
+#define DICTHIBITS  UINT64_C(0x8080808080808080)
+/** Word with every byte set to 1 */
+#define DICTLOBYTES UINT64_C(0x0101010101010101)
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lowercase the ASCII letters among 8 bytes
+  @param    w   Eight bytes loaded from a key
+  @return   w with 'A' to 'Z' replaced by 'a' to 'z'
+
+  Every byte is handled at once: adding a constant to its low 7 bits sets
+  their high bit when the byte is at least 'A', another one when it is
+  above 'Z', and neither addition can carry into the next byte. Bytes
+  with their own high bit set are left alone.
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t dictionary_fold8(uint64_t w)
+{
+    uint64_t low = w & ~DICTHIBITS ;
+    uint64_t ge_a = low + DICTLOBYTES * (0x80 - 'A') ;
+    uint64_t gt_z = low + DICTLOBYTES * (0x80 - 'Z' - 1) ;
+
+    /* 0x80 >> 2 is the difference between 'A' and 'a' */
+    return w | ((ge_a & ~gt_z & ~w & DICTHIBITS) >> 2) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lowercase an ASCII letter
+  @param    c   Byte of a key
+  @return   c, lowercased if it is between 'A' and 'Z'
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned char dictionary_fold1(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Load 8 bytes of a key
+  @param    p       Bytes to load, need not be aligned
+  @param    fold    Whether to lowercase ASCII letters
+  @return   Loaded word
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t dictionary_load8(const unsigned char * p, int fold)
+{
+    uint64_t w ;
+
+    /* memcpy lets the compiler emit a single unaligned load */
+    memcpy(&w, p, sizeof w) ;
+    return fold ? dictionary_fold8(w) : w ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the last bytes of a key that do not fill a word
+  @param    p       First byte after the last full word of the key
+  @param    n       Number of bytes left, less than 8
+  @param    fold    Whether to lowercase ASCII letters
+  @param    tail    Buffer of 8 bytes receiving the folded bytes
+  @return   p, or tail if the bytes were folded
+ */
+/*--------------------------------------------------------------------------*/
+static const unsigned char * dictionary_tail(const unsigned char * p, size_t n,
+                                             int fold, unsigned char * tail)
+{
+    size_t i ;
+
+    if (!fold)
+        return p ;
+    for (i=0 ; i<n ; i++)
+        tail[i] = dictionary_fold1(p[i]) ;
+    return tail ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compare a stored key to a key being looked up
+  @param    stored  Key stored in the dictionary
+  @param    key     Key looked up
+  @param    len     Length of both keys
+  @param    fold    Whether to lowercase ASCII letters of key
+  @return   Non-zero if the keys are equal
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_key_eq(const char * stored, const char * key, size_t len, int fold)
+{
+    const unsigned char * a = (const unsigned char *)stored ;
+    const unsigned char * b = (const unsigned char *)key ;
+
+    if (!fold)
+        return !memcmp(stored, key, len) ;
+    for ( ; len >= 8 ; len -= 8, a += 8, b += 8) {
+        if (dictionary_load8(a, 0) != dictionary_load8(b, 1))
+            return 0 ;
+    }
+    for ( ; len > 0 ; len--, a++, b++) {
+        if (*a != dictionary_fold1(*b))
+            return 0 ;
+    }
+    return 1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lowercase the ASCII letters of a string in place
+  @param    s   String to modify
+  @param    len Length of s
+  @return   s
+ */
+/*--------------------------------------------------------------------------*/
+static char * dictionary_fold_str(char * s, size_t len)
+{
+    size_t i ;
+
+    for (i=0 ; i<len ; i++)
+        s[i] = (char)dictionary_fold1((unsigned char)s[i]) ;
+    return s ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Unkeyed hash of a string (MurmurHash64A)
+  @param    key     Bytes to hash
+  @param    len     Number of bytes to hash
+  @param    fold    Whether to hash the key as if it were lowercased
+  @return   Hash value, see dictionary_hash_n()
+
+  With fold set, the hash of a key is the one of its lowercase form,
+  without having to copy it.
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned dictionary_murmur(const char * key, size_t len, int fold)
+{
+    const uint64_t          m = UINT64_C(0xc6a4a7935bd1e995) ;
+    const int               r = 47 ;
+    const unsigned char   * p = (const unsigned char *)key ;
+    const unsigned char   * end ;
+    unsigned char           tail[8] ;
+    uint64_t                h, k ;
+
+    h = UINT64_C(0x5bd1e9955bd1e995) ^ (len * m) ;
+    end = p + (len & ~(size_t)7) ;
+    /* Two loops, to keep the test of fold out of the plain one */
+    if (fold) {
+        for ( ; p != end ; p += 8) {
+            k = dictionary_load8(p, 1) ;
+            k *= m ;
+            k ^= k >> r ;
+            k *= m ;
+            h ^= k ;
+            h *= m ;
+        }
+    } else {
+        for ( ; p != end ; p += 8) {
+            k = dictionary_load8(p, 0) ;
+            k *= m ;
+            k ^= k >> r ;
+            k *= m ;
+            h ^= k ;
+            h *= m ;
+        }
+    }
+    p = dictionary_tail(p, len & 7, fold, tail) ;
+    switch (len & 7) {
+        case 7: h ^= (uint64_t)p[6] << 48 ; /* fall through */
+        case 6: h ^= (uint64_t)p[5] << 40 ; /* fall through */
+        case 5: h ^= (uint64_t)p[4] << 32 ; /* fall through */
+        case 4: h ^= (uint64_t)p[3] << 24 ; /* fall through */
+        case 3: h ^= (uint64_t)p[2] << 16 ; /* fall through */
+        case 2: h ^= (uint64_t)p[1] << 8 ;  /* fall through */
+        case 1: h ^= (uint64_t)p[0] ;
+                h *= m ;
+    }
+    h ^= h >> r ;
+    h *= m ;
+    h ^= h >> r ;
+    return (unsigned)(h ^ (h >> 32)) ;
+}
+
+#define ROTL64(x, b)    (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                \
+    do {                                                        \
+        v0 += v1 ; v1 = ROTL64(v1, 13) ; v1 ^= v0 ;             \
+        v0 = ROTL64(v0, 32) ;                                   \
+        v2 += v3 ; v3 = ROTL64(v3, 16) ; v3 ^= v2 ;             \
+        v0 += v3 ; v3 = ROTL64(v3, 21) ; v3 ^= v0 ;             \
+        v2 += v1 ; v1 = ROTL64(v1, 17) ; v1 ^= v2 ;             \
+        v2 = ROTL64(v2, 32) ;                                   \
+    } while (0)
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Keyed hash of a string (SipHash-1-3)
+  @param    seed    128-bit secret key
+  @param    key     Bytes to hash
+  @param    len     Number of bytes to hash
+  @param    fold    Whether to hash the key as if it were lowercased
+  @return   64-bit hash value
+
+  SipHash is a keyed pseudo-random function: without the seed, an
+  attacker cannot produce keys whose hashes collide. This is the reduced
+  round variant also used by Python and Rust for their hash tables.
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t siphash13(const uint64_t seed[2], const char * key, size_t len,
+                          int fold)
+{
+    const unsigned char * p = (const unsigned char *)key ;
+    unsigned char tail[8] ;
+    const unsigned char * end = p + (len & ~(size_t)7) ;
+    uint64_t    v0 = UINT64_C(0x736f6d6570736575) ^ seed[0] ;
+    uint64_t    v1 = UINT64_C(0x646f72616e646f6d) ^ seed[1] ;
+    uint64_t    v2 = UINT64_C(0x6c7967656e657261) ^ seed[0] ;
+    uint64_t    v3 = UINT64_C(0x7465646279746573) ^ seed[1] ;
+    uint64_t    b = (uint64_t)len << 56 ;
+    uint64_t    m ;
+
+    for ( ; p != end ; p += 8) {
+        m = dictionary_load8(p, fold) ;
+        v3 ^= m ;
+        SIPROUND ;
+        v0 ^= m ;
+    }
+    p = dictionary_tail(p, len & 7, fold, tail) ;
+    switch (len & 7) {
+        case 7: b |= (uint64_t)p[6] << 48 ; /* fall through */
+        case 6: b |= (uint64_t)p[5] << 40 ; /* fall through */
+        case 5: b |= (uint64_t)p[4] << 32 ; /* fall through */
+        case 4: b |= (uint64_t)p[3] << 24 ; /* fall through */
+        case 3: b |= (uint64_t)p[2] << 16 ; /* fall through */
+        case 2: b |= (uint64_t)p[1] << 8 ;  /* fall through */
+        case 1: b |= (uint64_t)p[0] ;
+    }
+    v3 ^= b ;
+    SIPROUND ;
+    v0 ^= b ;
+    v2 ^= 0xff ;
+    SIPROUND ;
+    SIPROUND ;
+    SIPROUND ;
+    return v0 ^ v1 ^ v2 ^ v3 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Draw a random hash seed
+  @param    seed    Output seed
+
+  The seed is read from /dev/urandom where available. Otherwise it is
+  derived from the clock and from addresses, which is not suitable for
+  cryptography but still unknown to whoever writes the input.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_random_seed(uint64_t seed[2])
+{
+    FILE      * f ;
+    uint64_t    x ;
+    int         i ;
+
+    f = fopen("/dev/urandom", "rb") ;
+    if (f) {
+        i = (fread(seed, sizeof *seed, 2, f) == 2) ;
+        fclose(f) ;
+        if (i)
+            return ;
+    }
+    x = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^ (uint64_t)(size_t)seed ;
+    for (i=0 ; i<2 ; i++) {
+        /* splitmix64 */
+        x += UINT64_C(0x9e3779b97f4a7c15) ;
+        seed[i] = x ;
+        seed[i] = (seed[i] ^ (seed[i] >> 30)) * UINT64_C(0xbf58476d1ce4e5b9) ;
+        seed[i] = (seed[i] ^ (seed[i] >> 27)) * UINT64_C(0x94d049bb133111eb) ;
+        seed[i] ^= seed[i] >> 31 ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Hash a key with the hash function of a dictionary
+  @param    d       Dictionary the key is meant for
+  @param    key     Key to hash
+  @param    len     Length of key
+  @param    fold    Whether to hash the key as if it were lowercased
+  @return   Hash value, as stored in d->hash
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned dictionary_key_hash(const dictionary * d, const char * key, size_t len,
+                                    int fold)
+{
+    uint64_t h ;
+
+    if (!(d->flags & DICTIONARY_SEEDED))
+        return dictionary_murmur(key, len, fold) ;
+    h = siphash13(d->seed, key, len, fold) ;
+    return (unsigned)(h ^ (h >> 32)) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the number of index buckets for a given storage size
+  @param    size Storage size of the dictionary
+  @return   Power of two, at least twice as large as size
+
+  Keeping the index at most half full keeps linear probing sequences short.
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_isize(size_t size)
+{
+    size_t isize = 1 ;
+
+    while (isize < size * 2)
+        isize <<= 1 ;
+    return isize ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Locate a key in a dictionary index
+  @param    d     Dictionary to search
+  @param    index Index to search, d->index or the one of a resize
+  @param    isize Number of buckets in index
+  @param    key   Key to look for
+  @param    len   Length of key
+  @param    hash  Hash value of the key
+  @param    fold  Whether to compare the key as if it were lowercased
+  @return   Position in index
+
+  The returned bucket either holds the slot of the key, or is the empty
+  bucket where the key would be inserted (index[pos] is 0).
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_lookup(const dictionary * d, const unsigned * index,
+                                size_t isize, const char * key, size_t len,
+                                unsigned hash, int fold)
+{
+    size_t      mask = isize - 1 ;
+    size_t      pos ;
+    unsigned    slot ;
+
+    for (pos = hash & mask ; (slot = index[pos]) != 0 ; pos = (pos + 1) & mask) {
+        slot-- ;
+        /* Compare hash and length, then bytes to avoid hash collisions */
+        if (hash == d->hash[slot] && len == d->klen[slot] &&
+            dictionary_key_eq(d->key[slot], key, len, fold))
+            break ;
+    }
+    return pos ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the index bucket holding a key
+  @param    d    Dictionary to search
+  @param    key  Key to look for
+  @param    len  Length of key
+  @param    hash Hash value of the key
+  @param    fold Whether to compare the key as if it were lowercased
+  @return   Pointer to the bucket, or NULL if the key is not in d
+
+  During a resize, the key may be indexed in either index.
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned * dictionary_find(const dictionary * d, const char * key,
+                                  size_t len, unsigned hash, int fold)
+{
+    struct _dictionary_resize_ * r = d->resize ;
+    size_t pos ;
+
+    if (r) {
+        pos = dictionary_lookup(d, r->to.index, r->to.isize, key, len, hash, fold);
+        if (r->to.index[pos])
+            return r->to.index + pos ;
+    }
+    pos = dictionary_lookup(d, d->index, d->isize, key, len, hash, fold);
+    return d->index[pos] ? d->index + pos : NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Add a slot to a dictionary index
+  @param    index Index to modify
+  @param    isize Number of buckets in index
+  @param    hash  Hash value of the key stored in slot
+  @param    slot  Storage slot to add
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_index_add(unsigned * index, size_t isize, unsigned hash, size_t slot)
+{
+    size_t  mask = isize - 1 ;
+    size_t  pos ;
+
+    for (pos = hash & mask ; index[pos] ; pos = (pos + 1) & mask)
+        ;
+    index[pos] = (unsigned)slot + 1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Remove a bucket from a dictionary index
+  @param    d     Dictionary owning the index
+  @param    index Index to modify
+  @param    isize Number of buckets in index
+  @param    pos   Position of the bucket to remove
+
+  The following entries of the probe sequence are shifted back, so that
+  no tombstone is needed. The hash values are read from d->hash, the
+  slots must not have been cleared yet.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_index_del(const dictionary * d, unsigned * index,
+                                 size_t isize, size_t pos)
+{
+    size_t  mask = isize - 1 ;
+    size_t  next, home ;
+
+    index[pos] = 0 ;
+    for (next = (pos + 1) & mask ; index[next] ; next = (next + 1) & mask) {
+        home = d->hash[index[next] - 1] & mask ;
+        /* Leave the entry alone if its home bucket is in (pos, next] */
+        if (pos <= next ? (pos < home && home <= next)
+                        : (pos < home || home <= next))
+            continue ;
+        index[pos] = index[next] ;
+        index[next] = 0 ;
+        pos = next ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Rebuild the index of a dictionary from its storage
+  @param    d Dictionary to index, d->index must be zeroed
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_reindex(dictionary * d)
+{
+    size_t  i ;
+
+    for (i=0 ; i<d->used ; i++) {
+        if (d->key[i]!=NULL)
+            dictionary_index_add(d->index, d->isize, d->hash[i], i);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the length of the section name of a key
+  @param    key Key
+  @param    len Length of key
+  @return   Length of the part of the key before the first colon, or len
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_seclen(const char * key, size_t len)
+{
+    const char * colon = (const char*) memchr(key, ':', len) ;
+
+    return colon ? (size_t)(colon - key) : len ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Look up a section in the section table
+  @param    d    Dictionary to search
+  @param    name Section name
+  @param    len  Length of name
+  @param    hash Hash value of name
+  @param    fold Whether to compare name as if it were lowercased
+  @return   Bucket of d->secindex holding the section, or the empty bucket
+            where it would be inserted
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_section_lookup(const dictionary * d, const char * name,
+                                        size_t len, unsigned hash, int fold)
+{
+    const dictionary_section * sec ;
+    size_t mask = 2 * (size_t)d->secsize - 1 ;
+    size_t pos ;
+
+    for (pos = hash & mask ; d->secindex[pos] ; pos = (pos + 1) & mask) {
+        sec = d->sec + d->secindex[pos] - 1 ;
+        if (sec->hash == hash && sec->len == len && dictionary_key_eq(sec->name, name, len, fold))
+            break ;
+    }
+    return pos ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Resize the section table
+  @param    d       Dictionary to modify
+  @param    secsize New size of the section table, a power of two of at
+                    least d->nsec
   @return   This function returns non-zero in case of failure
  */
 /*--------------------------------------------------------------------------*/
-static int dictionary_grow(dictionary * d)
+static int dictionary_section_resize(dictionary * d, unsigned secsize)
 {
-    char        ** new_val ;
-    char        ** new_key ;
-    unsigned     * new_hash ;
+    dictionary_section * sec ;
+    unsigned  * secindex ;
+    size_t      mask = 2 * (size_t)secsize - 1 ;
+    size_t      pos ;
+    unsigned    i ;
 
-    new_val  = (char**) calloc(d->size * 2, sizeof *d->val);
-    new_key  = (char**) calloc(d->size * 2, sizeof *d->key);
-    new_hash = (unsigned*) calloc(d->size * 2, sizeof *d->hash);
-    if (!new_val || !new_key || !new_hash) {
-        /* An allocation failed, leave the dictionary unchanged */
-        if (new_val)
-            free(new_val);
-        if (new_key)
-            free(new_key);
-        if (new_hash)
-            free(new_hash);
+    secindex = (unsigned*) calloc(2 * (size_t)secsize, sizeof *secindex);
+    if (secindex == NULL)
+        return -1 ;
+    sec = (dictionary_section*) realloc(d->sec, secsize * sizeof *sec);
+    if (sec == NULL) {
+        free(secindex);
         return -1 ;
     }
-    /* Initialize the newly allocated space */
-    memcpy(new_val, d->val, d->size * sizeof(char *));
-    memcpy(new_key, d->key, d->size * sizeof(char *));
-    memcpy(new_hash, d->hash, d->size * sizeof(unsigned));
-    /* Delete previous data */
+    for (i=0 ; i<d->nsec ; i++) {
+        for (pos = sec[i].hash & mask ; secindex[pos] ; pos = (pos + 1) & mask)
+            ;
+        secindex[pos] = i + 1 ;
+    }
+    free(d->secindex);
+    d->sec = sec ;
+    d->secindex = secindex ;
+    d->secsize = secsize ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Double the size of the section table
+  @param    d Dictionary to modify
+  @return   This function returns non-zero in case of failure
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_section_grow(dictionary * d)
+{
+    return dictionary_section_resize(d, d->secsize ? d->secsize * 2 : DICTMINSEC) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the section of a key, creating it if needed
+  @param    d   Dictionary to modify
+  @param    key Key
+  @param    len Length of key
+  @param    fold Whether the key is to be lowercased
+  @return   Section number + 1, or 0 in case of failure
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned dictionary_section_ref(dictionary * d, const char * key, size_t len,
+                                       int fold)
+{
+    dictionary_section * sec ;
+    size_t      seclen = dictionary_seclen(key, len) ;
+    unsigned    hash = dictionary_key_hash(d, key, seclen, fold) ;
+    size_t      pos ;
+
+    if (d->secindex) {
+        pos = dictionary_section_lookup(d, key, seclen, hash, fold) ;
+        if (d->secindex[pos])
+            return d->secindex[pos] ;
+    }
+    if (d->nsec == d->secsize && dictionary_section_grow(d) != 0)
+        return 0 ;
+    sec = d->sec + d->nsec ;
+    memset(sec, 0, sizeof *sec);
+    sec->name = xmemdup(key, seclen) ;
+    if (sec->name == NULL)
+        return 0 ;
+    if (fold)
+        dictionary_fold_str(sec->name, seclen) ;
+    sec->len  = seclen ;
+    sec->hash = hash ;
+    pos = dictionary_section_lookup(d, sec->name, seclen, hash, 0) ;
+    d->secindex[pos] = ++d->nsec ;
+    return d->nsec ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Propagate the section links of a slot to the new storage
+  @param    d Dictionary
+  @param    i Slot whose links were modified
+
+  During an incremental resize, slots that were already migrated are
+  also read from the new storage, which must then be kept up to date.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sync_link(dictionary * d, unsigned i)
+{
+    if (d->resize && i < d->resize->next)
+        d->resize->to.link[i] = d->link[i] ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Add a slot to its section
+  @param    d   Dictionary to modify
+  @param    i   Slot of the new entry
+  @param    ref Section number + 1 as returned by dictionary_section_ref()
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_section_add(dictionary * d, unsigned i, unsigned ref)
+{
+    dictionary_section * sec = d->sec + ref - 1 ;
+
+    d->link[i].sec  = ref - 1 ;
+    d->link[i].next = 0 ;
+    d->link[i].prev = 0 ;
+    if (d->klen[i] == sec->len) {
+        /* The section itself */
+        sec->entry = i + 1 ;
+        sec->next = 0 ;
+        sec->prev = d->seclast ;
+        if (d->seclast)
+            d->sec[d->seclast - 1].next = ref ;
+        else
+            d->secfirst = ref ;
+        d->seclast = ref ;
+        return ;
+    }
+    d->link[i].prev = sec->last ;
+    if (sec->last) {
+        d->link[sec->last - 1].next = i + 1 ;
+        dictionary_sync_link(d, sec->last - 1);
+    } else {
+        sec->first = i + 1 ;
+    }
+    sec->last = i + 1 ;
+    sec->nkeys ++ ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Remove a slot from its section
+  @param    d   Dictionary to modify
+  @param    i   Slot of the entry being deleted
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_section_del(dictionary * d, unsigned i)
+{
+    dictionary_section * sec = d->sec + d->link[i].sec ;
+    dictionary_link    * link = d->link + i ;
+
+    if (sec->entry == i + 1) {
+        /* The section itself */
+        if (sec->prev)
+            d->sec[sec->prev - 1].next = sec->next ;
+        else
+            d->secfirst = sec->next ;
+        if (sec->next)
+            d->sec[sec->next - 1].prev = sec->prev ;
+        else
+            d->seclast = sec->prev ;
+        sec->entry = sec->next = sec->prev = 0 ;
+        return ;
+    }
+    if (link->prev) {
+        d->link[link->prev - 1].next = link->next ;
+        dictionary_sync_link(d, link->prev - 1);
+    } else {
+        sec->first = link->next ;
+    }
+    if (link->next) {
+        d->link[link->next - 1].prev = link->prev ;
+        dictionary_sync_link(d, link->next - 1);
+    } else {
+        sec->last = link->prev ;
+    }
+    sec->nkeys -- ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Allocate the storage and index of a dictionary
+  @param    d    Dictionary to set up, its arrays are overwritten
+  @param    size Number of slots of the storage
+  @return   This function returns non-zero in case of failure
+
+  In case of failure nothing is left allocated.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_alloc(dictionary * d, size_t size)
+{
+    d->size  = size ;
+    d->isize = dictionary_isize(size) ;
+    d->val   = (char**) calloc(size, sizeof *d->val);
+    d->key   = (char**) calloc(size, sizeof *d->key);
+    d->hash  = (unsigned*) calloc(size, sizeof *d->hash);
+    d->klen  = (size_t*) calloc(size, sizeof *d->klen);
+    d->vlen  = (size_t*) calloc(size, sizeof *d->vlen);
+    d->link  = (dictionary_link*) calloc(size, sizeof *d->link);
+    d->index = (unsigned*) calloc(d->isize, sizeof *d->index);
+    if (!d->val || !d->key || !d->hash || !d->klen || !d->vlen || !d->link
+        || !d->index) {
+        free(d->val);
+        free(d->key);
+        free(d->hash);
+        free(d->klen);
+        free(d->vlen);
+        free(d->link);
+        free(d->index);
+        return -1 ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free the storage and index of a dictionary, not the strings
+  @param    d    Dictionary
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_free_arrays(dictionary * d)
+{
     free(d->val);
     free(d->key);
     free(d->hash);
+    free(d->klen);
+    free(d->vlen);
+    free(d->link);
+    free(d->index);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make a dictionary use the storage and index of another one
+  @param    d    Dictionary to modify, its own arrays are freed
+  @param    from Dictionary holding the new arrays
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_take_arrays(dictionary * d, const dictionary * from)
+{
+    dictionary_free_arrays(d);
+    d->size  = from->size ;
+    d->val   = from->val ;
+    d->key   = from->key ;
+    d->hash  = from->hash ;
+    d->klen  = from->klen ;
+    d->vlen  = from->vlen ;
+    d->link  = from->link ;
+    d->index = from->index ;
+    d->isize = from->isize ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy a slot from a storage to another one
+  @param    to   Dictionary to copy to
+  @param    from Dictionary to copy from
+  @param    i    Slot to copy
+
+  Only pointers are copied, the strings are shared.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_copy_slot(dictionary * to, const dictionary * from, size_t i)
+{
+    to->key[i]  = from->key[i] ;
+    to->val[i]  = from->val[i] ;
+    to->hash[i] = from->hash[i] ;
+    to->klen[i] = from->klen[i] ;
+    to->vlen[i] = from->vlen[i] ;
+    to->link[i] = from->link[i] ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start an incremental resize to twice the size of the dictionary
+  @param    d Dictionary to grow
+  @return   This function returns non-zero in case of failure
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_resize_start(dictionary * d)
+{
+    struct _dictionary_resize_ * r ;
+
+    r = (struct _dictionary_resize_*) calloc(1, sizeof *r);
+    if (!r)
+        return -1 ;
+    if (dictionary_alloc(&r->to, d->size * 2) != 0) {
+        /* An allocation failed, leave the dictionary unchanged */
+        free(r);
+        return -1 ;
+    }
+    d->resize = r ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Migrate some slots of a dictionary being resized
+  @param    d     Dictionary being resized
+  @param    steps Maximal number of slots to migrate
+
+  Once every slot has been migrated, the new storage and index replace
+  the ones of the dictionary.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_resize_step(dictionary * d, size_t steps)
+{
+    struct _dictionary_resize_ * r = d->resize ;
+    size_t  mask = d->isize - 1 ;
+    size_t  pos ;
+    size_t  i ;
+
+    for ( ; steps>0 && r->next<d->used ; steps--, r->next++) {
+        i = r->next ;
+        if (d->key[i]==NULL)
+            continue ;
+        dictionary_copy_slot(&r->to, d, i);
+        /* Move the slot from the current index to the new one */
+        for (pos = d->hash[i] & mask ; d->index[pos] != i + 1 ; pos = (pos + 1) & mask)
+            ;
+        dictionary_index_del(d, d->index, d->isize, pos);
+        dictionary_index_add(r->to.index, r->to.isize, d->hash[i], i);
+    }
+    if (r->next < d->used)
+        return ;
+
+    /* Migration is over: switch to the new storage */
+    dictionary_take_arrays(d, &r->to);
+    free(r);
+    d->resize = NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Remove the holes left by deleted entries
+  @param    d Dictionary to pack, must not be resizing
+
+  Entries are moved down over the holes, keeping their order, then the
+  index and the section lists are rebuilt.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_pack(dictionary * d)
+{
+    dictionary_section * sec ;
+    size_t  i, j ;
+    unsigned k ;
+
+    for (i=0, j=0 ; i<d->used ; i++) {
+        if (d->key[i]==NULL)
+            continue ;
+        if (i != j) {
+            d->key[j]  = d->key[i] ;
+            d->val[j]  = d->val[i] ;
+            d->hash[j] = d->hash[i] ;
+            d->klen[j] = d->klen[i] ;
+            d->vlen[j] = d->vlen[i] ;
+            d->link[j] = d->link[i] ;
+            d->key[i]  = NULL ;
+            d->val[i]  = NULL ;
+        }
+        j++ ;
+    }
+    d->used = j ;
+
+    memset(d->index, 0, d->isize * sizeof *d->index);
+    dictionary_reindex(d);
+    for (k=0 ; k<d->nsec ; k++) {
+        sec = d->sec + k ;
+        sec->nkeys = sec->first = sec->last = 0 ;
+        sec->entry = sec->next = sec->prev = 0 ;
+    }
+    d->secfirst = d->seclast = 0 ;
+    for (i=0 ; i<d->used ; i++)
+        dictionary_section_add(d, (unsigned)i, d->link[i].sec + 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Move the entries of a dictionary to a larger storage at once
+  @param    d    Dictionary to grow, not being resized
+  @param    size New number of slots, larger than d->size
+  @return   This function returns non-zero in case of failure
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_grow_to(dictionary * d, size_t size)
+{
+    dictionary  to ;
+
+    if (dictionary_alloc(&to, size) != 0) {
+        /* An allocation failed, leave the dictionary unchanged */
+        return -1 ;
+    }
+    /* Initialize the newly allocated space */
+    memcpy(to.val, d->val, d->used * sizeof *d->val);
+    memcpy(to.key, d->key, d->used * sizeof *d->key);
+    memcpy(to.hash, d->hash, d->used * sizeof *d->hash);
+    memcpy(to.klen, d->klen, d->used * sizeof *d->klen);
+    memcpy(to.vlen, d->vlen, d->used * sizeof *d->vlen);
+    memcpy(to.link, d->link, d->used * sizeof *d->link);
     /* Actually update the dictionary */
-    d->size *= 2 ;
-    d->val = new_val;
-    d->key = new_key;
-    d->hash = new_hash;
+    dictionary_take_arrays(d, &to);
+    dictionary_reindex(d);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Double the size of the dictionary
+  @param    d Dictionary to grow
+  @return   This function returns non-zero in case of failure
+
+  Any incremental resize in progress is completed first, then the whole
+  storage is copied at once.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_grow(dictionary * d)
+{
+    if (d->resize)
+        dictionary_resize_step(d, d->size);
+    return dictionary_grow_to(d, d->size * 2) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Replace the value of an entry
+  @param    d      Dictionary to modify
+  @param    i      Slot of the entry
+  @param    val    New value, need not be NUL-terminated, may be NULL
+  @param    vallen Length of val
+  @param    borrow Whether to borrow val from the attached buffer
+  @return   This function returns non-zero in case of failure
+
+  A short value is stored in the cell of the entry, replacing the former
+  value in place if it was short too. With borrow, a longer value lying
+  in d->ext with room for a terminator after it is NUL-terminated there
+  and not copied. The entry is left unchanged in case of failure.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_set_val(dictionary * d, size_t i, const char * val, size_t vallen,
+                              int borrow)
+{
+    union _dictionary_cell_ * cell = dictionary_cell(d, i) ;
+    char * old = d->val[i] ;
+    size_t oldlen = d->vlen[i] ;
+    char * v = NULL ;
+
+    if (val && DICTINLINE(vallen)) {
+        if (cell == NULL) {
+            cell = dictionary_cell_new(d) ;
+            if (cell == NULL)
+                return -1 ;
+        }
+        v = dictionary_cell_str(cell->s.val, val, vallen) ;
+    } else if (val && borrow && dictionary_borrowed(d, val) &&
+               vallen < d->extsize - (size_t)(val - d->ext)) {
+        v = (char*) val ;
+        v[vallen] = '\0' ;
+    } else if (val) {
+        v = dictionary_strdup(d, val, vallen) ;
+        if (v == NULL)
+            return -1 ;
+    }
+    if (old && !DICTINLINE(oldlen))
+        dictionary_strfree(d, old, oldlen) ;
+    else if (old && !(val && DICTINLINE(vallen)) && !DICTINLINE(d->klen[i]))
+        /* The cell only held the former value */
+        dictionary_cell_free(d, cell) ;
+    d->val[i] = v ;
+    d->vlen[i] = val ? vallen : 0 ;
     return 0 ;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the value found by a lookup
+  @param    d      Dictionary searched
+  @param    bucket Bucket returned by dictionary_find(), or NULL
+  @param    def    Default value to return if bucket is NULL
+  @param    vallen If not NULL, set to the length of the returned value
+  @return   Value of the entry, or def
+ */
+/*--------------------------------------------------------------------------*/
+static const char * dictionary_value(const dictionary * d, const unsigned * bucket,
+                                     const char * def, size_t * vallen)
+{
+    if (bucket == NULL) {
+        if (vallen)
+            *vallen = def ? strlen(def) : 0 ;
+        return def ;
+    }
+    if (vallen)
+        *vallen = d->vlen[*bucket - 1] ;
+    return d->val[*bucket - 1] ;
+}
+
 /*---------------------------------------------------------------------------
                             Function codes
  ---------------------------------------------------------------------------*/
@@ -102,31 +1321,35 @@ static int dictionary_grow(dictionary * d)
   @param    key     Character string to use for key.
   @return   1 unsigned int on at least 32 bits.
 
-  This hash function has been taken from an Article in Dr Dobbs Journal.
-  This is normally a collision-free function, distributing keys evenly.
-  The key is stored anyway in the struct so that collision can be avoided
-  by comparing the key itself in last resort.
+  This is dictionary_hash_n() applied to the whole string.
  */
 /*--------------------------------------------------------------------------*/
 unsigned dictionary_hash(const char * key)
 {
-    size_t      len ;
-    unsigned    hash ;
-    size_t      i ;
-
     if (!key)
         return 0 ;
+    return dictionary_hash_n(key, strlen(key));
+}
 
-    len = strlen(key);
-    for (hash=0, i=0 ; i<len ; i++) {
-        hash += (unsigned)key[i] ;
-        hash += (hash<<10);
-        hash ^= (hash>>6) ;
-    }
-    hash += (hash <<3);
-    hash ^= (hash >>11);
-    hash += (hash <<15);
-    return hash ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the hash key for a string of known length.
+  @param    key     Character string to use for key, may contain '\0'.
+  @param    len     Number of bytes of key to hash.
+  @return   1 unsigned int on at least 32 bits.
+
+  This is MurmurHash64A by Austin Appleby (public domain), folded to 32
+  bits. The key is consumed 8 bytes at a time with one multiplication per
+  word, which is much faster than byte-oriented hashes on keys of more
+  than a few characters. The key is stored anyway in the struct so that
+  collision can be avoided by comparing the key itself in last resort.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash_n(const char * key, size_t len)
+{
+    if (!key)
+        return 0 ;
+    return dictionary_murmur(key, len, 0) ;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -144,27 +1367,119 @@ dictionary * dictionary_new(size_t size)
 {
     dictionary  *   d ;
 
-    /* If no size was specified, allocate space for DICTMINSZ */
-    if (size<DICTMINSZ) size=DICTMINSZ ;
-
-    d = (dictionary*) calloc(1, sizeof *d) ;
-
+    /* If no size was specified, allocate space for DICTMINSZ */
+    if (size<DICTMINSZ) size=DICTMINSZ ;
+
+    d = (dictionary*) calloc(1, sizeof *d) ;
+
+    if (d) {
+        if (dictionary_alloc(d, size) != 0) {
+            free(d);
+            d = NULL;
+        }
+    }
+    return d ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object using a keyed hash function.
+  @param    size    Optional initial size of the dictionary.
+  @param    seed    16 bytes of secret seed, or NULL for a random one.
+  @return   1 newly allocated dictionary object.
+
+  This function works like dictionary_new(), but the keys are hashed with
+  SipHash-1-3 keyed by the seed instead of dictionary_hash(). Without
+  knowing the seed, nobody can craft keys that collide in the dictionary,
+  so that inserting n keys taken from untrusted input costs O(n) even in
+  the worst case. The keyed hash is slower than dictionary_hash(), use it
+  for dictionaries holding untrusted data.
+
+  If seed is NULL, a random seed is read from the system.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_new_seeded(size_t size, const unsigned char * seed)
+{
+    return dictionary_new_flags(size, DICTIONARY_SEEDED, seed) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object with a combination of modes.
+  @param    size    Optional initial size of the dictionary.
+  @param    flags   Combination of DICTIONARY_* flags.
+  @param    seed    16 bytes of secret seed, or NULL for a random one.
+                    Only used with DICTIONARY_SEEDED.
+  @return   1 newly allocated dictionary object.
+
+  With DICTIONARY_SEEDED, keys are hashed as in dictionary_new_seeded().
+
+  With DICTIONARY_ARENA, keys and values are copied into large chunks of
+  memory instead of being allocated one by one, which makes building and
+  deleting a dictionary holding many entries much cheaper. Overwritten
+  and deleted strings keep their space until dictionary_compact() is
+  called.
+
+  With DICTIONARY_CASE_SENSITIVE, the *_lower functions do not fold the
+  case of keys.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_new_flags(size_t size, unsigned flags, const unsigned char * seed)
+{
+    dictionary  *   d ;
+
+    d = dictionary_new(size) ;
     if (d) {
-        d->size = size ;
-        d->val  = (char**) calloc(size, sizeof *d->val);
-        d->key  = (char**) calloc(size, sizeof *d->key);
-        d->hash = (unsigned*) calloc(size, sizeof *d->hash);
-        if (!d->size || !d->val || !d->hash) {
-            free((void *) d->size);
-            free((void *) d->val);
-            free((void *) d->hash);
-            free(d);
-            d = NULL;
+        d->flags = flags ;
+        if (flags & DICTIONARY_SEEDED) {
+            if (seed)
+                memcpy(d->seed, seed, sizeof d->seed) ;
+            else
+                dictionary_random_seed(d->seed) ;
         }
     }
     return d ;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room in a dictionary for entries about to be added.
+  @param    d       Dictionary to modify.
+  @param    n       Number of entries to add, sections included.
+  @param    nsec    Number of sections among them.
+  @return   int 0 if Ok, -1 otherwise.
+
+  The storage is doubled, at once, until adding n entries keeps it below
+  the load factor at which dictionary_set() starts a resize.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_reserve(dictionary * d, size_t n, unsigned nsec)
+{
+    size_t      size ;
+    unsigned    secsize ;
+
+    if (d==NULL || n > ((size_t)-1) / 4 - d->used)
+        return -1 ;
+    if (d->resize)
+        dictionary_resize_step(d, d->size);
+    for (size = d->size ; (d->used + n) * 4 > size * 3 ; size *= 2) {
+        if (size > ((size_t)-1) / 6)
+            return -1 ;
+    }
+    if (size > d->size && dictionary_grow_to(d, size) != 0)
+        return -1 ;
+    if (nsec == 0)
+        return 0 ;
+    if (nsec > UINT_MAX / 2 - d->nsec)
+        return -1 ;
+    for (secsize = d->secsize ? d->secsize : DICTMINSEC ; secsize < d->nsec + nsec ;
+         secsize *= 2)
+        ;
+    if (secsize > d->secsize && dictionary_section_resize(d, secsize) != 0)
+        return -1 ;
+    return 0 ;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Delete a dictionary object
@@ -176,18 +1491,38 @@ dictionary * dictionary_new(size_t size)
 /*--------------------------------------------------------------------------*/
 void dictionary_del(dictionary * d)
 {
+    struct _dictionary_cellpage_ * page ;
     size_t  i ;
 
     if (d==NULL) return ;
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]!=NULL)
-            free(d->key[i]);
-        if (d->val[i]!=NULL)
-            free(d->val[i]);
+    if (d->flags & DICTIONARY_ARENA) {
+        dictionary_chunk_free(d->arena);
+    } else {
+        for (i=0 ; i<d->used ; i++) {
+            if (d->key[i]!=NULL && !DICTINLINE(d->klen[i]))
+                free(d->key[i]);
+            if (d->val[i]!=NULL && !DICTINLINE(d->vlen[i]) &&
+                !dictionary_borrowed(d, d->val[i]))
+                free(d->val[i]);
+        }
     }
-    free(d->val);
-    free(d->key);
-    free(d->hash);
+    if (d->lazyfree)
+        d->lazyfree(d->lazy);
+    if (d->extfree)
+        d->extfree(d->ext, d->extsize);
+    while ((page = d->cellpages) != NULL) {
+        d->cellpages = page->next ;
+        free(page);
+    }
+    dictionary_free_arrays(d);
+    if (d->resize) {
+        dictionary_free_arrays(&d->resize->to);
+        free(d->resize);
+    }
+    for (i=0 ; i<d->nsec ; i++)
+        free(d->sec[i].name);
+    free(d->sec);
+    free(d->secindex);
     free(d);
     return ;
 }
@@ -208,25 +1543,96 @@ void dictionary_del(dictionary * d)
 /*--------------------------------------------------------------------------*/
 const char * dictionary_get(const dictionary * d, const char * key, const char * def)
 {
-    unsigned    hash ;
-    size_t      i ;
-
     if(d == NULL || key == NULL)
        return def ;
 
-    hash = dictionary_hash(key);
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        /* Compare hash */
-        if (hash==d->hash[i]) {
-            /* Compare string, to avoid hash collisions */
-            if (!strcmp(key, d->key[i])) {
-                return d->val[i] ;
-            }
-        }
+    return dictionary_get_n(d, key, strlen(key), def, NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, with a key of known length.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned value.
+  @return   1 pointer to internally allocated character string.
+
+  This function works like dictionary_get(), but the key is given by
+  a pointer and a length, so that it can be a slice of a larger buffer,
+  and the length of the value is returned without scanning it. If the
+  key is not found, vallen is set to the length of def, or to 0 if def
+  is NULL. It is also set to 0 if the key is found with a NULL value.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_n(const dictionary * d, const char * key, size_t keylen,
+                              const char * def, size_t * vallen)
+{
+    const unsigned * bucket = NULL ;
+
+    if (d != NULL && key != NULL)
+        bucket = dictionary_find(d, key, keylen, dictionary_key_hash(d, key, keylen, 0), 0);
+    return dictionary_value(d, bucket, def, vallen);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, ignoring the case of the key.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned value.
+  @return   1 pointer to internally allocated character string.
+
+  This function works like dictionary_get_n() called with key converted
+  to lowercase: ASCII letters are folded while the key is hashed and
+  compared, so that the key is neither copied nor limited in length.
+  Only keys stored in lowercase can be found this way. In a dictionary
+  created with DICTIONARY_CASE_SENSITIVE, the key is not folded and this
+  function works exactly like dictionary_get_n().
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_lower(const dictionary * d, const char * key, size_t keylen,
+                                  const char * def, size_t * vallen)
+{
+    const unsigned * bucket = NULL ;
+
+    if (d != NULL && key != NULL)
+        bucket = dictionary_find(d, key, keylen,
+                                 dictionary_key_hash(d, key, keylen, DICTFOLD(d)), DICTFOLD(d));
+    return dictionary_value(d, bucket, def, vallen);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, with a precomputed key hash.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    hash    dictionary_hash_n(key, keylen).
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned value.
+  @return   1 pointer to internally allocated character string.
+
+  This function works like dictionary_get_n(), but does not hash the key,
+  which is useful when the same key is looked up many times. Dictionaries
+  created with DICTIONARY_SEEDED do not use dictionary_hash_n(): for them
+  the hash argument is ignored and the key is hashed as usual.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_hashed(const dictionary * d, const char * key, size_t keylen,
+                                   unsigned hash, const char * def, size_t * vallen)
+{
+    const unsigned * bucket = NULL ;
+
+    if (d != NULL && key != NULL) {
+        if (d->flags & DICTIONARY_SEEDED)
+            hash = dictionary_key_hash(d, key, keylen, 0) ;
+        bucket = dictionary_find(d, key, keylen, hash, 0);
     }
-    return def ;
+    return dictionary_value(d, bucket, def, vallen);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -257,52 +1663,316 @@ const char * dictionary_get(const dictionary * d, const char * key, const char *
 /*--------------------------------------------------------------------------*/
 int dictionary_set(dictionary * d, const char * key, const char * val)
 {
-    size_t         i ;
-    unsigned       hash ;
-
     if (d==NULL || key==NULL) return -1 ;
 
-    /* Compute hash for this key */
-    hash = dictionary_hash(key) ;
+    return dictionary_set_n(d, key, strlen(key), val, val ? strlen(val) : 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, with the hash of its key
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    hash    dictionary_key_hash(d, key, keylen, fold)
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @param    fold    Whether to lowercase the key
+  @param    borrow  Whether to borrow val from the attached buffer
+  @return   int     0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_set_hash(dictionary * d, const char * key, size_t keylen,
+                               unsigned hash, const char * val, size_t vallen,
+                               int fold, int borrow)
+{
+    struct _dictionary_resize_ * r ;
+    union _dictionary_cell_ * cell = NULL ;
+    unsigned     * bucket ;
+    size_t         i ;
+    unsigned       ref ;
+
+    if (val==NULL)
+        vallen = 0 ;
+    if (d->resize)
+        dictionary_resize_step(d, DICTREHASHSTEP);
     /* Find if value is already in dictionary */
-    if (d->n>0) {
-        for (i=0 ; i<d->size ; i++) {
-            if (d->key[i]==NULL)
-                continue ;
-            if (hash==d->hash[i]) { /* Same hash value */
-                if (!strcmp(key, d->key[i])) {   /* Same key */
-                    /* Found a value: modify and return */
-                    if (d->val[i]!=NULL)
-                        free(d->val[i]);
-                    d->val[i] = (val ? xstrdup(val) : NULL);
-                    /* Value has been modified: return */
-                    return 0 ;
-                }
-            }
-        }
+    bucket = dictionary_find(d, key, keylen, hash, fold) ;
+    if (bucket) {
+        i = *bucket - 1 ;
+        /* Found a value: modify and return */
+        if (dictionary_set_val(d, i, val, vallen, borrow) != 0)
+            return -1 ;
+        if (d->resize && i < d->resize->next)
+            dictionary_copy_slot(&d->resize->to, d, i);
+        /* Value has been modified: return */
+        return 0 ;
     }
     /* Add a new value */
     /* See if dictionary needs to grow */
-    if (d->n==d->size) {
+    if (d->resize==NULL && (d->used + 1) * 4 > d->size * 3) {
+        if (d->n * 2 < d->used) {
+            /* Mostly holes: reuse them rather than growing */
+            dictionary_pack(d);
+        } else {
+            /* Start moving to a larger storage, a few slots at a time */
+            dictionary_resize_start(d);
+        }
+    }
+    if (d->used==d->size) {
         /* Reached maximum size: reallocate dictionary */
         if (dictionary_grow(d) != 0)
             return -1;
     }
+    /* Find or create the section of the key */
+    ref = dictionary_section_ref(d, key, keylen, fold);
+    if (ref==0)
+        return -1 ;
 
-    /* Insert key in the first empty slot. Start at d->n and wrap at
-       d->size. Because d->n < d->size this will necessarily
-       terminate. */
-    for (i=d->n ; d->key[i] ; ) {
-        if(++i == d->size) i = 0;
+    /* Append the new entry, so that entries stay in insertion order */
+    i = d->used ;
+    /* Copy key and value */
+    if (DICTINLINE(keylen)) {
+        cell = dictionary_cell_new(d) ;
+        if (cell==NULL)
+            return -1 ;
+        d->key[i] = dictionary_cell_str(cell->s.key, key, keylen) ;
+    } else {
+        d->key[i] = dictionary_strdup(d, key, keylen) ;
+        if (d->key[i]==NULL) {
+            dictionary_cell_free(d, cell);
+            return -1 ;
+        }
+    }
+    if (fold)
+        dictionary_fold_str(d->key[i], keylen) ;
+    d->klen[i] = keylen ;
+    d->val[i]  = NULL ;
+    d->vlen[i] = 0 ;
+    if (val && dictionary_set_val(d, i, val, vallen, borrow) != 0) {
+        if (!DICTINLINE(keylen))
+            dictionary_strfree(d, d->key[i], keylen);
+        dictionary_cell_free(d, cell);
+        d->key[i] = NULL ;
+        d->klen[i] = 0 ;
+        return -1 ;
     }
-    /* Copy key */
-    d->key[i]  = xstrdup(key);
-    d->val[i]  = (val ? xstrdup(val) : NULL) ;
-    d->hash[i] = hash;
+    d->hash[i] = hash ;
+    dictionary_section_add(d, (unsigned)i, ref);
+    r = d->resize ;
+    if (r && i < r->next) {
+        /* Slot already migrated: keep the new storage up to date */
+        dictionary_copy_slot(&r->to, d, i);
+        dictionary_index_add(r->to.index, r->to.isize, hash, i);
+    } else {
+        dictionary_index_add(d->index, d->isize, hash, i);
+    }
+    d->used ++ ;
     d->n ++ ;
     return 0 ;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @param    fold    Whether to lowercase the key
+  @param    borrow  Whether to borrow val from the attached buffer
+  @return   int     0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_set_key(dictionary * d, const char * key, size_t keylen,
+                              const char * val, size_t vallen, int fold, int borrow)
+{
+    if (d==NULL || key==NULL) return -1 ;
+
+    return dictionary_set_hash(d, key, keylen, dictionary_key_hash(d, key, keylen, fold),
+                               val, vallen, fold, borrow);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, with a key and value of known length.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  This function works like dictionary_set(), but the key and value are
+  given by a pointer and a length, so that they can be slices of a larger
+  buffer. The dictionary stores NUL-terminated copies of both.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_n(dictionary * d, const char * key, size_t keylen,
+                     const char * val, size_t vallen)
+{
+    if (d==NULL || key==NULL) return -1 ;
+
+    return dictionary_set_key(d, key, keylen, val, vallen, 0, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, storing the key in lowercase.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  This function works like dictionary_set_n() called with key converted
+  to lowercase, without a temporary copy of the key. The key is used as
+  given in a dictionary created with DICTIONARY_CASE_SENSITIVE.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_lower(dictionary * d, const char * key, size_t keylen,
+                         const char * val, size_t vallen)
+{
+    if (d==NULL || key==NULL) return -1 ;
+
+    return dictionary_set_key(d, key, keylen, val, vallen, DICTFOLD(d), 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary without copying it if possible.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  This function works like dictionary_set_lower(), but a long value lying
+  in the buffer attached with dictionary_attach() is NUL-terminated in
+  place and stored without a copy.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_borrowed(dictionary * d, const char * key, size_t keylen,
+                            char * val, size_t vallen)
+{
+    if (d==NULL || key==NULL) return -1 ;
+
+    return dictionary_set_key(d, key, keylen, val, vallen, DICTFOLD(d), 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Attach a buffer values may be borrowed from.
+  @param    d       dictionary object to modify.
+  @param    buf     Buffer to attach.
+  @param    size    Size of buf.
+  @param    release Function releasing buf in dictionary_del(), may be NULL.
+  @return   int     0 if Ok, -1 if a buffer is already attached.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_attach(dictionary * d, char * buf, size_t size,
+                      void (*release)(char * buf, size_t size))
+{
+    if (d==NULL || buf==NULL || d->ext!=NULL) return -1 ;
+
+    d->ext = buf ;
+    d->extsize = size ;
+    d->extfree = release ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy the entries of a dictionary into another.
+  @param    d       dictionary object to modify.
+  @param    from    Dictionary to copy the entries of.
+  @return   int     0 if Ok, -1 otherwise.
+
+  The entries of from are set in d in their insertion order, as stored in
+  from: keys are not lowercased again. Keys already in d get the value
+  they have in from, other keys are appended. When both dictionaries hash
+  keys alike, the hash values of from are reused instead of hashing its
+  keys again, and values borrowed from a buffer attached to both are
+  borrowed by d too.
+
+  In case of failure, the entries copied so far are kept in d.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_merge(dictionary * d, const dictionary * from)
+{
+    size_t  i ;
+    int     same ;
+    int     borrow ;
+
+    if (d==NULL || from==NULL || d==from) return -1 ;
+
+    same = (d->flags & DICTIONARY_SEEDED) == (from->flags & DICTIONARY_SEEDED) &&
+           (!(d->flags & DICTIONARY_SEEDED) ||
+            memcmp(d->seed, from->seed, sizeof d->seed) == 0) ;
+    borrow = d->ext != NULL && d->ext == from->ext ;
+    for (i = 0 ; i < from->used ; i++) {
+        if (from->key[i] == NULL)
+            continue ;
+        if (dictionary_set_hash(d, from->key[i], from->klen[i],
+                                same ? from->hash[i] :
+                                dictionary_key_hash(d, from->key[i], from->klen[i], 0),
+                                from->val[i], from->vlen[i], 0, borrow) != 0)
+            return -1 ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a dictionary
+  @param    d       dictionary object to modify.
+  @param    key     Key to remove, need not be NUL-terminated.
+  @param    len     Length of key.
+  @param    fold    Whether to look the key up as if it were lowercased
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_unset_key(dictionary * d, const char * key, size_t len, int fold)
+{
+    struct _dictionary_resize_ * r ;
+    unsigned  * bucket ;
+    size_t      i ;
+
+    if (d->resize)
+        dictionary_resize_step(d, DICTREHASHSTEP);
+    bucket = dictionary_find(d, key, len, dictionary_key_hash(d, key, len, fold), fold);
+    if (bucket==NULL)
+        /* Key not found */
+        return ;
+
+    i = *bucket - 1 ;
+    dictionary_section_del(d, (unsigned)i);
+    r = d->resize ;
+    if (r && i < r->next) {
+        dictionary_index_del(d, r->to.index, r->to.isize, bucket - r->to.index);
+        r->to.key[i] = NULL ;
+        r->to.val[i] = NULL ;
+    } else {
+        dictionary_index_del(d, d->index, d->isize, bucket - d->index);
+    }
+    dictionary_cell_free(d, dictionary_cell(d, i));
+    if (!DICTINLINE(d->klen[i]))
+        dictionary_strfree(d, d->key[i], d->klen[i]);
+    d->key[i] = NULL ;
+    if (d->val[i] && !DICTINLINE(d->vlen[i]))
+        dictionary_strfree(d, d->val[i], d->vlen[i]);
+    d->val[i] = NULL ;
+    d->hash[i] = 0 ;
+    d->klen[i] = 0 ;
+    d->vlen[i] = 0 ;
+    d->n -- ;
+    /* Do not keep holes at the end of the entries */
+    while (d->used > 0 && d->key[d->used-1]==NULL)
+        d->used -- ;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Delete a key in a dictionary
@@ -316,39 +1986,161 @@ int dictionary_set(dictionary * d, const char * key, const char * val)
 /*--------------------------------------------------------------------------*/
 void dictionary_unset(dictionary * d, const char * key)
 {
-    unsigned    hash ;
-    size_t      i ;
+    if (key == NULL || d == NULL) {
+        return;
+    }
+
+    dictionary_unset_key(d, key, strlen(key), 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a dictionary, ignoring the case of the key.
+  @param    d       dictionary object to modify.
+  @param    key     Key to remove, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @return   void
 
+  This function works like dictionary_unset() called with key converted
+  to lowercase, without a temporary copy of the key. The key is used as
+  given in a dictionary created with DICTIONARY_CASE_SENSITIVE.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_unset_lower(dictionary * d, const char * key, size_t keylen)
+{
     if (key == NULL || d == NULL) {
         return;
     }
 
-    hash = dictionary_hash(key);
-    for (i=0 ; i<d->size ; i++) {
+    dictionary_unset_key(d, key, keylen, DICTFOLD(d));
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Reclaim the space of overwritten and deleted strings.
+  @param    d       dictionary object to compact.
+  @return   int     0 if Ok, anything else otherwise
+
+  In DICTIONARY_ARENA mode, the space held by values that have been
+  overwritten and by entries that have been deleted is only given back
+  by this function: every live key and value is copied into a new chunk
+  sized to fit them and the old chunks are freed. This invalidates all
+  pointers to keys and values previously returned by the dictionary,
+  except values borrowed from the attached buffer, which stay in place.
+
+  Other dictionaries are left untouched. On failure the dictionary is
+  left unchanged.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_compact(dictionary * d)
+{
+    struct _dictionary_chunk_ * c ;
+    struct _dictionary_chunk_ * old ;
+    size_t  live = 0 ;
+    size_t  i ;
+
+    if (d == NULL)
+        return -1 ;
+    if (!(d->flags & DICTIONARY_ARENA) || d->waste == 0)
+        return 0 ;
+    /* Strings are shared with the new storage: finish the resize first */
+    if (d->resize)
+        dictionary_resize_step(d, d->size);
+
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]==NULL)
             continue ;
-        /* Compare hash */
-        if (hash==d->hash[i]) {
-            /* Compare string, to avoid hash collisions */
-            if (!strcmp(key, d->key[i])) {
-                /* Found key */
-                break ;
-            }
-        }
+        if (!DICTINLINE(d->klen[i]))
+            live += d->klen[i] + 1 ;
+        if (d->val[i] && !DICTINLINE(d->vlen[i]) && !dictionary_borrowed(d, d->val[i]))
+            live += d->vlen[i] + 1 ;
     }
-    if (i>=d->size)
-        /* Key not found */
-        return ;
-
-    free(d->key[i]);
-    d->key[i] = NULL ;
-    if (d->val[i]!=NULL) {
-        free(d->val[i]);
-        d->val[i] = NULL ;
+    c = dictionary_chunk_new(live) ;
+    if (c == NULL)
+        return -1 ;
+    old = d->arena ;
+    d->arena = c ;
+    for (i=0 ; i<d->used ; i++) {
+        if (d->key[i]==NULL)
+            continue ;
+        /* Cannot fail: the chunk is large enough */
+        if (!DICTINLINE(d->klen[i]))
+            d->key[i] = dictionary_strdup(d, d->key[i], d->klen[i]) ;
+        if (d->val[i] && !DICTINLINE(d->vlen[i]) && !dictionary_borrowed(d, d->val[i]))
+            d->val[i] = dictionary_strdup(d, d->val[i], d->vlen[i]) ;
     }
-    d->hash[i] = 0 ;
-    d->n -- ;
-    return ;
+    dictionary_chunk_free(old) ;
+    d->waste = 0 ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find a section in a dictionary
+  @param    d       dictionary object to search.
+  @param    name    Section name, need not be NUL-terminated.
+  @param    len     Length of name.
+  @param    fold    Whether to look the name up as if it were lowercased
+  @return   Pointer to the section, or NULL if it has no key at all.
+ */
+/*--------------------------------------------------------------------------*/
+static const dictionary_section * dictionary_find_section(const dictionary * d,
+                                                          const char * name, size_t len,
+                                                          int fold)
+{
+    const dictionary_section * sec ;
+    size_t pos ;
+
+    if (d == NULL || name == NULL || d->secindex == NULL)
+        return NULL ;
+    pos = dictionary_section_lookup(d, name, len, dictionary_key_hash(d, name, len, fold), fold);
+    if (d->secindex[pos] == 0)
+        return NULL ;
+    sec = d->sec + d->secindex[pos] - 1 ;
+    if (sec->entry == 0 && sec->nkeys == 0)
+        return NULL ;
+    return sec ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find a section in a dictionary.
+  @param    d       dictionary object to search.
+  @param    name    Section name, need not be NUL-terminated.
+  @param    len     Length of name.
+  @return   Pointer to the section, or NULL if it has no key at all.
+
+  The returned section is valid until the next modification of the
+  dictionary. A section may be returned while its own key is not set
+  (dictionary_section::entry is 0), if keys of the form "name:key" were
+  set without it.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_section * dictionary_get_section(const dictionary * d,
+                                                  const char * name, size_t len)
+{
+    return dictionary_find_section(d, name, len, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find a section in a dictionary, ignoring the case of its name.
+  @param    d       dictionary object to search.
+  @param    name    Section name, need not be NUL-terminated.
+  @param    len     Length of name.
+  @return   Pointer to the section, or NULL if it has no key at all.
+
+  This function works like dictionary_get_section() called with name
+  converted to lowercase, without a temporary copy of the name. The name
+  is used as given in a dictionary created with DICTIONARY_CASE_SENSITIVE.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_section * dictionary_get_section_lower(const dictionary * d,
+                                                        const char * name, size_t len)
+{
+    if (d == NULL)
+        return NULL ;
+    return dictionary_find_section(d, name, len, DICTFOLD(d));
 }
 
 /*-------------------------------------------------------------------------*/
@@ -372,7 +2164,7 @@ void dictionary_dump(const dictionary * d, FILE * out)
         fprintf(out, "empty dictionary\n");
         return ;
     }
-    for (i=0 ; i<d->size ; i++) {
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]) {
             fprintf(out, "%20s\t[%s]\n",
                     d->key[i],
@@ -18,6 +18,7 @@
                                 Includes
  ---------------------------------------------------------------------------*/
 
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -28,6 +29,47 @@ extern "C" {
                                 New types
  ---------------------------------------------------------------------------*/
 
+/** Flag set in dictionary::flags when keys are hashed with a secret seed */
+#define DICTIONARY_SEEDED   0x1
+/** Flag set in dictionary::flags when keys and values live in an arena */
+#define DICTIONARY_ARENA    0x2
+/** Flag set in dictionary::flags when the *_lower functions keep key case */
+#define DICTIONARY_CASE_SENSITIVE   0x4
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Section of a dictionary
+
+  Keys are grouped by section, the section of a key being the part before
+  its first colon, so that "section:key" belongs to the section "section".
+  A key without colon is the section itself. Each section keeps the list
+  of its keys in insertion order, so that the keys of a section can be
+  listed without looking at the rest of the dictionary.
+
+  Sections are created by their first key and never removed from the
+  section table. Sections whose own key is set are also linked together
+  in the order they were set.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dictionary_section_ {
+    char        *   name ;  /** Section name, without colon */
+    size_t          len ;   /** Length of name */
+    unsigned        hash ;  /** Hash value of name */
+    unsigned        nkeys ; /** Number of "name:..." keys */
+    unsigned        first ; /** Slot + 1 of the first key of the section, or 0 */
+    unsigned        last ;  /** Slot + 1 of the last key of the section, or 0 */
+    unsigned        entry ; /** Slot + 1 of the key "name" itself, or 0 if not set */
+    unsigned        next ;  /** Index + 1 of the next section set, or 0 */
+    unsigned        prev ;  /** Index + 1 of the previous section set, or 0 */
+} dictionary_section ;
+
+/** Position of an entry in the key list of its section */
+typedef struct _dictionary_link_ {
+    unsigned        sec ;   /** Index of the section in dictionary::sec */
+    unsigned        next ;  /** Slot + 1 of the next key of the section, or 0 */
+    unsigned        prev ;  /** Slot + 1 of the previous key of the section, or 0 */
+} dictionary_link ;
+
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -37,6 +79,23 @@ extern "C" {
   association is identified by a unique string key. Looking up values
   in the dictionary is speeded up by the use of a (hopefully collision-free)
   hash function.
+
+  The key, val, hash, klen and vlen arrays hold the entries in insertion
+  order and may be walked directly from 0 to used-1, skipping NULL keys
+  left by deleted entries. These holes are removed when the storage runs
+  out of room. The index array is an open addressing table (linear
+  probing) mapping a hash to the slot holding the entry, so that lookups
+  do not have to scan the whole storage.
+
+  Growing the storage is done incrementally: a few entries are moved to
+  the larger storage on each modification, so that no single insertion
+  pays for copying the whole dictionary.
+
+  The sec array is the section table (see dictionary_section), and link
+  holds the position of each entry in it. Sections that are set may be
+  walked from secfirst following dictionary_section::next, and the keys
+  of a section from dictionary_section::first following
+  dictionary_link::next.
  */
 /*-------------------------------------------------------------------------*/
 typedef struct _dictionary_ {
@@ -45,6 +104,30 @@ typedef struct _dictionary_ {
     char        **  val ;   /** List of string values */
     char        **  key ;   /** List of string keys */
     unsigned     *  hash ;  /** List of hash values for keys */
+    size_t          used ;  /** Number of slots used by entries and holes */
+    size_t       *  klen ;  /** List of key lengths */
+    size_t       *  vlen ;  /** List of value lengths, 0 for NULL values */
+    unsigned     *  index ; /** Hash index: slot number + 1, or 0 if empty */
+    size_t          isize ; /** Number of buckets in index (power of two) */
+    struct _dictionary_resize_ * resize ; /** Ongoing resize, or NULL */
+    unsigned        flags ; /** Combination of DICTIONARY_* flags */
+    uint64_t        seed[2] ; /** Hash seed if DICTIONARY_SEEDED is set */
+    struct _dictionary_chunk_ * arena ; /** Chunks holding the strings if DICTIONARY_ARENA is set */
+    size_t          waste ; /** Bytes of the arena held by released strings */
+    struct _dictionary_cellpage_ * cellpages ; /** Pages of cells holding the short strings */
+    union _dictionary_cell_ * freecell ; /** List of free cells */
+    dictionary_link * link ; /** List of section links of the entries */
+    dictionary_section * sec ; /** Section table */
+    unsigned        nsec ;  /** Number of sections in the section table */
+    unsigned        secsize ; /** Allocated size of the section table */
+    unsigned     *  secindex ; /** Section hash index: section number + 1, or 0 */
+    unsigned        secfirst ; /** Section number + 1 of the first section set, or 0 */
+    unsigned        seclast ; /** Section number + 1 of the last section set, or 0 */
+    char        *   ext ;   /** Buffer values may be borrowed from, or NULL */
+    size_t          extsize ; /** Size of ext */
+    void         (* extfree)(char *, size_t) ; /** Releases ext in dictionary_del(), or NULL */
+    void        *   lazy ;  /** Lazy parsing state of ext kept by its loader, or NULL */
+    void         (* lazyfree)(void *) ; /** Releases lazy in dictionary_del(), or NULL */
 } dictionary ;
 
 
@@ -58,13 +141,30 @@ typedef struct _dictionary_ {
   @param    key     Character string to use for key.
   @return   1 unsigned int on at least 32 bits.
 
-  This hash function has been taken from an Article in Dr Dobbs Journal.
+  This is dictionary_hash_n() applied to the whole string. It returns 0
+  for a NULL key.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash(const char * key);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the hash key for a string of known length.
+  @param    key     Character string to use for key, may contain '\0'.
+  @param    len     Number of bytes of key to hash.
+  @return   1 unsigned int on at least 32 bits.
+
+  This hash function processes the key one 64-bit word at a time
+  (MurmurHash64A), so callers who already know the length of the key
+  avoid a call to strlen(). The hash of a string is the same whether it
+  is computed by dictionary_hash() or dictionary_hash_n().
+
   This is normally a collision-free function, distributing keys evenly.
   The key is stored anyway in the struct so that collision can be avoided
   by comparing the key itself in last resort.
  */
 /*--------------------------------------------------------------------------*/
-unsigned dictionary_hash(const char * key);
+unsigned dictionary_hash_n(const char * key, size_t len);
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -79,6 +179,66 @@ unsigned dictionary_hash(const char * key);
 /*--------------------------------------------------------------------------*/
 dictionary * dictionary_new(size_t size);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object using a keyed hash function.
+  @param    size    Optional initial size of the dictionary.
+  @param    seed    16 bytes of secret seed, or NULL for a random one.
+  @return   1 newly allocated dictionary object.
+
+  This function works like dictionary_new(), but the keys are hashed with
+  SipHash-1-3 keyed by the seed instead of dictionary_hash(). Without
+  knowing the seed, nobody can craft keys that collide in the dictionary,
+  so that inserting n keys taken from untrusted input costs O(n) even in
+  the worst case. The keyed hash is slower than dictionary_hash(), use it
+  for dictionaries holding untrusted data.
+
+  If seed is NULL, a random seed is read from the system.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_new_seeded(size_t size, const unsigned char * seed);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object with a combination of modes.
+  @param    size    Optional initial size of the dictionary.
+  @param    flags   Combination of DICTIONARY_* flags.
+  @param    seed    16 bytes of secret seed, or NULL for a random one.
+                    Only used with DICTIONARY_SEEDED.
+  @return   1 newly allocated dictionary object.
+
+  With DICTIONARY_SEEDED, keys are hashed as in dictionary_new_seeded().
+
+  With DICTIONARY_ARENA, keys and values are copied into large chunks of
+  memory instead of being allocated one by one, which makes building and
+  deleting a dictionary holding many entries much cheaper. Overwritten
+  and deleted strings keep their space until dictionary_compact() is
+  called.
+
+  With DICTIONARY_CASE_SENSITIVE, dictionary_get_lower() and the other
+  *_lower functions do not fold the case of keys, so that iniparser
+  accessors treat keys that differ only by case as different keys.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_new_flags(size_t size, unsigned flags, const unsigned char * seed);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room in a dictionary for entries about to be added.
+  @param    d       Dictionary to modify.
+  @param    n       Number of entries to add, sections included.
+  @param    nsec    Number of sections among them.
+  @return   int 0 if Ok, -1 otherwise.
+
+  Adding up to n new entries, nsec of them in new sections, then does not
+  grow the dictionary: its storage is allocated once at its final size
+  instead of being doubled and copied along the way. An empty dictionary
+  is simply reallocated. Call this with an estimate of what is about to
+  be added; the dictionary still grows as usual if it is exceeded.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_reserve(dictionary * d, size_t n, unsigned nsec);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Delete a dictionary object
@@ -106,6 +266,67 @@ void dictionary_del(dictionary * vd);
 /*--------------------------------------------------------------------------*/
 const char * dictionary_get(const dictionary * d, const char * key, const char * def);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, with a key of known length.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned value.
+  @return   1 pointer to internally allocated character string.
+
+  This function works like dictionary_get(), but the key is given by
+  a pointer and a length, so that it can be a slice of a larger buffer,
+  and the length of the value is returned without scanning it. If the
+  key is not found, vallen is set to the length of def, or to 0 if def
+  is NULL. It is also set to 0 if the key is found with a NULL value.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_n(const dictionary * d, const char * key, size_t keylen,
+                              const char * def, size_t * vallen);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, ignoring the case of the key.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned value.
+  @return   1 pointer to internally allocated character string.
+
+  This function works like dictionary_get_n() called with key converted
+  to lowercase: ASCII letters are folded while the key is hashed and
+  compared, so that the key is neither copied nor limited in length.
+  Only keys stored in lowercase can be found this way. In a dictionary
+  created with DICTIONARY_CASE_SENSITIVE, the key is not folded and this
+  function works exactly like dictionary_get_n().
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_lower(const dictionary * d, const char * key, size_t keylen,
+                                  const char * def, size_t * vallen);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, with a precomputed key hash.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    hash    dictionary_hash_n(key, keylen).
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned value.
+  @return   1 pointer to internally allocated character string.
+
+  This function works like dictionary_get_n(), but does not hash the key,
+  which is useful when the same key is looked up many times. Dictionaries
+  created with DICTIONARY_SEEDED do not use dictionary_hash_n(): for them
+  the hash argument is ignored and the key is hashed as usual.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_hashed(const dictionary * d, const char * key, size_t keylen,
+                                   unsigned hash, const char * def, size_t * vallen);
+
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -135,6 +356,96 @@ const char * dictionary_get(const dictionary * d, const char * key, const char *
 /*--------------------------------------------------------------------------*/
 int dictionary_set(dictionary * vd, const char * key, const char * val);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, with a key and value of known length.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  This function works like dictionary_set(), but the key and value are
+  given by a pointer and a length, so that they can be slices of a larger
+  buffer. The dictionary stores NUL-terminated copies of both.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_n(dictionary * d, const char * key, size_t keylen,
+                     const char * val, size_t vallen);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, storing the key in lowercase.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  This function works like dictionary_set_n() called with key converted
+  to lowercase, without a temporary copy of the key. The key is used as
+  given in a dictionary created with DICTIONARY_CASE_SENSITIVE.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_lower(dictionary * d, const char * key, size_t keylen,
+                         const char * val, size_t vallen);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary without copying it if possible.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @param    val     Value to add, need not be NUL-terminated, may be NULL.
+  @param    vallen  Length of val, ignored if val is NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  This function works like dictionary_set_lower(), but a value lying in
+  the buffer attached with dictionary_attach() is not copied: the
+  dictionary points to it, and the byte following it in the buffer is
+  overwritten with '\0'. Short values and values not followed by another
+  byte of the buffer are copied as usual.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_borrowed(dictionary * d, const char * key, size_t keylen,
+                            char * val, size_t vallen);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Attach a buffer values may be borrowed from.
+  @param    d       dictionary object to modify.
+  @param    buf     Buffer to attach.
+  @param    size    Size of buf.
+  @param    release Function releasing buf in dictionary_del(), may be NULL.
+  @return   int     0 if Ok, -1 if a buffer is already attached.
+
+  The buffer must stay valid and unchanged as long as the dictionary
+  holds values borrowed from it, see dictionary_set_borrowed(). A
+  dictionary has at most one attached buffer.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_attach(dictionary * d, char * buf, size_t size,
+                      void (*release)(char * buf, size_t size));
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy the entries of a dictionary into another.
+  @param    d       dictionary object to modify.
+  @param    from    Dictionary to copy the entries of.
+  @return   int     0 if Ok, -1 otherwise.
+
+  The entries of from are set in d in their insertion order, keys being
+  copied as stored in from, without lowercasing them again. Keys already
+  in d get the value they have in from, other keys are appended, so that
+  merging dictionaries in turn makes the later ones take precedence.
+  Values borrowed from a buffer attached to both dictionaries stay
+  borrowed. In case of failure, the entries copied so far are kept.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_merge(dictionary * d, const dictionary * from);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Delete a key in a dictionary
@@ -148,6 +459,69 @@ int dictionary_set(dictionary * vd, const char * key, const char * val);
 /*--------------------------------------------------------------------------*/
 void dictionary_unset(dictionary * d, const char * key);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a dictionary, ignoring the case of the key.
+  @param    d       dictionary object to modify.
+  @param    key     Key to remove, need not be NUL-terminated.
+  @param    keylen  Length of key.
+  @return   void
+
+  This function works like dictionary_unset() called with key converted
+  to lowercase, without a temporary copy of the key. The key is used as
+  given in a dictionary created with DICTIONARY_CASE_SENSITIVE.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_unset_lower(dictionary * d, const char * key, size_t keylen);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Reclaim the space of overwritten and deleted strings.
+  @param    d       dictionary object to compact.
+  @return   int     0 if Ok, anything else otherwise
+
+  In DICTIONARY_ARENA mode, the space held by values that have been
+  overwritten and by entries that have been deleted is only given back
+  by this function. All pointers to keys and values previously returned
+  by the dictionary become invalid. Other dictionaries are left untouched.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_compact(dictionary * d);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find a section in a dictionary.
+  @param    d       dictionary object to search.
+  @param    name    Section name, need not be NUL-terminated.
+  @param    len     Length of name.
+  @return   Pointer to the section, or NULL if it has no key at all.
+
+  The returned section is valid until the next modification of the
+  dictionary. Its keys are walked from dictionary_section::first following
+  dictionary_link::next in d->link. A section may be returned while its
+  own key is not set (dictionary_section::entry is 0), if keys of the form
+  "name:key" were set without it.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_section * dictionary_get_section(const dictionary * d,
+                                                  const char * name, size_t len);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find a section in a dictionary, ignoring the case of its name.
+  @param    d       dictionary object to search.
+  @param    name    Section name, need not be NUL-terminated.
+  @param    len     Length of name.
+  @return   Pointer to the section, or NULL if it has no key at all.
+
+  This function works like dictionary_get_section() called with name
+  converted to lowercase, without a temporary copy of the name. The name
+  is used as given in a dictionary created with DICTIONARY_CASE_SENSITIVE.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_section * dictionary_get_section_lower(const dictionary * d,
+                                                        const char * name, size_t len);
+
 
 /*-------------------------------------------------------------------------*/
 /**
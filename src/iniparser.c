@@ -12,12 +12,38 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "iniparser.h"
 
 /*---------------------------- Defines -------------------------------------*/
-#define ASCIILINESZ         (1024)
 #define INI_INVALID_KEY     ((char*)-1)
 
+/** Number of bytes read from an ini file at once */
+#define INIBLOCKSZ          (64 * 1024)
+/** Initial size of the buffer of an iniparser_parser */
+#define INIFEEDSZ           (4 * 1024)
+/** Smallest part of an input worth parsing on a thread of its own */
+#define INIPARTMIN          (256 * 1024)
+
+/* Inputs in memory may be parsed by several threads */
+#ifndef _WIN32
+#define INITHREADS
+#endif
+
+/* Vectorized scanning needs GCC or Clang for runtime CPU dispatch */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define INISCAN_X86
+#include <immintrin.h>
+#endif
+
 /*---------------------------------------------------------------------------
                         Private to this module
  ---------------------------------------------------------------------------*/
@@ -33,6 +59,46 @@ typedef enum _line_status_ {
     LINE_VALUE
 } line_status ;
 
+/**
+ * This structure points to a part of a line parsed by iniparser_line().
+ */
+typedef struct _line_span_ {
+    char *  s ;     /** First character, not NUL-terminated */
+    size_t  len ;   /** Number of characters */
+} line_span ;
+
+/**
+ * Positions of the characters that matter to iniparser_line() in a buffer:
+ * bit i of bits is set if base[i] is one of '\n', '=', ';', '#', '"',
+ * '\'', '\\' or a NUL byte. Bits past the end of the buffer are clear.
+ */
+typedef struct _line_index_ {
+    const char      *   base ;  /** Start of the scanned buffer */
+    const uint64_t  *   bits ;  /** One bit per byte of the buffer */
+} line_index ;
+
+/* Sections of dictionaries loaded with INIPARSER_LAZY are parsed on demand */
+static void ini_lazy_load(const dictionary * d, const char * key, size_t len) ;
+static void ini_lazy_load_all(const dictionary * d) ;
+static void ini_lazy_lock(const dictionary * d, int write) ;
+static void ini_lazy_unlock(const dictionary * d) ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Convert a character to lowercase.
+  @param    c   Character to convert.
+  @return   c, lowercased if it is an ASCII letter.
+
+  Unlike tolower(), this does not depend on the locale, so that keys are
+  lowercased exactly like the dictionary does in dictionary_set_lower()
+  and dictionary_get_lower().
+ */
+/*--------------------------------------------------------------------------*/
+static char lwc(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c ;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Convert a string to lowercase.
@@ -52,65 +118,13 @@ static const char * strlwc(const char * in, char *out, unsigned len)
     if (in==NULL || out == NULL || len==0) return NULL ;
     i=0 ;
     while (in[i] != '\0' && i < len-1) {
-        out[i] = (char)tolower((int)in[i]);
+        out[i] = lwc(in[i]);
         i++ ;
     }
     out[i] = '\0';
     return out ;
 }
 
-/*-------------------------------------------------------------------------*/
-/**
-  @brief    Duplicate a string
-  @param    s String to duplicate
-  @return   Pointer to a newly allocated string, to be freed with free()
-
-  This is a replacement for strdup(). This implementation is provided
-  for systems that do not have it.
- */
-/*--------------------------------------------------------------------------*/
-static char * xstrdup(const char * s)
-{
-    char * t ;
-    size_t len ;
-    if (!s)
-        return NULL ;
-
-    len = strlen(s) + 1 ;
-    t = (char*) malloc(len) ;
-    if (t) {
-        memcpy(t, s, len) ;
-    }
-    return t ;
-}
-
-/*-------------------------------------------------------------------------*/
-/**
-  @brief    Remove blanks at the beginning and the end of a string.
-  @param    str  String to parse and alter.
-  @return   unsigned New size of the string.
- */
-/*--------------------------------------------------------------------------*/
-static unsigned strstrip(char * s)
-{
-    char *last = NULL ;
-    char *dest = s;
-
-    if (s==NULL) return 0;
-
-    last = s + strlen(s);
-    while (isspace((unsigned char)*s) && *s) s++;
-    while (last > s) {
-        if (!isspace((unsigned char)*(last-1)))
-            break ;
-        last -- ;
-    }
-    *last = (char)0;
-
-    memmove(dest,s,last - s + 1);
-    return last - s;
-}
-
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Default error callback for iniparser: wraps `fprintf(stderr, ...)`.
@@ -166,18 +180,16 @@ void iniparser_set_error_callback(int (*errback)(const char *, ...))
 /*--------------------------------------------------------------------------*/
 int iniparser_getnsec(const dictionary * d)
 {
-    size_t i ;
+    unsigned k ;
     int nsec ;
 
     if (d==NULL) return -1 ;
     nsec=0 ;
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        if (strchr(d->key[i], ':')==NULL) {
-            nsec ++ ;
-        }
+    ini_lazy_lock(d, 0) ;
+    for (k=d->secfirst ; k ; k=d->sec[k-1].next) {
+        nsec ++ ;
     }
+    ini_lazy_unlock(d) ;
     return nsec ;
 }
 
@@ -197,24 +209,19 @@ int iniparser_getnsec(const dictionary * d)
 /*--------------------------------------------------------------------------*/
 const char * iniparser_getsecname(const dictionary * d, int n)
 {
-    size_t i ;
-    int foundsec ;
+    const char * name = NULL ;
+    unsigned k ;
 
     if (d==NULL || n<0) return NULL ;
-    foundsec=0 ;
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        if (strchr(d->key[i], ':')==NULL) {
-            foundsec++ ;
-            if (foundsec>n)
-                break ;
-        }
+    ini_lazy_lock(d, 0) ;
+    for (k=d->secfirst ; k && n>0 ; k=d->sec[k-1].next) {
+        n-- ;
     }
-    if (foundsec<=n) {
-        return NULL ;
+    if (k!=0) {
+        name = d->key[d->sec[k-1].entry - 1] ;
     }
-    return d->key[i] ;
+    ini_lazy_unlock(d) ;
+    return name ;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -235,7 +242,8 @@ void iniparser_dump(const dictionary * d, FILE * f)
     size_t i ;
 
     if (d==NULL || f==NULL) return ;
-    for (i=0 ; i<d->size ; i++) {
+    ini_lazy_load_all(d) ;
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]==NULL)
             continue ;
         if (d->val[i]!=NULL) {
@@ -247,24 +255,82 @@ void iniparser_dump(const dictionary * d, FILE * f)
     return ;
 }
 
-static void escape_value(char *escaped, char *value) {
-    char c;
-    int v = 0;
-    int e = 0;
-
-    if(!escaped || !value)
-        return;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Write a value between double quotes, escaping quotes and backslashes
+  @param    value   Value to write, may be NULL
+  @param    f       Opened file pointer to write to
+  @return   void
 
-    while((c = value[v]) != '\0') {
-        if(c == '\\' || c == '"') {
-            escaped[e] = '\\';
-            e++;
+  Runs of characters needing no escape are written at once.
+ */
+/*--------------------------------------------------------------------------*/
+static void escape_value(const char * value, FILE * f)
+{
+    const char * p ;
+
+    fputc('"', f);
+    for (p = value ; p && *p ; p++) {
+        if (*p == '\\' || *p == '"') {
+            fwrite(value, 1, (size_t)(p - value), f);
+            fputc('\\', f);
+            value = p ;
         }
-        escaped[e] = c;
-        v++;
-        e++;
     }
-    escaped[e] = '\0';
+    if (value)
+        fputs(value, f);
+    fputs("\"\n", f);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Tell whether a key is in a section whose name holds a ':'
+  @param    d    Dictionary holding key
+  @param    key  Key of d
+  @param    s    Section name, holding a ':'
+  @param    len  Length of s
+  @return   1 if key is "s:...", 0 otherwise
+
+  The section table files keys under the part of their name before the
+  first ':', so that such sections are not in it: their keys are found by
+  scanning all keys for the "s:" prefix, ignoring the case of s unless
+  the dictionary is case-sensitive.
+ */
+/*--------------------------------------------------------------------------*/
+static int in_colon_section(const dictionary * d, const char * key,
+                            const char * s, size_t len)
+{
+    int     fold = !(d->flags & DICTIONARY_CASE_SENSITIVE) ;
+    size_t  i ;
+
+    for (i = 0 ; i < len ; i++) {
+        if (key[i] != (fold ? lwc(s[i]) : s[i]))
+            return 0 ;
+    }
+    return key[len] == ':' ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Save a section to a loadable ini file
+  @param    d    Dictionary to dump
+  @param    name Section name to print
+  @param    sec  Section of d to dump, or NULL for an empty section
+  @param    f    Opened file pointer to dump to
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dump_section(const dictionary * d, const char * name,
+                         const dictionary_section * sec, FILE * f)
+{
+    unsigned j ;
+
+    fprintf(f, "\n[%s]\n", name);
+    for (j = sec ? sec->first : 0 ; j ; j=d->link[j-1].next) {
+        fprintf(f, "%-30s = ", d->key[j-1]+sec->len+1);
+        escape_value(d->val[j-1], f);
+    }
+    fprintf(f, "\n");
 }
 
 /*-------------------------------------------------------------------------*/
@@ -281,26 +347,23 @@ static void escape_value(char *escaped, char *value) {
 void iniparser_dump_ini(const dictionary * d, FILE * f)
 {
     size_t       i ;
-    size_t       nsec ;
-    const char * secname ;
-    char escaped[(ASCIILINESZ * 2) + 2] = "";
+    unsigned     k ;
 
     if (d==NULL || f==NULL) return ;
+    ini_lazy_load_all(d) ;
 
-    nsec = iniparser_getnsec(d);
-    if (nsec<1) {
+    if (d->secfirst==0) {
         /* No section in file: dump all keys as they are */
-        for (i=0 ; i<d->size ; i++) {
+        for (i=0 ; i<d->used ; i++) {
             if (d->key[i]==NULL)
                 continue ;
-            escape_value(escaped, d->val[i]);
-            fprintf(f, "%s = \"%s\"\n", d->key[i], escaped);
+            fprintf(f, "%s = ", d->key[i]);
+            escape_value(d->val[i], f);
         }
         return ;
     }
-    for (i=0 ; i<nsec ; i++) {
-        secname = iniparser_getsecname(d, i) ;
-        iniparser_dumpsection_ini(d, secname, f);
+    for (k=d->secfirst ; k ; k=d->sec[k-1].next) {
+        dump_section(d, d->key[d->sec[k-1].entry-1], d->sec + k - 1, f);
     }
     fprintf(f, "\n");
     return ;
@@ -320,27 +383,28 @@ void iniparser_dump_ini(const dictionary * d, FILE * f)
 /*--------------------------------------------------------------------------*/
 void iniparser_dumpsection_ini(const dictionary * d, const char * s, FILE * f)
 {
-    size_t  j ;
-    char    keym[ASCIILINESZ+1];
-    int     seclen ;
-    char escaped[(ASCIILINESZ * 2) + 2] = "";
+    const dictionary_section * sec ;
+    size_t len, i ;
 
     if (d==NULL || f==NULL) return;
     if (! iniparser_find_entry(d, s)) return;
-    if (strlen(s) > sizeof(keym)) return;
 
-    seclen  = (int)strlen(s);
-    fprintf(f, "\n[%s]\n", s);
-    sprintf(keym, "%s:", s);
-    for (j=0 ; j<d->size ; j++) {
-        if (d->key[j]==NULL)
-            continue ;
-        if (!strncmp(d->key[j], keym, seclen+1)) {
-            escape_value(escaped, d->val[j]);
-            fprintf(f, "%-30s = \"%s\"\n", d->key[j]+seclen+1, escaped);
+    len = strlen(s);
+    ini_lazy_lock(d, 0) ;
+    if (memchr(s, ':', len)) {
+        fprintf(f, "\n[%s]\n", s);
+        for (i=0 ; i<d->used ; i++) {
+            if (d->key[i]==NULL || !in_colon_section(d, d->key[i], s, len))
+                continue ;
+            fprintf(f, "%-30s = ", d->key[i]+len+1);
+            escape_value(d->val[i], f);
         }
+        fprintf(f, "\n");
+    } else {
+        sec = dictionary_get_section_lower(d, s, len);
+        dump_section(d, s, sec, f);
     }
-    fprintf(f, "\n");
+    ini_lazy_unlock(d) ;
     return ;
 }
 
@@ -354,28 +418,27 @@ void iniparser_dumpsection_ini(const dictionary * d, const char * s, FILE * f)
 /*--------------------------------------------------------------------------*/
 int iniparser_getsecnkeys(const dictionary * d, const char * s)
 {
-    int     seclen, nkeys ;
-    char    keym[ASCIILINESZ+1];
-    size_t  j ;
-
-    nkeys = 0;
-
-    if (d==NULL) return nkeys;
-    if (! iniparser_find_entry(d, s)) return nkeys;
-
-    seclen  = (int)strlen(s);
-    strlwc(s, keym, sizeof(keym));
-    keym[seclen] = ':';
-
-    for (j=0 ; j<d->size ; j++) {
-        if (d->key[j]==NULL)
-            continue ;
-        if (!strncmp(d->key[j], keym, seclen+1))
-            nkeys++;
+    const dictionary_section * sec ;
+    size_t len, i ;
+    int nkeys = 0 ;
+
+    if (d==NULL) return 0;
+    if (! iniparser_find_entry(d, s)) return 0;
+
+    len = strlen(s);
+    ini_lazy_lock(d, 0) ;
+    if (memchr(s, ':', len)) {
+        for (i=0 ; i<d->used ; i++) {
+            if (d->key[i]!=NULL && in_colon_section(d, d->key[i], s, len))
+                nkeys++ ;
+        }
+    } else {
+        sec = dictionary_get_section_lower(d, s, len);
+        nkeys = sec ? (int)sec->nkeys : 0 ;
     }
+    ini_lazy_unlock(d) ;
 
     return nkeys;
-
 }
 
 /*-------------------------------------------------------------------------*/
@@ -396,30 +459,57 @@ int iniparser_getsecnkeys(const dictionary * d, const char * s)
 /*--------------------------------------------------------------------------*/
 const char ** iniparser_getseckeys(const dictionary * d, const char * s, const char ** keys)
 {
-    size_t i, j, seclen ;
-    char keym[ASCIILINESZ+1];
+    const dictionary_section * sec ;
+    size_t i, k, len ;
+    unsigned j ;
 
     if (d==NULL || keys==NULL) return NULL;
     if (! iniparser_find_entry(d, s)) return NULL;
 
-    seclen  = strlen(s);
-    strlwc(s, keym, sizeof(keym));
-    keym[seclen] = ':';
-
     i = 0;
+    len = strlen(s);
+    ini_lazy_lock(d, 0) ;
+    if (memchr(s, ':', len)) {
+        for (k=0 ; k<d->used ; k++) {
+            if (d->key[k]!=NULL && in_colon_section(d, d->key[k], s, len))
+                keys[i++] = d->key[k];
+        }
+    } else {
+        sec = dictionary_get_section_lower(d, s, len);
 
-    for (j=0 ; j<d->size ; j++) {
-        if (d->key[j]==NULL)
-            continue ;
-        if (!strncmp(d->key[j], keym, seclen+1)) {
-            keys[i] = d->key[j];
+        for (j = sec ? sec->first : 0 ; j ; j = d->link[j-1].next) {
+            keys[i] = d->key[j-1];
             i++;
         }
     }
+    ini_lazy_unlock(d) ;
 
     return keys;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Convert a value to a boolean
+  @param    c           Value, NULL or INI_INVALID_KEY if not found
+  @param    notfound    Value to return if no boolean is identified
+  @return   1, 0 or notfound, see iniparser_getboolean()
+ */
+/*--------------------------------------------------------------------------*/
+static int parse_boolean(const char * c, int notfound)
+{
+    int ret ;
+
+    if (c==NULL || c==INI_INVALID_KEY) return notfound ;
+    if (c[0]=='y' || c[0]=='Y' || c[0]=='1' || c[0]=='t' || c[0]=='T') {
+        ret = 1 ;
+    } else if (c[0]=='n' || c[0]=='N' || c[0]=='0' || c[0]=='f' || c[0]=='F') {
+        ret = 0 ;
+    } else {
+        ret = notfound ;
+    }
+    return ret;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Get the string associated to a key
@@ -437,16 +527,43 @@ const char ** iniparser_getseckeys(const dictionary * d, const char * s, const c
 /*--------------------------------------------------------------------------*/
 const char * iniparser_getstring(const dictionary * d, const char * key, const char * def)
 {
-    const char * lc_key ;
-    const char * sval ;
-    char tmp_str[ASCIILINESZ+1];
-
     if (d==NULL || key==NULL)
         return def ;
 
-    lc_key = strlwc(key, tmp_str, sizeof(tmp_str));
-    sval = dictionary_get(d, lc_key, def);
-    return sval ;
+    return iniparser_getstring_n(d, key, strlen(key), def, NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key of known length
+  @param    d       Dictionary to search
+  @param    key     Key string to look for, need not be NUL-terminated
+  @param    keylen  Length of key
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned string
+  @return   pointer to statically allocated character string
+
+  This function works like iniparser_getstring(), but the key is given
+  by a pointer and a length and the length of the value is returned, so
+  that neither has to be scanned for its terminating NUL.
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_getstring_n(const dictionary * d, const char * key, size_t keylen,
+                                   const char * def, size_t * vallen)
+{
+    const char * val ;
+
+    if (d==NULL || key==NULL) {
+        if (vallen)
+            *vallen = def ? strlen(def) : 0 ;
+        return def ;
+    }
+
+    ini_lazy_load(d, key, keylen) ;
+    ini_lazy_lock(d, 0) ;
+    val = dictionary_get_lower(d, key, keylen, def, vallen);
+    ini_lazy_unlock(d) ;
+    return val ;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -593,19 +710,7 @@ double iniparser_getdouble(const dictionary * d, const char * key, double notfou
 /*--------------------------------------------------------------------------*/
 int iniparser_getboolean(const dictionary * d, const char * key, int notfound)
 {
-    int          ret ;
-    const char * c ;
-
-    c = iniparser_getstring(d, key, INI_INVALID_KEY);
-    if (c==NULL || c==INI_INVALID_KEY) return notfound ;
-    if (c[0]=='y' || c[0]=='Y' || c[0]=='1' || c[0]=='t' || c[0]=='T') {
-        ret = 1 ;
-    } else if (c[0]=='n' || c[0]=='N' || c[0]=='0' || c[0]=='f' || c[0]=='F') {
-        ret = 0 ;
-    } else {
-        ret = notfound ;
-    }
-    return ret;
+    return parse_boolean(iniparser_getstring(d, key, INI_INVALID_KEY), notfound);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -631,301 +736,2435 @@ int iniparser_find_entry(const dictionary * ini, const char * entry)
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Set an entry in a dictionary.
-  @param    ini     Dictionary to modify.
-  @param    entry   Entry to modify (entry name)
-  @param    val     New value to associate to the entry.
-  @return   int 0 if Ok, -1 otherwise.
+  @brief    Compile a key for repeated lookups
+  @param    key     Key string, as given to iniparser_getstring()
+  @return   Newly allocated handle, or NULL in case of error
 
-  If the given entry can be found in the dictionary, it is modified to
-  contain the provided value. If it cannot be found, the entry is created.
-  It is Ok to set val to NULL.
+  The key is stored lowercased and as given together with their length
+  and hash, in the same allocation as the handle. Both point to the same
+  string when the key is already lowercase.
  */
 /*--------------------------------------------------------------------------*/
-int iniparser_set(dictionary * ini, const char * entry, const char * val)
+iniparser_key * iniparser_key_compile(const char * key)
 {
-    char tmp_key[ASCIILINESZ+1] = {0};
-    char tmp_val[ASCIILINESZ+1] = {0};
-    size_t len;
+    iniparser_key * k ;
+    size_t len ;
 
-    if(val) {
-        len = strlen(val);
-        len = len > ASCIILINESZ ? ASCIILINESZ : len;
-        memcpy(tmp_val, val, len) ;
-        val = tmp_val;
+    if (key==NULL)
+        return NULL ;
+    len = strlen(key) ;
+    k = (iniparser_key*) malloc(sizeof *k + 2 * (len + 1)) ;
+    if (k==NULL)
+        return NULL ;
+    k->key  = (char*)(k + 1) ;
+    k->len  = len ;
+    strlwc(key, k->key, len + 1) ;
+    k->hash = dictionary_hash_n(k->key, k->len) ;
+    if (memcmp(key, k->key, len)) {
+        k->exact = k->key + len + 1 ;
+        memcpy(k->exact, key, len + 1) ;
+        k->exact_hash = dictionary_hash_n(k->exact, len) ;
+    } else {
+        k->exact = k->key ;
+        k->exact_hash = k->hash ;
     }
-    return dictionary_set(ini, strlwc(entry, tmp_key, sizeof(tmp_key)), val);
+    return k ;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Delete an entry in a dictionary
-  @param    ini     Dictionary to modify
-  @param    entry   Entry to delete (entry name)
-  @return   void
-
-  If the given entry can be found, it is deleted from the dictionary.
+  @brief    Free a compiled key
+  @param    k   Handle returned by iniparser_key_compile(), may be NULL
  */
 /*--------------------------------------------------------------------------*/
-void iniparser_unset(dictionary * ini, const char * entry)
+void iniparser_key_free(iniparser_key * k)
 {
-    char tmp_str[ASCIILINESZ+1];
-    dictionary_unset(ini, strlwc(entry, tmp_str, sizeof(tmp_str)));
+    free(k);
 }
 
-static void parse_quoted_value(char *value, char quote) {
-    char c;
-    char *quoted;
-    int q = 0, v = 0;
-    int esc = 0;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key
+  @param    d   Dictionary to search
+  @param    k   Compiled key to look for
+  @param    def Default value to return if key not found.
+  @return   pointer to statically allocated character string
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_getstring_key(const dictionary * d, const iniparser_key * k,
+                                     const char * def)
+{
+    const char * val ;
 
-    if(!value)
-        return;
+    if (d==NULL || k==NULL)
+        return def ;
 
-    quoted = xstrdup(value);
+    ini_lazy_load(d, k->exact, k->len) ;
+    ini_lazy_lock(d, 0) ;
+    if (d->flags & DICTIONARY_CASE_SENSITIVE)
+        val = dictionary_get_hashed(d, k->exact, k->len, k->exact_hash, def, NULL);
+    else
+        val = dictionary_get_hashed(d, k->key, k->len, k->hash, def, NULL);
+    ini_lazy_unlock(d) ;
+    return val ;
+}
 
-    if(!quoted) {
-        iniparser_error_callback("iniparser: memory allocation failure\n");
-        goto end_of_value;
-    }
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to an int
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_getint_key(const dictionary * d, const iniparser_key * k, int notfound)
+{
+    return (int)iniparser_getlongint_key(d, k, notfound);
+}
 
-    while((c = quoted[q]) != '\0') {
-        if(!esc) {
-            if(c == '\\') {
-                esc = 1;
-                q++;
-                continue;
-            }
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to a long int
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   long integer
+ */
+/*--------------------------------------------------------------------------*/
+long int iniparser_getlongint_key(const dictionary * d, const iniparser_key * k,
+                                  long int notfound)
+{
+    const char * str ;
 
-            if(c == quote) {
-                goto end_of_value;
-            }
-        }
-        esc = 0;
-        value[v] = c;
-        v++;
-        q++;
-    }
-end_of_value:
-    value[v] = '\0';
-    free(quoted);
+    str = iniparser_getstring_key(d, k, INI_INVALID_KEY);
+    if (str==NULL || str==INI_INVALID_KEY) return notfound ;
+    return strtol(str, NULL, 0);
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Load a single line from an INI file
-  @param    input_line  Input line, may be concatenated multi-line input
-  @param    section     Output space to store section
-  @param    key         Output space to store key
-  @param    value       Output space to store value
-  @return   line_status value
+  @brief    Get the string associated to a compiled key, convert to an int64_t
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
  */
 /*--------------------------------------------------------------------------*/
-static line_status iniparser_line(
-    const char * input_line,
-    char * section,
-    char * key,
-    char * value)
+int64_t iniparser_getint64_key(const dictionary * d, const iniparser_key * k,
+                               int64_t notfound)
 {
-    line_status sta ;
-    char * line = NULL;
-    size_t      len ;
-    int d_quote;
+    const char * str ;
 
-    line = xstrdup(input_line);
-    len = strstrip(line);
+    str = iniparser_getstring_key(d, k, INI_INVALID_KEY);
+    if (str==NULL || str==INI_INVALID_KEY) return notfound ;
+    return strtoimax(str, NULL, 0);
+}
 
-    sta = LINE_UNPROCESSED ;
-    if (len<1) {
-        /* Empty line */
-        sta = LINE_EMPTY ;
-    } else if (line[0]=='#' || line[0]==';') {
-        /* Comment line */
-        sta = LINE_COMMENT ;
-    } else if (line[0]=='[' && line[len-1]==']') {
-        /* Section name without opening square bracket */
-        sscanf(line, "[%[^\n]", section);
-        len = strlen(section);
-        /* Section name without closing square bracket */
-        if(section[len-1] == ']')
-        {
-            section[len-1] = '\0';
-        }
-        strstrip(section);
-        strlwc(section, section, len);
-        sta = LINE_SECTION ;
-    } else if ((d_quote = sscanf (line, "%[^=] = \"%[^\n]\"", key, value)) == 2
-               ||  sscanf (line, "%[^=] = '%[^\n]'",   key, value) == 2) {
-        /* Usual key=value with quotes, with or without comments */
-        strstrip(key);
-        strlwc(key, key, len);
-        if(d_quote == 2)
-            parse_quoted_value(value, '"');
-        else
-            parse_quoted_value(value, '\'');
-        /* Don't strip spaces from values surrounded with quotes */
-        sta = LINE_VALUE ;
-    } else if (sscanf (line, "%[^=] = %[^;#]", key, value) == 2) {
-        /* Usual key=value without quotes, with or without comments */
-        strstrip(key);
-        strlwc(key, key, len);
-        strstrip(value);
-        /*
-         * sscanf cannot handle '' or "" as empty values
-         * this is done here
-         */
-        if (!strcmp(value, "\"\"") || (!strcmp(value, "''"))) {
-            value[0]=0 ;
-        }
-        sta = LINE_VALUE ;
-    } else if (sscanf(line, "%[^=] = %[;#]", key, value)==2
-           ||  sscanf(line, "%[^=] %[=]", key, value) == 2) {
-        /*
-         * Special cases:
-         * key=
-         * key=;
-         * key=#
-         */
-        strstrip(key);
-        strlwc(key, key, len);
-        value[0]=0 ;
-        sta = LINE_VALUE ;
-    } else {
-        /* Generate syntax error */
-        sta = LINE_ERROR ;
-    }
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to an uint64_t
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
+ */
+/*--------------------------------------------------------------------------*/
+uint64_t iniparser_getuint64_key(const dictionary * d, const iniparser_key * k,
+                                 uint64_t notfound)
+{
+    const char * str ;
 
-    free(line);
-    return sta ;
+    str = iniparser_getstring_key(d, k, INI_INVALID_KEY);
+    if (str==NULL || str==INI_INVALID_KEY) return notfound ;
+    return strtoumax(str, NULL, 0);
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Parse an ini file and return an allocated dictionary object
-  @param    in File to read.
-  @param    ininame Name of the ini file to read (only used for nicer error messages)
-  @return   Pointer to newly allocated dictionary
+  @brief    Get the string associated to a compiled key, convert to a double
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   double
+ */
+/*--------------------------------------------------------------------------*/
+double iniparser_getdouble_key(const dictionary * d, const iniparser_key * k,
+                               double notfound)
+{
+    const char * str ;
 
-  This is the parser for ini files. This function is called, providing
-  the file to be read. It returns a dictionary object that should not
-  be accessed directly, but through accessor functions instead.
+    str = iniparser_getstring_key(d, k, INI_INVALID_KEY);
+    if (str==NULL || str==INI_INVALID_KEY) return notfound ;
+    return atof(str);
+}
 
-  The returned dictionary must be freed using iniparser_freedict().
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to a boolean
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
  */
 /*--------------------------------------------------------------------------*/
-dictionary * iniparser_load_file(FILE * in, const char * ininame)
+int iniparser_getboolean_key(const dictionary * d, const iniparser_key * k, int notfound)
 {
-    char line    [ASCIILINESZ+1] ;
-    char section [ASCIILINESZ+1] ;
-    char key     [ASCIILINESZ+1] ;
-    char tmp     [(ASCIILINESZ * 2) + 2] ;
-    char val     [ASCIILINESZ+1] ;
+    return parse_boolean(iniparser_getstring_key(d, k, INI_INVALID_KEY), notfound);
+}
 
-    int  last=0 ;
-    int  len ;
-    int  lineno=0 ;
-    int  errs=0;
-    int  mem_err=0;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry in a dictionary.
+  @param    ini     Dictionary to modify.
+  @param    entry   Entry to modify (entry name)
+  @param    val     New value to associate to the entry.
+  @return   int 0 if Ok, -1 otherwise.
 
-    dictionary * dict ;
+  If the given entry can be found in the dictionary, it is modified to
+  contain the provided value. If it cannot be found, the entry is created.
+  It is Ok to set val to NULL.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_set(dictionary * ini, const char * entry, const char * val)
+{
+    if (entry==NULL)
+        return -1 ;
 
-    dict = dictionary_new(0) ;
-    if (!dict) {
-        return NULL ;
-    }
+    return iniparser_set_n(ini, entry, strlen(entry), val, val ? strlen(val) : 0);
+}
 
-    memset(line,    0, ASCIILINESZ);
-    memset(section, 0, ASCIILINESZ);
-    memset(key,     0, ASCIILINESZ);
-    memset(val,     0, ASCIILINESZ);
-    last=0 ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry of known length in a dictionary.
+  @param    ini      Dictionary to modify.
+  @param    entry    Entry to modify (entry name), need not be NUL-terminated
+  @param    entrylen Length of entry
+  @param    val      New value to associate to the entry, may be NULL.
+  @param    vallen   Length of val, ignored if val is NULL.
+  @return   int 0 if Ok, -1 otherwise.
 
-    while (fgets(line+last, ASCIILINESZ-last, in)!=NULL) {
-        lineno++ ;
-        len = (int)strlen(line)-1;
-        if (len<=0)
-            continue;
-        /* Safety check against buffer overflows */
-        if (line[len]!='\n' && !feof(in)) {
-            iniparser_error_callback(
-              "iniparser: input line too long in %s (%d)\n",
-              ininame,
-              lineno);
-            dictionary_del(dict);
-            return NULL ;
+  This function works like iniparser_set(), but entry and value are given
+  by a pointer and a length, so that they can be slices of a larger buffer.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_set_n(dictionary * ini, const char * entry, size_t entrylen,
+                    const char * val, size_t vallen)
+{
+    if (entry==NULL)
+        return -1 ;
+
+    ini_lazy_load(ini, entry, entrylen) ;
+    return dictionary_set_lower(ini, entry, entrylen, val, vallen);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete an entry in a dictionary
+  @param    ini     Dictionary to modify
+  @param    entry   Entry to delete (entry name)
+  @return   void
+
+  If the given entry can be found, it is deleted from the dictionary.
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_unset(dictionary * ini, const char * entry)
+{
+    if (entry==NULL)
+        return ;
+    ini_lazy_load(ini, entry, strlen(entry)) ;
+    dictionary_unset_lower(ini, entry, strlen(entry));
+}
+
+/** Characters indexed in a line_index */
+static const unsigned char structural[256] = {
+    ['\n'] = 1, ['='] = 1, [';'] = 1, ['#'] = 1,
+    ['"'] = 1, ['\''] = 1, ['\\'] = 1, ['\0'] = 1
+};
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Index the structural characters of a buffer, one byte at a time
+  @param    s       Buffer to scan
+  @param    n       Number of bytes to scan
+  @param    bits    Output bitmap of (n + 63) / 64 words, see line_index
+ */
+/*--------------------------------------------------------------------------*/
+static void scan_scalar(const char * s, size_t n, uint64_t * bits)
+{
+    size_t i ;
+
+    memset(bits, 0, (n + 63) / 64 * sizeof *bits) ;
+    for (i=0 ; i<n ; i++) {
+        if (structural[(unsigned char)s[i]])
+            bits[i / 64] |= (uint64_t)1 << (i % 64) ;
+    }
+}
+
+#ifdef INISCAN_X86
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Index the structural characters of a buffer, 16 bytes at a time
+  @param    s       Buffer to scan
+  @param    n       Number of bytes to scan
+  @param    bits    Output bitmap, see scan_scalar()
+ */
+/*--------------------------------------------------------------------------*/
+static void scan_sse2(const char * s, size_t n, uint64_t * bits)
+{
+    const __m128i nl = _mm_set1_epi8('\n'), eq = _mm_set1_epi8('=') ;
+    const __m128i sc = _mm_set1_epi8(';'), hs = _mm_set1_epi8('#') ;
+    const __m128i dq = _mm_set1_epi8('"'), sq = _mm_set1_epi8('\'') ;
+    const __m128i bs = _mm_set1_epi8('\\'), nul = _mm_setzero_si128() ;
+    __m128i     c, m ;
+    uint64_t    w ;
+    size_t      i, j ;
+
+    for (i=0 ; i + 64 <= n ; i += 64) {
+        w = 0 ;
+        for (j=0 ; j<64 ; j += 16) {
+            c = _mm_loadu_si128((const __m128i *)(s + i + j)) ;
+            m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, nl), _mm_cmpeq_epi8(c, eq)),
+                             _mm_or_si128(_mm_cmpeq_epi8(c, sc), _mm_cmpeq_epi8(c, hs))) ;
+            m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(c, dq), _mm_cmpeq_epi8(c, sq))) ;
+            m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(c, bs), _mm_cmpeq_epi8(c, nul))) ;
+            w |= (uint64_t)(unsigned)_mm_movemask_epi8(m) << j ;
+        }
+        bits[i / 64] = w ;
+    }
+    scan_scalar(s + i, n - i, bits + i / 64) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Index the structural characters of a buffer, 32 bytes at a time
+  @param    s       Buffer to scan
+  @param    n       Number of bytes to scan
+  @param    bits    Output bitmap, see scan_scalar()
+ */
+/*--------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static void scan_avx2(const char * s, size_t n, uint64_t * bits)
+{
+    const __m256i nl = _mm256_set1_epi8('\n'), eq = _mm256_set1_epi8('=') ;
+    const __m256i sc = _mm256_set1_epi8(';'), hs = _mm256_set1_epi8('#') ;
+    const __m256i dq = _mm256_set1_epi8('"'), sq = _mm256_set1_epi8('\'') ;
+    const __m256i bs = _mm256_set1_epi8('\\'), nul = _mm256_setzero_si256() ;
+    __m256i     c, m ;
+    uint64_t    w ;
+    size_t      i, j ;
+
+    for (i=0 ; i + 64 <= n ; i += 64) {
+        w = 0 ;
+        for (j=0 ; j<64 ; j += 32) {
+            c = _mm256_loadu_si256((const __m256i *)(s + i + j)) ;
+            m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, nl),
+                                                _mm256_cmpeq_epi8(c, eq)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(c, sc),
+                                                _mm256_cmpeq_epi8(c, hs))) ;
+            m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(c, dq),
+                                                   _mm256_cmpeq_epi8(c, sq))) ;
+            m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(c, bs),
+                                                   _mm256_cmpeq_epi8(c, nul))) ;
+            w |= (uint64_t)(uint32_t)_mm256_movemask_epi8(m) << j ;
+        }
+        bits[i / 64] = w ;
+    }
+    scan_scalar(s + i, n - i, bits + i / 64) ;
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Index the structural characters of a buffer
+  @param    s       Buffer to scan
+  @param    n       Number of bytes to scan
+  @param    bits    Output bitmap, see scan_scalar()
+
+  Uses the widest vector instructions supported by the CPU.
+ */
+/*--------------------------------------------------------------------------*/
+static void scan_structural(const char * s, size_t n, uint64_t * bits)
+{
+#ifdef INISCAN_X86
+    if (__builtin_cpu_supports("avx2"))
+        scan_avx2(s, n, bits) ;
+    else
+        scan_sse2(s, n, bits) ;
+#else
+    scan_scalar(s, n, bits) ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Count the '=', '[' and '\n' characters of a buffer, one byte at a time
+  @param    s   Buffer to scan
+  @param    n   Number of bytes to scan
+  @param    eq  Incremented by the number of '='
+  @param    br  Incremented by the number of '['
+  @param    nl  Incremented by the number of '\n'
+ */
+/*--------------------------------------------------------------------------*/
+static void count_scalar(const char * s, size_t n, size_t * eq, size_t * br, size_t * nl)
+{
+    size_t i ;
+
+    for (i=0 ; i<n ; i++) {
+        *eq += (s[i] == '=') ;
+        *br += (s[i] == '[') ;
+        *nl += (s[i] == '\n') ;
+    }
+}
+
+#ifdef INISCAN_X86
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Count the '=', '[' and '\n' characters of a buffer, 16 bytes at a time
+  @param    s   Buffer to scan
+  @param    n   Number of bytes to scan
+  @param    eq  Incremented by the number of '='
+  @param    br  Incremented by the number of '['
+  @param    nl  Incremented by the number of '\n'
+
+  Matches are summed in bytes for up to 255 vectors, then added up.
+ */
+/*--------------------------------------------------------------------------*/
+static void count_sse2(const char * s, size_t n, size_t * eq, size_t * br, size_t * nl)
+{
+    const __m128i eqv = _mm_set1_epi8('='), brv = _mm_set1_epi8('[') ;
+    const __m128i nlv = _mm_set1_epi8('\n') ;
+    const __m128i zero = _mm_setzero_si128() ;
+    __m128i     c, e, b, l ;
+    size_t      i = 0, k ;
+
+    while (i + 16 <= n) {
+        e = b = l = zero ;
+        for (k=0 ; k<255 && i + 16 <= n ; k++, i += 16) {
+            c = _mm_loadu_si128((const __m128i *)(s + i)) ;
+            e = _mm_sub_epi8(e, _mm_cmpeq_epi8(c, eqv)) ;
+            b = _mm_sub_epi8(b, _mm_cmpeq_epi8(c, brv)) ;
+            l = _mm_sub_epi8(l, _mm_cmpeq_epi8(c, nlv)) ;
+        }
+        e = _mm_sad_epu8(e, zero) ;
+        b = _mm_sad_epu8(b, zero) ;
+        l = _mm_sad_epu8(l, zero) ;
+        *eq += (size_t)_mm_cvtsi128_si64(e) + (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(e, e)) ;
+        *br += (size_t)_mm_cvtsi128_si64(b) + (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(b, b)) ;
+        *nl += (size_t)_mm_cvtsi128_si64(l) + (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(l, l)) ;
+    }
+    count_scalar(s + i, n - i, eq, br, nl) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Count the '=', '[' and '\n' characters of a buffer, 32 bytes at a time
+  @param    s   Buffer to scan
+  @param    n   Number of bytes to scan
+  @param    eq  Incremented by the number of '='
+  @param    br  Incremented by the number of '['
+  @param    nl  Incremented by the number of '\n'
+ */
+/*--------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static void count_avx2(const char * s, size_t n, size_t * eq, size_t * br, size_t * nl)
+{
+    const __m256i eqv = _mm256_set1_epi8('='), brv = _mm256_set1_epi8('[') ;
+    const __m256i nlv = _mm256_set1_epi8('\n') ;
+    const __m256i zero = _mm256_setzero_si256() ;
+    __m256i     c, e, b, l ;
+    uint64_t    t[4] ;
+    size_t      i = 0, k ;
+
+    while (i + 32 <= n) {
+        e = b = l = zero ;
+        for (k=0 ; k<255 && i + 32 <= n ; k++, i += 32) {
+            c = _mm256_loadu_si256((const __m256i *)(s + i)) ;
+            e = _mm256_sub_epi8(e, _mm256_cmpeq_epi8(c, eqv)) ;
+            b = _mm256_sub_epi8(b, _mm256_cmpeq_epi8(c, brv)) ;
+            l = _mm256_sub_epi8(l, _mm256_cmpeq_epi8(c, nlv)) ;
+        }
+        _mm256_storeu_si256((__m256i *)t, _mm256_sad_epu8(e, zero)) ;
+        *eq += (size_t)(t[0] + t[1] + t[2] + t[3]) ;
+        _mm256_storeu_si256((__m256i *)t, _mm256_sad_epu8(b, zero)) ;
+        *br += (size_t)(t[0] + t[1] + t[2] + t[3]) ;
+        _mm256_storeu_si256((__m256i *)t, _mm256_sad_epu8(l, zero)) ;
+        *nl += (size_t)(t[0] + t[1] + t[2] + t[3]) ;
+    }
+    count_scalar(s + i, n - i, eq, br, nl) ;
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Count the '=', '[' and '\n' characters of a buffer
+  @param    s   Buffer to scan
+  @param    n   Number of bytes to scan
+  @param    eq  Incremented by the number of '='
+  @param    br  Incremented by the number of '['
+  @param    nl  Incremented by the number of '\n'
+
+  Uses the widest vector instructions supported by the CPU.
+ */
+/*--------------------------------------------------------------------------*/
+static void count_entries(const char * s, size_t n, size_t * eq, size_t * br, size_t * nl)
+{
+#ifdef INISCAN_X86
+    if (__builtin_cpu_supports("avx2"))
+        count_avx2(s, n, eq, br, nl) ;
+    else
+        count_sse2(s, n, eq, br, nl) ;
+#else
+    count_scalar(s, n, eq, br, nl) ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the number of trailing zero bits of a non-zero word
+  @param    w   Word, not 0
+  @return   Index of the lowest bit set in w
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned ctz64(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(w) ;
+#else
+    unsigned n = 0 ;
+
+    while (!(w & 1)) {
+        w >>= 1 ;
+        n++ ;
+    }
+    return n ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the next structural character of a line
+  @param    idx     Index of the buffer holding the line, or NULL
+  @param    p       Where to start looking
+  @param    end     End of the line
+  @return   First structural character at or after p, or end
+
+  Without an index, the line is scanned one character at a time.
+ */
+/*--------------------------------------------------------------------------*/
+static char * next_structural(const line_index * idx, char * p, const char * end)
+{
+    size_t      off, w, last ;
+    uint64_t    m ;
+
+    if (idx == NULL) {
+        while (p < end && !structural[(unsigned char)*p])
+            p++ ;
+        return p ;
+    }
+    if (p >= end)
+        return (char*)end ;
+    off  = (size_t)(p - idx->base) ;
+    last = (size_t)(end - 1 - idx->base) / 64 ;
+    w = off / 64 ;
+    m = idx->bits[w] & (~(uint64_t)0 << (off % 64)) ;
+    while (m == 0) {
+        if (++w > last)
+            return (char*)end ;
+        m = idx->bits[w] ;
+    }
+    p = (char*)idx->base + w * 64 + ctz64(m) ;
+    return p < end ? p : (char*)end ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Unescape a quoted value in place
+  @param    idx     Index of the buffer holding the line, or NULL
+  @param    s       First character after the opening quote
+  @param    end     End of the line
+  @param    quote   Opening quote character
+  @return   End of the unescaped value
+
+  A backslash escapes the next character. The value ends at the first
+  unescaped quote, at the first newline or at the end of the line, and
+  whatever follows is ignored. Runs of plain characters are moved at once.
+ */
+/*--------------------------------------------------------------------------*/
+static char * unquote(const line_index * idx, char * s, const char * end, char quote)
+{
+    char * w = s ;
+    char * q ;
+
+    for (;;) {
+        q = next_structural(idx, s, end) ;
+        if (w != s)
+            memmove(w, s, (size_t)(q - s)) ;
+        w += q - s ;
+        if (q == end || *q == '\n' || *q == quote)
+            return w ;
+        if (*q == '\\') {
+            /* Escaped character */
+            if (q + 1 == end || q[1] == '\n')
+                return w ;
+            q++ ;
+        }
+        *w++ = *q ;
+        s = q + 1 ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Load a single line from an INI file
+  @param    line    Line to parse, may be concatenated multi-line input
+  @param    len     Length of line
+  @param    name    Section name or key found on the line
+  @param    value   Value found on the line
+  @param    idx     Index of the buffer holding the line, or NULL
+  @return   line_status value
+
+  The line is read once from left to right. Sections, keys and values are
+  returned as parts of the line, with blanks around them removed. Quoted
+  values are unescaped in place, which is the only modification made to
+  the line. The recognized syntax is:
+
+  - blank line: LINE_EMPTY
+  - line starting with '#' or ';': LINE_COMMENT
+  - "[section]": LINE_SECTION, the section name is set in name
+  - "key = value", "key = value ; comment", "key = 'value'" or
+    "key = \"value\"": LINE_VALUE, with key and value set in name and
+    value. An unquoted value stops at the first '#' or ';', an empty
+    value is allowed.
+  - anything else is LINE_ERROR.
+ */
+/*--------------------------------------------------------------------------*/
+static line_status iniparser_line(
+    char * line,
+    size_t len,
+    line_span * name,
+    line_span * value,
+    const line_index * idx)
+{
+    char * p = line ;
+    char * end = line + len ;
+    char * eq ;
+    char * v ;
+
+    /* Remove blanks around the line */
+    while (p < end && isspace((unsigned char)*p))
+        p++ ;
+    while (end > p && isspace((unsigned char)end[-1]))
+        end-- ;
+
+    if (p == end) {
+        /* Empty line */
+        return LINE_EMPTY ;
+    }
+    if (*p == '#' || *p == ';') {
+        /* Comment line */
+        return LINE_COMMENT ;
+    }
+    if (*p == '[' && end[-1] == ']') {
+        /* Section name, without square brackets and blanks */
+        v = next_structural(idx, ++p, end) ;
+        while (v < end && *v != '\n')
+            v = next_structural(idx, v + 1, end) ;
+        if (v > p && v[-1] == ']')
+            v-- ;
+        while (p < v && isspace((unsigned char)*p))
+            p++ ;
+        while (v > p && isspace((unsigned char)v[-1]))
+            v-- ;
+        name->s = p ;
+        name->len = (size_t)(v - p) ;
+        return LINE_SECTION ;
+    }
+
+    /* Key: everything up to the first '=' */
+    eq = next_structural(idx, p, end) ;
+    while (eq < end && *eq != '=')
+        eq = next_structural(idx, eq + 1, end) ;
+    if (eq == end || eq == p) {
+        /* Generate syntax error */
+        return LINE_ERROR ;
+    }
+    for (v = eq ; v > p && isspace((unsigned char)v[-1]) ; v--)
+        ;
+    name->s = p ;
+    name->len = (size_t)(v - p) ;
+
+    for (v = eq + 1 ; v < end && isspace((unsigned char)*v) ; v++)
+        ;
+    if (v + 1 < end && (*v == '"' || *v == '\'') && v[1] != '\n') {
+        /* Quoted value: blanks are kept, comments are allowed after it */
+        value->s = v + 1 ;
+        value->len = (size_t)(unquote(idx, v + 1, end, *v) - (v + 1)) ;
+        return LINE_VALUE ;
+    }
+    value->s = v ;
+    value->len = 0 ;
+    if (v == end || *v == ';' || *v == '#') {
+        /* Special cases: key=, key=; and key=# */
+        return LINE_VALUE ;
+    }
+    /* Unquoted value, up to an optional comment */
+    p = next_structural(idx, v, end) ;
+    while (p < end && *p != ';' && *p != '#')
+        p = next_structural(idx, p + 1, end) ;
+    while (p > v && isspace((unsigned char)p[-1]))
+        p-- ;
+    value->len = (size_t)(p - v) ;
+    return LINE_VALUE ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Tell whether a line is a section line without parsing it
+  @param    s   Line, with the blanks at its end removed
+  @param    n   Length of s
+  @return   1 if iniparser_line() would return LINE_SECTION, 0 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_section_line(const char * s, size_t n)
+{
+    const char * p ;
+
+    for (p = s ; p < s + n && isspace((unsigned char)*p) ; p++)
+        ;
+    return p < s + n && *p == '[' && s[n-1] == ']' ;
+}
+
+/** What a filter keeps of a section, see ini_filter_section() */
+typedef enum _ini_keep_ {
+    KEEP_NONE,      /* Nothing */
+    KEEP_KEYS,      /* The section and the keys matching a pattern */
+    KEEP_ALL        /* The section and all its keys */
+} ini_keep ;
+
+/** Sections and keys kept by a loader, see iniparser_options::filter */
+typedef struct _ini_filter_ {
+    const char * const *    patterns ;  /** NULL-terminated, or NULL to keep all */
+    int                     fold ;      /** Whether patterns ignore case */
+} ini_filter ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Match a string against a pattern
+  @param    pat     Pattern, where '*' matches any characters and '?' one
+  @param    plen    Length of pat
+  @param    s       String to match, need not be NUL-terminated
+  @param    len     Length of s
+  @param    fold    Whether to ignore case
+  @return   1 if s matches pat, 0 otherwise
+
+  On a mismatch, only the last '*' seen is retried one character further,
+  so that matching takes at most plen * len steps.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_glob(const char * pat, size_t plen, const char * s, size_t len, int fold)
+{
+    size_t  p = 0, i = 0 ;
+    size_t  star = plen, mark = 0 ;
+
+    while (i < len) {
+        if (p < plen && pat[p] == '*') {
+            star = p++ ;
+            mark = i ;
+        } else if (p < plen && (pat[p] == '?' || pat[p] == s[i] ||
+                                (fold && lwc(pat[p]) == lwc(s[i])))) {
+            p++ ;
+            i++ ;
+        } else if (star < plen) {
+            p = star + 1 ;
+            i = ++mark ;
+        } else {
+            return 0 ;
+        }
+    }
+    while (p < plen && pat[p] == '*')
+        p++ ;
+    return p == plen ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Tell what a filter keeps of a section
+  @param    f       Filter, or NULL to keep all
+  @param    name    Section name, "" for keys before any section
+  @param    len     Length of name
+  @return   ini_keep value
+
+  A pattern without ':' keeps the whole sections it matches, and a
+  "section:key" pattern the sections matched by its part before the ':'
+  with only the keys matched by the rest.
+ */
+/*--------------------------------------------------------------------------*/
+static ini_keep ini_filter_section(const ini_filter * f, const char * name, size_t len)
+{
+    const char * const *    pp ;
+    const char          *   colon ;
+    ini_keep                keep = KEEP_NONE ;
+
+    if (f == NULL || f->patterns == NULL)
+        return KEEP_ALL ;
+    for (pp = f->patterns ; *pp ; pp++) {
+        colon = strchr(*pp, ':') ;
+        if (ini_glob(*pp, colon ? (size_t)(colon - *pp) : strlen(*pp), name, len, f->fold)) {
+            if (colon == NULL)
+                return KEEP_ALL ;
+            keep = KEEP_KEYS ;
+        }
+    }
+    return keep ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Tell whether a filter keeps a key of a section kept with KEEP_KEYS
+  @param    f       Filter
+  @param    sec     Section name
+  @param    seclen  Length of sec
+  @param    key     Key, without its section
+  @param    keylen  Length of key
+  @return   1 if a "section:key" pattern matches, 0 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_filter_key(const ini_filter * f, const char * sec, size_t seclen,
+                          const char * key, size_t keylen)
+{
+    const char * const *    pp ;
+    const char          *   colon ;
+
+    for (pp = f->patterns ; *pp ; pp++) {
+        colon = strchr(*pp, ':') ;
+        if (colon && ini_glob(*pp, (size_t)(colon - *pp), sec, seclen, f->fold) &&
+            ini_glob(colon + 1, strlen(colon + 1), key, keylen, f->fold))
+            return 1 ;
+    }
+    return 0 ;
+}
+
+/** Input of iniparser_load_input() */
+typedef struct _ini_input_ {
+    FILE        *   in ;    /** File read block by block, or NULL */
+    const char  *   data ;  /** Memory copied block by block if in is NULL */
+    char        *   map ;   /** Memory parsed in place if in and data are NULL */
+    size_t          size ;  /** Size of data or map */
+    size_t          pos ;   /** Number of bytes of data already copied */
+    int             lines ; /** Number of lines parsed, set once parsed */
+} ini_input ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Read the next block of a file or of memory
+  @param    src     Input to read, with in or data set
+  @param    dst     Where to store the block
+  @param    n       Maximal number of bytes to read
+  @return   Number of bytes read, less than n at the end of the input
+ */
+/*--------------------------------------------------------------------------*/
+static size_t ini_read(ini_input * src, char * dst, size_t n)
+{
+    if (src->in)
+        return fread(dst, 1, n, src->in) ;
+    if (n > src->size - src->pos)
+        n = src->size - src->pos ;
+    if (n)
+        memcpy(dst, src->data + src->pos, n) ;
+    src->pos += n ;
+    return n ;
+}
+
+/** State of the parser, kept from one block of its input to the next */
+typedef struct _ini_parser_ {
+    const char              *   ininame ;       /** Name for error messages */
+    iniparser_section_cb        on_section ;    /** Section callback, or NULL */
+    iniparser_keyvalue_cb       on_keyvalue ;   /** Key callback, or NULL */
+    iniparser_line_error_cb     on_error ;      /** Error callback, or NULL */
+    void                    *   user ;          /** Passed to the callbacks */
+    const ini_filter        *   filter ;        /** Sections and keys to parse, or NULL */
+
+    char        *   buf ;   /** Block being parsed */
+    uint64_t    *   bits ;  /** Structural characters of buf, see line_index */
+    size_t          size ;  /** Capacity of buf, a multiple of 64 */
+    size_t          have ;  /** Number of bytes in buf */
+    size_t          pos ;   /** Number of bytes of buf already parsed */
+    int             eof ;   /** Whether buf holds the end of the input */
+
+    char        *   line ;      /** Multi-line value being joined, or error line */
+    size_t          linesz ;    /** Capacity of line */
+    size_t          last ;      /** Length of the multi-line value in line */
+    char        *   section ;   /** Current section */
+    size_t          secsz ;     /** Capacity of section */
+    size_t          seclen ;    /** Length of section */
+    int             lineno ;    /** Number of lines parsed so far */
+    ini_keep        keep ;      /** What filter keeps of the current section */
+} ini_parser ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make sure that a growable buffer holds a number of bytes
+  @param    buf     Buffer, NULL if not allocated yet
+  @param    size    Capacity of buf
+  @param    need    Number of bytes needed
+  @return   0, or -1 in case of allocation failure
+
+  The capacity is doubled until it is large enough, so that growing a
+  buffer byte by byte takes linear time.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_grow(char ** buf, size_t * size, size_t need)
+{
+    size_t  n = *size ? *size : 128 ;
+    char  * p ;
+
+    if (need <= *size)
+        return 0 ;
+    while (n < need)
+        n = n * 2 > n ? n * 2 : need ;
+    p = (char*) realloc(*buf, n) ;
+    if (p == NULL)
+        return -1 ;
+    *buf = p ;
+    *size = n ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Initialize a parser and allocate its buffers
+  @param    p           Parser to initialize
+  @param    map         Memory to parse in place, or NULL
+  @param    size        Initial size of the blocks of the input
+  @param    ininame     Name of the ini file (only used for nicer error messages)
+  @param    on_section  Called for each section, may be NULL
+  @param    on_keyvalue Called for each key, may be NULL
+  @param    on_error    Called for each line with a syntax error, may be NULL
+  @param    user        Passed to the callbacks
+  @param    filter      Sections and keys to hand to the callbacks, NULL for all
+  @return   0, or -1 in case of allocation failure
+
+  Without map, a buffer of size bytes is allocated to hold the blocks.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_parser_init(ini_parser * p, char * map, size_t size,
+                           const char * ininame,
+                           iniparser_section_cb on_section,
+                           iniparser_keyvalue_cb on_keyvalue,
+                           iniparser_line_error_cb on_error,
+                           void * user, const ini_filter * filter)
+{
+    p->ininame = ininame ;
+    p->on_section = on_section ;
+    p->on_keyvalue = on_keyvalue ;
+    p->on_error = on_error ;
+    p->user = user ;
+    p->filter = filter ;
+    p->keep = ini_filter_section(filter, "", 0) ;
+    p->buf = map ? map : (char*) malloc(size) ;
+    p->bits = (uint64_t*) malloc(size / 64 * sizeof *p->bits) ;
+    p->size = size ;
+    p->have = 0 ;
+    p->pos = 0 ;
+    p->eof = 0 ;
+    p->line = NULL ;
+    p->linesz = 0 ;
+    p->last = 0 ;
+    p->section = NULL ;
+    p->secsz = 0 ;
+    p->seclen = 0 ;
+    p->lineno = 0 ;
+    if (!p->buf || !p->bits) {
+        if (!map)
+            free(p->buf) ;
+        free(p->bits) ;
+        return -1 ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free the buffers of a parser
+  @param    p   Parser
+  @param    map Memory parsed in place, or NULL
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_parser_free(ini_parser * p, const char * map)
+{
+    if (!map)
+        free(p->buf) ;
+    free(p->bits) ;
+    free(p->line) ;
+    free(p->section) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Double the size of the blocks of a parser
+  @param    p   Parser
+  @param    own Whether the parser owns buf, which is then reallocated
+  @return   0, or -1 in case of allocation failure
+
+  The contents of buf and of its index are kept.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_parser_grow(ini_parser * p, int own)
+{
+    size_t      size = p->size * 2 ;
+    char      * buf ;
+    uint64_t  * bits ;
+
+    if (size < p->size)
+        return -1 ;
+    if (own) {
+        buf = (char*) realloc(p->buf, size) ;
+        if (buf == NULL)
+            return -1 ;
+        p->buf = buf ;
+    }
+    bits = (uint64_t*) realloc(p->bits, size / 64 * sizeof *bits) ;
+    if (bits == NULL)
+        return -1 ;
+    p->bits = bits ;
+    p->size = size ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the complete lines of the current block
+  @param    p   Parser, with buf indexed up to have
+  @return   0 once out of complete lines, -1 on a fatal error, or the
+            non-zero value returned by a callback
+
+  Lines are parsed in place, unless they are part of a multi-line value,
+  which is joined in the line buffer of the parser. Like with fgets(),
+  what follows a NUL character on a line is ignored. Unless eof is set,
+  parsing stops at the first line that does not end in buf, and pos is
+  left at its start: the caller then moves it to the start of the next
+  block, growing the blocks if it fills most of them.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_parse_block(ini_parser * p)
+{
+    char       * buf = p->buf ;
+    line_index   idx ;
+    line_span    name, val ;
+    size_t       n ;
+    char       * s ;
+    char       * q ;
+    char       * nul ;
+    char       * lim = buf + p->have ;
+    int          ret = 0 ;
+
+    idx.base = buf ;
+    idx.bits = p->bits ;
+
+    while (ret == 0) {
+        /* Find the end of the next line */
+        s = buf + p->pos ;
+        nul = NULL ;
+        for (q = next_structural(&idx, s, lim) ; q < lim && *q != '\n' ;
+             q = next_structural(&idx, q + 1, lim)) {
+            if (*q == '\0' && nul == NULL)
+                nul = q ;
+        }
+        if (q == lim && !p->eof)
+            break ;         /* Line is incomplete */
+        if (s == lim)
+            break ;         /* End of input */
+        if (q < lim)
+            q++ ;
+        n = (size_t)(q - s) ;
+        p->pos += n ;
+        p->lineno++ ;
+        if (nul)
+            n = (size_t)(nul - s) ;
+
+        if (p->last) {
+            if (ini_grow(&p->line, &p->linesz, p->last + n + 1) != 0)
+                goto mem_err ;
+            memcpy(p->line + p->last, s, n) ;
+            s = p->line ;
+            n += p->last ;
+        }
+        if (n <= 1)
+            continue;
+        /* Ignore \n and spaces at end of line */
+        while (n > 0 && isspace((unsigned char)s[n-1]))
+            n-- ;
+        /* Detect multi-line */
+        if (n > 0 && s[n-1]=='\\') {
+            /* Multi-line value */
+            if (s != p->line) {
+                if (ini_grow(&p->line, &p->linesz, n) != 0)
+                    goto mem_err ;
+                memcpy(p->line, s, n - 1) ;
+            }
+            p->last = n - 1 ;
+            continue ;
+        } else {
+            p->last = 0 ;
+        }
+        if (s == p->line)
+            p->line[n] = 0 ;
+        if (p->keep == KEEP_NONE && !ini_section_line(s, n))
+            continue ;      /* Filtered out, not even parsed */
+        switch (iniparser_line(s, n, &name, &val, s == p->line ? NULL : &idx)) {
+            case LINE_EMPTY:
+            case LINE_COMMENT:
+            break ;
+
+            case LINE_SECTION:
+            if (ini_grow(&p->section, &p->secsz, name.len + 1) != 0)
+                goto mem_err ;
+            memcpy(p->section, name.s, name.len);
+            p->seclen = name.len ;
+            p->keep = ini_filter_section(p->filter, name.s, name.len) ;
+            if (p->on_section && p->keep != KEEP_NONE)
+                ret = p->on_section(p->section, p->seclen, p->user) ;
+            break ;
+
+            case LINE_VALUE:
+            if (p->keep == KEEP_KEYS &&
+                !ini_filter_key(p->filter, p->section, p->seclen, name.s, name.len))
+                break ;
+            if (p->on_keyvalue)
+                ret = p->on_keyvalue(p->seclen ? p->section : "", p->seclen,
+                                     name.s, name.len, val.s, val.len, p->user) ;
+            break ;
+
+            case LINE_ERROR:
+            if (s != p->line) {
+                if (ini_grow(&p->line, &p->linesz, n + 1) != 0)
+                    goto mem_err ;
+                memcpy(p->line, s, n) ;
+                p->line[n] = 0 ;
+            }
+            if (p->on_error)
+                ret = p->on_error(p->line, p->lineno, p->user) ;
+            break;
+
+            default:
+            break ;
+        }
+    }
+    return ret ;
+
+mem_err:
+    iniparser_error_callback("iniparser: memory allocation failure\n");
+    return -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini data from a file or from memory
+  @param    src         Input to parse
+  @param    ininame     Name of the ini file (only used for nicer error messages)
+  @param    on_section  Called for each section, may be NULL
+  @param    on_keyvalue Called for each key, may be NULL
+  @param    on_error    Called for each line with a syntax error, may be NULL
+  @param    user        Passed to the callbacks
+  @param    filter      Sections and keys to hand to the callbacks, NULL for all
+  @return   0 once the whole input is parsed, -1 on a fatal error, or the
+            non-zero value returned by a callback
+
+  A file or read-only memory is read in blocks, and the structural
+  characters of each block are indexed before its lines are parsed by
+  ini_parse_block(). Blocks start at INIBLOCKSZ bytes, and double when a
+  line fills more than half of one, so that lines of any length are
+  parsed in linear time.
+
+  Writable memory is indexed and parsed the same way without a copy, one
+  window of a block at a time. Values handed to on_keyvalue then point
+  into it, unless they span several lines.
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_parse_input(ini_input * src, const char * ininame,
+                                 iniparser_section_cb on_section,
+                                 iniparser_keyvalue_cb on_keyvalue,
+                                 iniparser_line_error_cb on_error,
+                                 void * user, const ini_filter * filter)
+{
+    char      * map = src->map ;
+    size_t      mapsize = src->size ;
+    ini_parser  p ;
+    size_t      n ;
+    int         ret ;
+
+    if (ini_parser_init(&p, map, INIBLOCKSZ, ininame,
+                        on_section, on_keyvalue, on_error, user, filter) != 0) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    p.eof = (map && mapsize == 0) ;
+
+    while ((ret = ini_parse_block(&p)) == 0 && !p.eof) {
+        if (p.have - p.pos > p.size / 2 && ini_parser_grow(&p, !map) != 0) {
+            iniparser_error_callback("iniparser: memory allocation failure\n");
+            ret = -1 ;
+            break ;
+        }
+        /* Move the window to the incomplete line and read more */
+        if (!map) {
+            memmove(p.buf, p.buf + p.pos, p.have - p.pos) ;
+            p.have -= p.pos ;
+            n = ini_read(src, p.buf + p.have, p.size - p.have) ;
+            if (n < p.size - p.have)
+                p.eof = 1 ;
+            p.have += n ;
+        } else {
+            p.buf += p.pos ;
+            p.have = (size_t)(map + mapsize - p.buf) ;
+            if (p.have > p.size)
+                p.have = p.size ;
+            else
+                p.eof = 1 ;
+        }
+        p.pos = 0 ;
+        scan_structural(p.buf, p.have, p.bits) ;
+    }
+    src->lines = p.lineno ;
+    ini_parser_free(&p, map) ;
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file, handing its contents to callbacks
+  @param    in          File to read.
+  @param    ininame     Name of the ini file (only used for nicer error messages)
+  @param    on_section  Called for each section, may be NULL
+  @param    on_keyvalue Called for each key, may be NULL
+  @param    on_error    Called for each line with a syntax error, may be NULL
+  @param    user        Passed to the callbacks
+  @return   0 once the whole file is parsed, -1 on a fatal error, or the
+            non-zero value returned by a callback
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_parse_cb(FILE * in, const char * ininame,
+                       iniparser_section_cb on_section,
+                       iniparser_keyvalue_cb on_keyvalue,
+                       iniparser_line_error_cb on_error,
+                       void * user)
+{
+    ini_input src ;
+
+    if (in == NULL)
+        return -1 ;
+    memset(&src, 0, sizeof src) ;
+    src.in = in ;
+    return iniparser_parse_input(&src, ininame, on_section, on_keyvalue, on_error,
+                                 user, NULL) ;
+}
+
+/** State of a loader, passed to the callbacks of iniparser_parse_input() */
+typedef struct _ini_loader_ {
+    dictionary  *   dict ;      /** Dictionary being filled */
+    const char  *   ininame ;   /** Name of the ini file */
+    int             errs ;      /** Number of syntax errors */
+    int             mem_err ;   /** Set when the dictionary could not grow */
+    char        *   tmp ;       /** "section:key", NULL if not allocated yet */
+    size_t          tmpsz ;     /** Capacity of tmp */
+    ini_filter      filter ;    /** Sections and keys to load */
+} ini_loader ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Store a section in the dictionary of a loader
+  @param    name    Section name
+  @param    len     Length of name
+  @param    user    Loader
+  @return   0, or -1 in case of allocation failure
+ */
+/*--------------------------------------------------------------------------*/
+static int load_section(const char * name, size_t len, void * user)
+{
+    ini_loader * ld = (ini_loader*) user ;
+
+    ld->mem_err = dictionary_set_lower(ld->dict, name, len, NULL, 0) ;
+    return ld->mem_err ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Store a key in the dictionary of a loader
+  @param    section Section name
+  @param    seclen  Length of section
+  @param    key     Key
+  @param    keylen  Length of key
+  @param    val     Value, in the parsed buffer
+  @param    vallen  Length of val
+  @param    user    Loader
+  @return   0, or -1 in case of allocation failure
+
+  The key is stored as "section:key". Values lying in the buffer attached
+  to the dictionary are borrowed from it.
+ */
+/*--------------------------------------------------------------------------*/
+static int load_keyvalue(const char * section, size_t seclen,
+                         const char * key, size_t keylen,
+                         const char * val, size_t vallen, void * user)
+{
+    ini_loader * ld = (ini_loader*) user ;
+
+    if (ini_grow(&ld->tmp, &ld->tmpsz, seclen + 1 + keylen) != 0)
+        return ld->mem_err = -1 ;
+    memcpy(ld->tmp, section, seclen);
+    ld->tmp[seclen] = ':' ;
+    memcpy(ld->tmp + seclen + 1, key, keylen);
+    if (ld->dict->ext)
+        ld->mem_err = dictionary_set_borrowed(ld->dict, ld->tmp, seclen + 1 + keylen,
+                                              (char*)val, vallen);
+    else
+        ld->mem_err = dictionary_set_lower(ld->dict, ld->tmp, seclen + 1 + keylen,
+                                           val, vallen);
+    return ld->mem_err ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Report a syntax error found by a loader
+  @param    line    Line with the error
+  @param    lineno  Number of the line
+  @param    user    Loader
+  @return   0, to go on parsing
+ */
+/*--------------------------------------------------------------------------*/
+static int load_error(const char * line, int lineno, void * user)
+{
+    ini_loader * ld = (ini_loader*) user ;
+
+    iniparser_error_callback(
+      "iniparser: syntax error in %s (%d):\n-> %s\n",
+      ld->ininame,
+      lineno,
+      line);
+    ld->errs++ ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start a loader
+  @param    ld      Loader to initialize
+  @param    ininame Name of the ini file (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   0, or -1 if the dictionary cannot be allocated
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_loader_start(ini_loader * ld, const char * ininame,
+                            const iniparser_options * opts)
+{
+    unsigned flags = DICTIONARY_ARENA ;
+
+    if (opts && (opts->flags & INIPARSER_SEEDED))
+        flags |= DICTIONARY_SEEDED ;
+    if (opts && (opts->flags & INIPARSER_NO_ARENA))
+        flags &= ~DICTIONARY_ARENA ;
+    if (opts && (opts->flags & INIPARSER_CASE_SENSITIVE))
+        flags |= DICTIONARY_CASE_SENSITIVE ;
+    ld->dict = dictionary_new_flags(0, flags, opts ? opts->seed : NULL) ;
+    ld->ininame = ininame ;
+    ld->errs = 0 ;
+    ld->mem_err = 0 ;
+    ld->tmp = NULL ;
+    ld->tmpsz = 0 ;
+    ld->filter.patterns = opts ? opts->filter : NULL ;
+    ld->filter.fold = !(flags & DICTIONARY_CASE_SENSITIVE) ;
+    return ld->dict ? 0 : -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    End a loader and return its dictionary
+  @param    ld      Loader
+  @param    ret     Value returned by the parser
+  @return   Dictionary of the loader, or NULL if the input had errors
+
+  After a syntax error or a failure of the parser, the dictionary is
+  freed. After a failure to store an entry, the entries stored so far are
+  returned.
+ */
+/*--------------------------------------------------------------------------*/
+static dictionary * ini_loader_end(ini_loader * ld, int ret)
+{
+    free(ld->tmp) ;
+    ld->tmp = NULL ;
+    if (ret != 0) {
+        if (!ld->mem_err) {
+            /* The parser failed, and already reported it */
+            dictionary_del(ld->dict) ;
+            return NULL ;
+        }
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+    }
+    if (ld->errs) {
+        dictionary_del(ld->dict);
+        return NULL ;
+    }
+    return ld->dict ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Estimate the number of entries of an input before parsing it
+  @param    src     Input about to be parsed
+  @param    n       Estimated number of entries, sections included
+  @param    nsec    Estimated number of sections
+  @return   0, or -1 if the size of the input is unknown
+
+  Each key is on a line holding a '=', and each section on a line holding
+  a '[', so that counting them gives the number of entries, or a little
+  more if values or comments hold some too. Memory is counted whole. Of a
+  regular file, only the next block is counted and the counts are scaled
+  to the size of the file, which is read with pread() so that the stream
+  is left untouched.
+
+  Each entry takes a line of its own, so that the estimate never exceeds
+  the number of lines: values full of '=' or '[' do not make the loader
+  allocate more than the input holds entries.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_estimate(ini_input * src, size_t * n, size_t * nsec)
+{
+    size_t  eq = 0, br = 0, nl = 0 ;
+    size_t  total ;
+
+    if (src->map) {
+        total = src->size ;
+        count_entries(src->map, total, &eq, &br, &nl) ;
+    } else if (src->in == NULL) {
+        if (src->data == NULL)
+            return -1 ;
+        total = src->size - src->pos ;
+        count_entries(src->data + src->pos, total, &eq, &br, &nl) ;
+    } else {
+#ifndef _WIN32
+        struct stat st ;
+        long        start ;
+        char      * blk ;
+        ssize_t     got ;
+
+        if (fstat(fileno(src->in), &st) != 0 || !S_ISREG(st.st_mode))
+            return -1 ;
+        start = ftell(src->in) ;
+        if (start < 0 || st.st_size <= (off_t)start)
+            return -1 ;
+        total = (size_t)(st.st_size - start) ;
+        blk = (char*) malloc(INIBLOCKSZ) ;
+        if (blk == NULL)
+            return -1 ;
+        got = pread(fileno(src->in), blk, INIBLOCKSZ, (off_t)start) ;
+        if (got > 0)
+            count_entries(blk, (size_t)got, &eq, &br, &nl) ;
+        free(blk) ;
+        if (got <= 0)
+            return -1 ;
+        if ((size_t)got < total) {
+            /* Scale the counts to the whole file, with a margin */
+            eq = (size_t)((double)eq * (double)total / (double)got * 1.0625) ;
+            br = (size_t)((double)br * (double)total / (double)got * 1.0625) ;
+            nl = (size_t)((double)nl * (double)total / (double)got * 1.0625) ;
+        }
+#else
+        return -1 ;
+#endif
+    }
+    /* The last line may not end with a newline */
+    *n = eq + br < nl + 1 ? eq + br : nl + 1 ;
+    *nsec = br < *n ? br : *n ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room in the dictionary of a loader for the entries of an input
+  @param    ld      Loader about to parse src
+  @param    src     Input about to be parsed
+
+  Nothing is reserved for a loader with a filter, which may keep little
+  of the input.
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_reserve(ini_loader * ld, ini_input * src)
+{
+    size_t n, nsec ;
+
+    /* Allocate the dictionary once, it still grows if the estimate is short */
+    if (ld->filter.patterns == NULL && ini_estimate(src, &n, &nsec) == 0)
+        dictionary_reserve(ld->dict, n, nsec < UINT_MAX / 4 ? (unsigned)nsec : UINT_MAX / 4) ;
+}
+
+/** Syntax error found in a part, reported once all parts are parsed */
+typedef struct _ini_error_ {
+    struct _ini_error_  *   next ;      /** Next error of the part, or NULL */
+    int                     lineno ;    /** Line number within the part */
+} ini_error ;
+
+/**
+ * Part of an input, or file, parsed into a partial dictionary, possibly on
+ * another thread, see ini_load_parts() and iniparser_load_many()
+ */
+typedef struct _ini_part_ {
+    ini_loader      ld ;        /** Loader filling the partial dictionary, first */
+    ini_input       src ;       /** Part of the input */
+    const char  *   path ;      /** File to open as src, or NULL */
+    int             open_err ;  /** Set when path cannot be opened */
+    int             ret ;       /** Value returned by the parser */
+    ini_error   *   errs ;      /** Syntax errors, in order */
+    ini_error  **   tail ;      /** Where to link the next error */
+} ini_part ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Record a syntax error found in a part
+  @param    line    Line with the error
+  @param    lineno  Number of the line in the part
+  @param    user    Part
+  @return   0, or -1 in case of allocation failure
+
+  The line is kept after the error itself.
+ */
+/*--------------------------------------------------------------------------*/
+static int part_error(const char * line, int lineno, void * user)
+{
+    ini_part  * part = (ini_part*) user ;
+    size_t      len = strlen(line) ;
+    ini_error * e = (ini_error*) malloc(sizeof *e + len + 1) ;
+
+    if (e == NULL)
+        return part->ld.mem_err = -1 ;
+    e->next = NULL ;
+    e->lineno = lineno ;
+    memcpy(e + 1, line, len + 1) ;
+    *part->tail = e ;
+    part->tail = &e->next ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse a part into its partial dictionary
+  @param    arg     Part
+  @return   NULL
+
+  A part with a path opens the file and parses it whole.
+ */
+/*--------------------------------------------------------------------------*/
+static void * ini_part_run(void * arg)
+{
+    ini_part * part = (ini_part*) arg ;
+
+    if (part->path && (part->src.in = fopen(part->path, "r")) == NULL) {
+        part->open_err = 1 ;
+        return NULL ;
+    }
+    ini_reserve(&part->ld, &part->src) ;
+    /* The loader is the first member of the part, both are the user */
+    part->ret = iniparser_parse_input(&part->src, part->ld.ininame, load_section,
+                                      load_keyvalue, part_error, part,
+                                      &part->ld.filter) ;
+    if (part->path)
+        fclose(part->src.in) ;
+    return NULL ;
+}
+
+#ifdef INITHREADS
+/** Parts handed out to a pool of threads, see ini_run_parts() */
+typedef struct _ini_pool_ {
+    ini_part        *   parts ; /** Parts to parse */
+    size_t              n ;     /** Number of parts */
+    size_t              next ;  /** First part not handed out yet */
+    pthread_mutex_t     lock ;  /** Protects next */
+} ini_pool ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the parts of a pool until none is left
+  @param    arg     Pool
+  @return   NULL
+ */
+/*--------------------------------------------------------------------------*/
+static void * ini_pool_run(void * arg)
+{
+    ini_pool  * pool = (ini_pool*) arg ;
+    size_t      i ;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock) ;
+        i = pool->next < pool->n ? pool->next++ : pool->n ;
+        pthread_mutex_unlock(&pool->lock) ;
+        if (i == pool->n)
+            return NULL ;
+        ini_part_run(&pool->parts[i]) ;
+    }
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse parts on a pool of threads
+  @param    parts   Parts to parse
+  @param    n       Number of parts
+  @param    threads Number of threads, the calling thread included
+
+  Each thread takes the next part left until all are parsed, so that
+  parts of different sizes keep all threads busy. Without threads, or if
+  none can be started, the parts are parsed in turn on the calling thread.
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_run_parts(ini_part * parts, size_t n, unsigned threads)
+{
+    size_t      i ;
+#ifdef INITHREADS
+    ini_pool    pool ;
+    pthread_t * tids ;
+    size_t      started = 0 ;
+
+    if (threads > n)
+        threads = (unsigned)n ;
+    if (threads > 1 && pthread_mutex_init(&pool.lock, NULL) == 0) {
+        pool.parts = parts ;
+        pool.n = n ;
+        pool.next = 0 ;
+        tids = (pthread_t*) malloc((threads - 1) * sizeof *tids) ;
+        while (tids && started < threads - 1 &&
+               pthread_create(&tids[started], NULL, ini_pool_run, &pool) == 0)
+            started++ ;
+        ini_pool_run(&pool) ;
+        for (i = 0 ; i < started ; i++)
+            pthread_join(tids[i], NULL) ;
+        free(tids) ;
+        pthread_mutex_destroy(&pool.lock) ;
+        return ;
+    }
+#else
+    (void)threads ;
+#endif
+    for (i = 0 ; i < n ; i++)
+        ini_part_run(&parts[i]) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room in a dictionary for the entries of parsed parts
+  @param    d       Dictionary the parts are about to be merged into
+  @param    parts   Parsed parts
+  @param    n       Number of parts
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_parts_reserve(dictionary * d, const ini_part * parts, size_t n)
+{
+    size_t  total = 0, nsec = 0 ;
+    size_t  i ;
+
+    for (i = 0 ; i < n ; i++) {
+        total += parts[i].ld.dict->n ;
+        nsec += parts[i].ld.dict->nsec ;
+    }
+    dictionary_reserve(d, total, nsec < UINT_MAX / 4 ? (unsigned)nsec : UINT_MAX / 4) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start the loader of a part, hashing like another dictionary
+  @param    part    Part to start
+  @param    ininame Name of the input of the part (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @param    d       Dictionary the part is merged into
+  @return   0, or -1 if the dictionary cannot be allocated
+
+  The partial dictionary is created with the hash seed of d, so that no
+  seed is drawn for it and dictionary_merge() reuses its hash values.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_part_start(ini_part * part, const char * ininame,
+                          const iniparser_options * opts, const dictionary * d)
+{
+    iniparser_options popts ;
+
+    if (opts)
+        popts = *opts ;
+    else
+        memset(&popts, 0, sizeof popts) ;
+    popts.seed = (const unsigned char*) d->seed ;
+    part->tail = &part->errs ;
+    return ini_loader_start(&part->ld, ininame, &popts) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free parts and their partial dictionaries
+  @param    parts   Parts, allocated with calloc()
+  @param    n       Number of parts
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_parts_free(ini_part * parts, size_t n)
+{
+    ini_error * e ;
+    size_t      i ;
+
+    for (i = 0 ; i < n ; i++) {
+        while ((e = parts[i].errs) != NULL) {
+            parts[i].errs = e->next ;
+            free(e) ;
+        }
+        free(parts[i].ld.tmp) ;
+        dictionary_del(parts[i].ld.dict) ;
+    }
+    free(parts) ;
+}
+
+#ifdef INITHREADS
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Tell whether an input may be parsed from a line on
+  @param    buf     Input
+  @param    size    Size of buf
+  @param    off     Offset of the start of a line, after a newline
+  @return   1 if the line is a section parsed the same from there, else 0
+
+  The line at off must be a section, so that the parser gets the current
+  section from it, and the previous line must end a value: it holds
+  something else than blanks, and does not end with a backslash. NUL
+  characters, which cut lines short, are avoided altogether.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_section_start(const char * buf, size_t size, size_t off)
+{
+    const char * s = buf + off ;
+    const char * e = memchr(s, '\n', size - off) ;
+    const char * prev ;
+
+    if (e == NULL)
+        e = buf + size ;
+    if (memchr(s, '\0', (size_t)(e - s)) != NULL)
+        return 0 ;
+    while (s < e && isspace((unsigned char)*s))
+        s++ ;
+    while (e > s && isspace((unsigned char)e[-1]))
+        e-- ;
+    if (s == e || *s != '[' || e[-1] != ']')
+        return 0 ;
+
+    e = buf + off - 1 ;
+    for (prev = e ; prev > buf && prev[-1] != '\n' ; prev--)
+        ;
+    if (memchr(prev, '\0', (size_t)(e - prev)) != NULL)
+        return 0 ;
+    while (e > prev && isspace((unsigned char)e[-1]))
+        e-- ;
+    return e > prev && e[-1] != '\\' ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Split an input into parts parsed independently
+  @param    buf     Input
+  @param    size    Size of buf
+  @param    n       Number of parts wanted
+  @param    cut     Offsets of the parts, n + 1 of them
+  @return   Number of parts, at most n
+
+  The input is cut in n parts of about the same size, each part starting
+  at the first section line accepted by ini_section_start() after its
+  expected start, so that no multi-line value is ever split. Part i is
+  from cut[i] to cut[i+1], and fewer parts are made when sections are
+  too scarce.
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned ini_split(const char * buf, size_t size, unsigned n, size_t * cut)
+{
+    const char * end = buf + size ;
+    const char * s ;
+    const char * q ;
+    unsigned     k = 0 ;
+    unsigned     i ;
+    size_t       off ;
+
+    cut[0] = 0 ;
+    for (i = 1 ; i < n ; i++) {
+        off = size / n * i ;
+        if (off <= cut[k])
+            off = cut[k] + 1 ;
+        for (q = buf + off - 1 ; q < end ; q = s) {
+            q = memchr(q, '\n', (size_t)(end - q)) ;
+            if (q == NULL)
+                break ;
+            for (s = q + 1 ; s < end && *s != '\n' && isspace((unsigned char)*s) ; s++)
+                ;
+            if (s < end && *s == '[' && ini_section_start(buf, size, (size_t)(q + 1 - buf)))
+                break ;
+        }
+        if (q == NULL || q >= end)
+            break ;
+        cut[++k] = (size_t)(q + 1 - buf) ;
+    }
+    cut[++k] = size ;
+    return k ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the parts of an input on several threads into a loader
+  @param    ld      Loader, with its dictionary attached to src->map if borrowing
+  @param    src     Input in memory, with map or data set
+  @param    cut     Offsets of the parts, see ini_split()
+  @param    n       Number of parts
+  @return   0, -1 on a fatal error, or the first non-zero value returned
+            by a callback
+
+  Each part is parsed into a dictionary of its own, with the hash seed of
+  ld's dictionary, each on a thread. The partial dictionaries are then
+  merged into ld's in file order, so that a key set in several parts
+  keeps its position from the first one and its value from the last one,
+  and the syntax errors are reported with their line number in the whole
+  input: the dictionary and the messages are those of a single parse.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_load_parts(ini_loader * ld, const ini_input * src,
+                          const size_t * cut, unsigned n,
+                          const iniparser_options * opts)
+{
+    ini_part    *   parts ;
+    ini_error   *   e ;
+    unsigned        i ;
+    int             lines = 0 ;
+    int             ret = 0 ;
+
+    parts = (ini_part*) calloc(n, sizeof *parts) ;
+    if (parts == NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    for (i = 0 ; i < n ; i++) {
+        if (ini_part_start(parts + i, ld->ininame, opts, ld->dict) != 0) {
+            iniparser_error_callback("iniparser: memory allocation failure\n");
+            ini_parts_free(parts, n) ;
+            return -1 ;
         }
-        /* Get rid of \n and spaces at end of line */
-        while ((len>=0) &&
-                ((line[len]=='\n') || (isspace((unsigned char)line[len])))) {
-            line[len]=0 ;
-            len-- ;
+        if (ld->dict->ext)
+            dictionary_attach(parts[i].ld.dict, ld->dict->ext, ld->dict->extsize, NULL) ;
+        if (src->map)
+            parts[i].src.map = src->map + cut[i] ;
+        else
+            parts[i].src.data = src->data + cut[i] ;
+        parts[i].src.size = cut[i+1] - cut[i] ;
+        parts[i].tail = &parts[i].errs ;
+    }
+    ini_run_parts(parts, n, n) ;
+    ini_parts_reserve(ld->dict, parts, n) ;
+
+    /* Merge the parts in order, up to the first one that failed */
+    for (i = 0 ; i < n && ret == 0 ; i++) {
+        for (e = parts[i].errs ; e ; e = e->next)
+            load_error((const char*)(e + 1), lines + e->lineno, ld) ;
+        lines += parts[i].src.lines ;
+        if (dictionary_merge(ld->dict, parts[i].ld.dict) != 0)
+            ld->mem_err = -1 ;
+        else
+            ld->mem_err = parts[i].ld.mem_err ;
+        ret = parts[i].ret ? parts[i].ret : ld->mem_err ;
+    }
+    ini_parts_free(parts, n) ;
+    return ret ;
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy the patterns of a filter
+  @param    patterns    NULL-terminated patterns
+  @return   Copy in a single allocation, to free, or NULL in case of error
+ */
+/*--------------------------------------------------------------------------*/
+static const char * const * ini_filter_dup(const char * const * patterns)
+{
+    size_t      n, size ;
+    char     ** copy ;
+    char      * s ;
+
+    size = sizeof *copy ;
+    for (n = 0 ; patterns[n] ; n++)
+        size += sizeof *copy + strlen(patterns[n]) + 1 ;
+    copy = (char**) malloc(size) ;
+    if (copy == NULL)
+        return NULL ;
+    s = (char*)(copy + n + 1) ;
+    for (n = 0 ; patterns[n] ; n++) {
+        copy[n] = s ;
+        size = strlen(patterns[n]) + 1 ;
+        memcpy(s, patterns[n], size) ;
+        s += size ;
+    }
+    copy[n] = NULL ;
+    return (const char * const *) copy ;
+}
+
+/** Occurrence of a section in the input of a lazy dictionary */
+typedef struct _ini_range_ {
+    size_t      off ;   /** Offset of the section line in the input */
+    size_t      len ;   /** Size up to the next section line */
+    int         line ;  /** Number of lines before off */
+    unsigned    sec ;   /** Section number in the section table */
+    unsigned    next ;  /** Index + 1 of the next range of the section, or 0 */
+} ini_range ;
+
+/**
+ * Sections of a dictionary loaded with INIPARSER_LAZY left to parse,
+ * attached to it as dictionary::lazy
+ */
+typedef struct _ini_lazy_ {
+    ini_range   *   ranges ;    /** Ranges of the sections, in input order */
+    unsigned        nranges ;   /** Number of ranges */
+    unsigned        rsize ;     /** Allocated size of ranges */
+    unsigned    *   first ;     /** Per section: index + 1 of its first range, 0 once parsed */
+    unsigned    *   last ;      /** Per section: index + 1 of its last range */
+    unsigned        nsec ;      /** Allocated size of first and last */
+    unsigned        left ;      /** Number of sections left to parse */
+    ini_filter      filter ;    /** Copy of the filter of the loader */
+#ifdef INITHREADS
+    pthread_rwlock_t lock ;     /** Held for writing while parsing, for reading by lookups */
+#endif
+    char            ininame[1] ; /** Name of the input, for error messages */
+} ini_lazy ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free the sections left to parse of a lazy dictionary
+  @param    p   ini_lazy
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_lazy_free(void * p)
+{
+    ini_lazy * lz = (ini_lazy*) p ;
+
+    free((void*)lz->filter.patterns) ;
+    free(lz->ranges) ;
+    free(lz->first) ;
+    free(lz->last) ;
+#ifdef INITHREADS
+    pthread_rwlock_destroy(&lz->lock) ;
+#endif
+    free(lz) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Record a range of the input as part of a section left to parse
+  @param    lz      Sections left to parse
+  @param    r       Range, with its section set
+  @return   0, or -1 in case of allocation failure
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_lazy_add(ini_lazy * lz, const ini_range * r)
+{
+    ini_range * ranges ;
+    unsigned  * first ;
+    unsigned  * last ;
+    unsigned    n ;
+
+    if (lz->nranges == lz->rsize) {
+        n = lz->rsize ? 2 * lz->rsize : 16 ;
+        if ((ranges = (ini_range*) realloc(lz->ranges, n * sizeof *ranges)) == NULL)
+            return -1 ;
+        lz->ranges = ranges ;
+        lz->rsize = n ;
+    }
+    if (r->sec >= lz->nsec) {
+        n = lz->nsec ? 2 * lz->nsec : 16 ;
+        if (n <= r->sec)
+            n = r->sec + 1 ;
+        if ((first = (unsigned*) realloc(lz->first, n * sizeof *first)) == NULL)
+            return -1 ;
+        lz->first = first ;
+        if ((last = (unsigned*) realloc(lz->last, n * sizeof *last)) == NULL)
+            return -1 ;
+        lz->last = last ;
+        memset(first + lz->nsec, 0, (n - lz->nsec) * sizeof *first) ;
+        memset(last + lz->nsec, 0, (n - lz->nsec) * sizeof *last) ;
+        lz->nsec = n ;
+    }
+    lz->ranges[lz->nranges] = *r ;
+    lz->ranges[lz->nranges].next = 0 ;
+    lz->nranges++ ;
+    if (lz->first[r->sec] == 0) {
+        lz->first[r->sec] = lz->nranges ;
+        lz->left++ ;
+    } else {
+        lz->ranges[lz->last[r->sec] - 1].next = lz->nranges ;
+    }
+    lz->last[r->sec] = lz->nranges ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse a range of the input attached to a dictionary
+  @param    ld      Loader of the dictionary, errors are reported to it
+  @param    r       Range to parse
+  @return   0, -1 on a fatal error, or the first non-zero value returned
+            by a callback
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_lazy_parse(ini_loader * ld, const ini_range * r)
+{
+    ini_part    part ;
+    ini_error * e ;
+
+    memset(&part, 0, sizeof part) ;
+    part.ld.dict = ld->dict ;
+    part.ld.ininame = ld->ininame ;
+    part.ld.filter = ld->filter ;
+    part.src.map = ld->dict->ext + r->off ;
+    part.src.size = r->len ;
+    part.tail = &part.errs ;
+    ini_part_run(&part) ;
+    while ((e = part.errs) != NULL) {
+        part.errs = e->next ;
+        load_error((const char*)(e + 1), r->line + e->lineno, ld) ;
+        free(e) ;
+    }
+    free(part.ld.tmp) ;
+    ld->mem_err = part.ld.mem_err ;
+    return part.ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the ranges of the sections left to parse of a dictionary
+  @param    d       Lazy dictionary
+  @param    sec     Section number to parse, or UINT_MAX for all sections
+
+  Ranges are parsed in input order, so that parsing all sections at once
+  stores the keys in the order of a full load. The section table is only
+  walked through the section numbers, which never change. Called with the
+  dictionary locked for writing.
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_lazy_run(dictionary * d, unsigned sec)
+{
+    ini_lazy  * lz = (ini_lazy*) d->lazy ;
+    ini_loader  ld ;
+    unsigned    r ;
+    int         ret = 0 ;
+
+    memset(&ld, 0, sizeof ld) ;
+    ld.dict = d ;
+    ld.ininame = lz->ininame ;
+    ld.filter = lz->filter ;
+    if (sec != UINT_MAX) {
+        r = lz->first[sec] ;
+        /* Even if parsing fails, the section is never parsed twice */
+        lz->first[sec] = 0 ;
+        lz->left-- ;
+        for ( ; r && ret == 0 ; r = lz->ranges[r-1].next)
+            ret = ini_lazy_parse(&ld, lz->ranges + r - 1) ;
+    } else {
+        for (r = 0 ; r < lz->nranges && ret == 0 ; r++)
+            if (lz->first[lz->ranges[r].sec])
+                ret = ini_lazy_parse(&ld, lz->ranges + r) ;
+        lz->left = 0 ;
+    }
+    if (ret != 0 && ld.mem_err)
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+    if (lz->left == 0) {
+        /* Lookups still take the lock, which stays until dictionary_del() */
+        free((void*)lz->filter.patterns) ;
+        free(lz->ranges) ;
+        free(lz->first) ;
+        free(lz->last) ;
+        lz->filter.patterns = NULL ;
+        lz->ranges = NULL ;
+        lz->first = lz->last = NULL ;
+        lz->nranges = lz->rsize = lz->nsec = 0 ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lock a dictionary loaded with INIPARSER_LAZY
+  @param    d       Dictionary, left alone unless it is lazy
+  @param    write   Non-zero to parse sections, zero to look keys up
+
+  Lookups hold the lock for reading while they read the dictionary, and
+  sections are parsed holding it for writing, so that the accessors taking
+  a const dictionary can be called by several threads at once.
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_lazy_lock(const dictionary * d, int write)
+{
+#ifdef INITHREADS
+    ini_lazy * lz ;
+
+    if (d == NULL || d->lazy == NULL)
+        return ;
+    lz = (ini_lazy*) d->lazy ;
+    if (write)
+        pthread_rwlock_wrlock(&lz->lock) ;
+    else
+        pthread_rwlock_rdlock(&lz->lock) ;
+#else
+    (void)d ;
+    (void)write ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Unlock a dictionary locked with ini_lazy_lock()
+  @param    d       Dictionary
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_lazy_unlock(const dictionary * d)
+{
+#ifdef INITHREADS
+    if (d && d->lazy)
+        pthread_rwlock_unlock(&((ini_lazy*)d->lazy)->lock) ;
+#else
+    (void)d ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the section of a key if it is left to parse
+  @param    d       Dictionary, parsed if loaded with INIPARSER_LAZY
+  @param    key     Key about to be looked up or modified, "section:key"
+  @param    len     Length of key
+
+  The dictionary is modified even though lookups take it as const: its
+  contents are those of a full load as far as the accessors can tell.
+  The section is looked for under the read lock, and parsed under the
+  write lock unless another thread parsed it in between.
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_lazy_load(const dictionary * d, const char * key, size_t len)
+{
+    const dictionary_section  * sec ;
+    const char                * colon ;
+    ini_lazy                  * lz ;
+    unsigned                    n = UINT_MAX ;
+
+    if (d == NULL || d->lazy == NULL || key == NULL)
+        return ;
+    lz = (ini_lazy*) d->lazy ;
+    colon = (const char*) memchr(key, ':', len) ;
+    ini_lazy_lock(d, 0) ;
+    sec = dictionary_get_section_lower(d, key, colon ? (size_t)(colon - key) : len) ;
+    if (sec && (unsigned)(sec - d->sec) < lz->nsec && lz->first[sec - d->sec])
+        n = (unsigned)(sec - d->sec) ;
+    ini_lazy_unlock(d) ;
+    if (n == UINT_MAX)
+        return ;
+    ini_lazy_lock(d, 1) ;
+    if (n < lz->nsec && lz->first[n])
+        ini_lazy_run((dictionary*)d, n) ;
+    ini_lazy_unlock(d) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse all sections left to parse of a dictionary
+  @param    d       Dictionary, parsed if loaded with INIPARSER_LAZY
+
+  Once this returns, the dictionary is no longer modified by lookups.
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_lazy_load_all(const dictionary * d)
+{
+    ini_lazy * lz ;
+    unsigned   left ;
+
+    if (d == NULL || d->lazy == NULL)
+        return ;
+    lz = (ini_lazy*) d->lazy ;
+    ini_lazy_lock(d, 0) ;
+    left = lz->left ;
+    ini_lazy_unlock(d) ;
+    if (left == 0)
+        return ;
+    ini_lazy_lock(d, 1) ;
+    if (lz->left)
+        ini_lazy_run((dictionary*)d, UINT_MAX) ;
+    ini_lazy_unlock(d) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Close the range of the input started by a section line
+  @param    ld      Loader
+  @param    lz      Sections left to parse
+  @param    r       Range, with its offset, line and section set
+  @param    end     Offset of the next section line, or size of the input
+  @return   0, -1 on a fatal error, or the first non-zero value returned
+            by a callback
+
+  Ranges of sections not in the section table, UINT_MAX, are parsed
+  right away.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_lazy_close(ini_loader * ld, ini_lazy * lz, ini_range * r, size_t end)
+{
+    r->len = end - r->off ;
+    if (r->len == 0)
+        return 0 ;
+    if (r->sec == UINT_MAX)
+        return ini_lazy_parse(ld, r) ;
+    if (ini_lazy_add(lz, r) != 0)
+        return ld->mem_err = -1 ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Index the sections of the input attached to a loader's dictionary
+  @param    ld      Loader, with its dictionary attached to the input
+  @return   0, -1 on a fatal error, or the first non-zero value returned
+            by a callback
+
+  Lines are joined and cut at NUL bytes as ini_parse_block() does, but
+  only section lines are looked at: each one stores its section, with a
+  NULL value, and starts a range of the input up to the next one. The
+  ranges are parsed on the first lookup of their section, see
+  ini_lazy_load(). The lines before the first section, and sections
+  whose name is empty or holds a ':', are not in the section table under
+  their own name and are parsed right away. Sections filtered out are
+  neither stored nor recorded. Syntax errors are reported but do not make
+  the load fail.
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_lazy_index(ini_loader * ld)
+{
+    dictionary                * d = ld->dict ;
+    char                      * buf = d->ext ;
+    size_t                      size = d->extsize ;
+    const dictionary_section  * sec ;
+    ini_lazy                  * lz ;
+    ini_range                   cur ;
+    line_span                   name, val ;
+    char                      * line = NULL ;
+    size_t                      linesz = 0 ;
+    size_t                      last = 0 ;
+    size_t                      pos = 0 ;
+    size_t                      start = 0 ;
+    size_t                      n ;
+    char                      * s ;
+    char                      * q ;
+    ini_keep                    keep ;
+    int                         lineno = 0 ;
+    int                         startline = 0 ;
+    int                         ret = 0 ;
+
+    n = strlen(ld->ininame ? ld->ininame : "") ;
+    lz = (ini_lazy*) calloc(1, sizeof *lz + n) ;
+    if (lz == NULL)
+        return ld->mem_err = -1 ;
+#ifdef INITHREADS
+    if (pthread_rwlock_init(&lz->lock, NULL) != 0) {
+        free(lz) ;
+        return ld->mem_err = -1 ;
+    }
+#endif
+    memcpy(lz->ininame, ld->ininame ? ld->ininame : "", n + 1) ;
+    d->lazy = lz ;
+    d->lazyfree = ini_lazy_free ;
+    if (ld->filter.patterns) {
+        /* The patterns of the caller may not outlive the load */
+        if ((lz->filter.patterns = ini_filter_dup(ld->filter.patterns)) == NULL)
+            return ld->mem_err = -1 ;
+        lz->filter.fold = ld->filter.fold ;
+    }
+
+    memset(&cur, 0, sizeof cur) ;
+    cur.sec = UINT_MAX ;
+    keep = ini_filter_section(&ld->filter, "", 0) ;
+    while (pos < size && ret == 0) {
+        s = buf + pos ;
+        q = (char*) memchr(s, '\n', size - pos) ;
+        n = q ? (size_t)(q + 1 - s) : size - pos ;
+        if (last == 0) {
+            start = pos ;
+            startline = lineno ;
         }
-        if (len < 0) { /* Line was entirely \n and/or spaces */
-            len = 0;
+        pos += n ;
+        lineno++ ;
+        if ((q = (char*) memchr(s, '\0', n)) != NULL)
+            n = (size_t)(q - s) ;
+
+        if (last) {
+            if (ini_grow(&line, &linesz, last + n + 1) != 0) {
+                ret = ld->mem_err = -1 ;
+                break ;
+            }
+            memcpy(line + last, s, n) ;
+            s = line ;
+            n += last ;
         }
-        /* Detect multi-line */
-        if (line[len]=='\\') {
-            /* Multi-line value */
-            last=len ;
+        if (n <= 1)
+            continue ;
+        while (n > 0 && isspace((unsigned char)s[n-1]))
+            n-- ;
+        if (n > 0 && s[n-1]=='\\') {
+            if (s != line) {
+                if (ini_grow(&line, &linesz, n) != 0) {
+                    ret = ld->mem_err = -1 ;
+                    break ;
+                }
+                memcpy(line, s, n - 1) ;
+            }
+            last = n - 1 ;
             continue ;
-        } else {
-            last=0 ;
         }
-        switch (iniparser_line(line, section, key, val)) {
-            case LINE_EMPTY:
-            case LINE_COMMENT:
+        last = 0 ;
+        if (!ini_section_line(s, n) ||
+            iniparser_line(s, n, &name, &val, NULL) != LINE_SECTION)
+            continue ;
+        /* A section line ends the current range and starts the next one */
+        if (keep != KEEP_NONE && (ret = ini_lazy_close(ld, lz, &cur, start)) != 0)
             break ;
-
-            case LINE_SECTION:
-            mem_err = dictionary_set(dict, section, NULL);
+        keep = ini_filter_section(&ld->filter, name.s, name.len) ;
+        if (keep != KEEP_NONE && (ret = load_section(name.s, name.len, ld)) != 0)
             break ;
+        cur.off = start ;
+        cur.line = startline ;
+        cur.sec = UINT_MAX ;
+        if (keep != KEEP_NONE && name.len > 0 &&
+            memchr(name.s, ':', name.len) == NULL &&
+            (sec = dictionary_get_section_lower(d, name.s, name.len)) != NULL)
+            cur.sec = (unsigned)(sec - d->sec) ;
+    }
+    if (ret == 0 && keep != KEEP_NONE)
+        ret = ini_lazy_close(ld, lz, &cur, size) ;
+    free(line) ;
+    /* Lines at fault are left out, like those of the sections parsed later */
+    ld->errs = 0 ;
+    if (lz->left == 0) {
+        d->lazy = NULL ;
+        d->lazyfree = NULL ;
+        ini_lazy_free(lz) ;
+    }
+    return ret ;
+}
 
-            case LINE_VALUE:
-            sprintf(tmp, "%s:%s", section, key);
-            mem_err = dictionary_set(dict, tmp, val);
-            break ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini data from a file or from memory into a dictionary
+  @param    src     Input to parse
+  @param    borrow  Whether the dictionary may borrow its values from src->map
+  @param    release Function releasing src->map with the dictionary, may be NULL
+  @param    ininame Name of the ini file (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
 
-            case LINE_ERROR:
-            iniparser_error_callback(
-              "iniparser: syntax error in %s (%d):\n-> %s\n",
-              ininame,
-              lineno,
-              line);
-            errs++ ;
-            break;
+  With borrow, src->map is attached to the returned dictionary, which
+  borrows its values from it, see dictionary_set_borrowed(). If no
+  dictionary is returned, it is released before returning.
 
-            default:
-            break ;
-        }
-        memset(line, 0, ASCIILINESZ);
-        last=0;
-        if (mem_err<0) {
-            iniparser_error_callback("iniparser: memory allocation failure\n");
-            break ;
-        }
+  Memory is split into parts parsed on opts->threads threads when it is
+  large enough, see ini_load_parts(). With borrow and INIPARSER_LAZY, only
+  the section lines are parsed, see ini_lazy_index().
+ */
+/*--------------------------------------------------------------------------*/
+static dictionary * iniparser_load_input(ini_input * src, int borrow,
+                                         void (*release)(char *, size_t),
+                                         const char * ininame,
+                                         const iniparser_options * opts)
+{
+    ini_loader  ld ;
+#ifdef INITHREADS
+    size_t    * cut ;
+    unsigned    n ;
+    int         ret ;
+#endif
+
+    if (ini_loader_start(&ld, ininame, opts) != 0) {
+        if (release)
+            release(src->map, src->size) ;
+        return NULL ;
     }
-    if (errs) {
-        dictionary_del(dict);
-        dict = NULL ;
+    if (borrow)
+        dictionary_attach(ld.dict, src->map, src->size, release) ;
+    if (borrow && opts && (opts->flags & INIPARSER_LAZY))
+        return ini_loader_end(&ld, ini_lazy_index(&ld)) ;
+#ifdef INITHREADS
+    if (opts && opts->threads > 1 && src->in == NULL && src->size >= 2 * INIPARTMIN) {
+        n = src->size / INIPARTMIN < opts->threads ?
+            (unsigned)(src->size / INIPARTMIN) : opts->threads ;
+        cut = (size_t*) malloc((n + 1) * sizeof *cut) ;
+        if (cut && (n = ini_split(src->map ? src->map : src->data,
+                                  src->size, n, cut)) > 1) {
+            ret = ini_load_parts(&ld, src, cut, n, opts) ;
+            free(cut) ;
+            return ini_loader_end(&ld, ret) ;
+        }
+        free(cut) ;
     }
-    return dict ;
+#endif
+    ini_reserve(&ld, src) ;
+    return ini_loader_end(&ld, iniparser_parse_input(src, ininame, load_section,
+                                                     load_keyvalue, load_error, &ld,
+                                                     &ld.filter)) ;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Parse an ini file and return an allocated dictionary object
-  @param    ininame Name of the ini file to read.
+  @param    in File to read.
+  @param    ininame Name of the ini file to read (only used for nicer error messages)
+  @param    opts Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load_file() with options.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_file_opts(FILE * in, const char * ininame,
+                                      const iniparser_options * opts)
+{
+    ini_input src ;
+
+    memset(&src, 0, sizeof src) ;
+    src.in = in ;
+    return iniparser_load_input(&src, 0, NULL, ininame, opts);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file and return an allocated dictionary object
+  @param    in File to read.
+  @param    ininame Name of the ini file to read (only used for nicer error messages)
   @return   Pointer to newly allocated dictionary
 
   This is the parser for ini files. This function is called, providing
-  the name of the file to be read. It returns a dictionary object that
-  should not be accessed directly, but through accessor functions
-  instead.
+  the file to be read. It returns a dictionary object that should not
+  be accessed directly, but through accessor functions instead.
 
   The returned dictionary must be freed using iniparser_freedict().
  */
 /*--------------------------------------------------------------------------*/
-dictionary * iniparser_load(const char * ininame)
+dictionary * iniparser_load_file(FILE * in, const char * ininame)
+{
+    return iniparser_load_file_opts(in, ininame, NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file and return an allocated dictionary object
+  @param    ininame Name of the ini file to read.
+  @param    opts Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load() with options.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_opts(const char * ininame, const iniparser_options * opts)
 {
     FILE * in ;
     dictionary * dict ;
@@ -935,12 +3174,452 @@ dictionary * iniparser_load(const char * ininame)
         return NULL ;
     }
 
-    dict = iniparser_load_file(in, ininame);
+    dict = iniparser_load_file_opts(in, ininame, opts);
     fclose(in);
 
     return dict ;
 }
 
+#ifndef _WIN32
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Unmap a file mapped by iniparser_load_mmap()
+  @param    map     Start of the mapping
+  @param    size    Size of the mapping
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_unmap(char * map, size_t size)
+{
+    munmap(map, size) ;
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse a memory-mapped ini file and return a dictionary object
+  @param    ininame Name of the ini file to read.
+  @param    opts Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load_opts() reading the file through a private
+  mapping instead of stdio.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_mmap(const char * ininame, const iniparser_options * opts)
+{
+#ifndef _WIN32
+    struct stat st ;
+    ini_input src ;
+    char * map ;
+    int    fd ;
+
+    if ((fd=open(ininame, O_RDONLY))<0) {
+        iniparser_error_callback("iniparser: cannot open %s\n", ininame);
+        return NULL ;
+    }
+    if (fstat(fd, &st)!=0 || !S_ISREG(st.st_mode) || st.st_size==0 ||
+        (uintmax_t)st.st_size > SIZE_MAX) {
+        /* Nothing to map */
+        close(fd) ;
+        return iniparser_load_opts(ininame, opts) ;
+    }
+    /* Private and writable: values are NUL-terminated in place */
+    map = (char*) mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0) ;
+    close(fd) ;
+    if (map==MAP_FAILED) {
+        iniparser_error_callback("iniparser: cannot map %s\n", ininame);
+        return NULL ;
+    }
+#ifdef MADV_WILLNEED
+    /*
+     * Read the file ahead without faulting its pages in: populating a
+     * private writable mapping (MAP_POPULATE) would give the process its
+     * own copy of every page instead of sharing it with the page cache.
+     */
+    madvise(map, (size_t)st.st_size, MADV_WILLNEED) ;
+#endif
+    memset(&src, 0, sizeof src) ;
+    src.map = map ;
+    src.size = (size_t)st.st_size ;
+    return iniparser_load_input(&src, 1, iniparser_unmap, ininame, opts) ;
+#else
+    return iniparser_load_opts(ininame, opts) ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini data in memory and return a dictionary object
+  @param    buf     Ini data, need not be NUL-terminated.
+  @param    len     Size of buf.
+  @param    ininame Name of the data (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  The data is copied block by block into a scratch buffer, like a file
+  would be read, and the dictionary does not refer to buf once loaded.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_buffer(const char * buf, size_t len, const char * ininame,
+                                   const iniparser_options * opts)
+{
+    ini_input src ;
+
+    if (buf == NULL && len)
+        return NULL ;
+    memset(&src, 0, sizeof src) ;
+    src.data = buf ;
+    src.size = len ;
+    return iniparser_load_input(&src, 0, NULL, ininame, opts) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini data in memory in place and return a dictionary object
+  @param    buf     Ini data, need not be NUL-terminated, modified.
+  @param    len     Size of buf.
+  @param    ininame Name of the data (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load_buffer() without the copy: buf is used as
+  scratch space and values are borrowed from it.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_buffer_insitu(char * buf, size_t len, const char * ininame,
+                                          const iniparser_options * opts)
+{
+    ini_input src ;
+    static char none[1] ;
+
+    if (buf == NULL && len)
+        return NULL ;
+    memset(&src, 0, sizeof src) ;
+    src.map = buf ? buf : none ;
+    src.size = len ;
+    return iniparser_load_input(&src, 1, NULL, ininame, opts) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse several ini files into a single dictionary
+  @param    paths   Names of the ini files to read, in increasing precedence
+  @param    n       Number of files
+  @param    opts    Load options, NULL for the defaults
+  @param    failed  If not NULL, set to whether each file was left out
+  @return   Pointer to newly allocated dictionary
+
+  The files are parsed on a pool of opts->threads threads, each into a
+  dictionary of its own, which are then merged in the order of paths.
+  Errors are reported file by file in that order too, once all files are
+  parsed, and files that cannot be opened or have syntax errors are left
+  out of the result.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_many(const char ** paths, size_t n,
+                                 const iniparser_options * opts, int * failed)
+{
+    ini_loader      ld ;
+    ini_part    *   parts ;
+    ini_error   *   e ;
+    dictionary  *   d ;
+    size_t          i ;
+    int             ret = 0 ;
+
+    if (paths == NULL && n)
+        return NULL ;
+    if (ini_loader_start(&ld, "", opts) != 0)
+        return NULL ;
+    parts = (ini_part*) calloc(n ? n : 1, sizeof *parts) ;
+    if (parts == NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        dictionary_del(ld.dict) ;
+        return NULL ;
+    }
+    for (i = 0 ; i < n ; i++) {
+        if (ini_part_start(parts + i, paths[i], opts, ld.dict) != 0) {
+            iniparser_error_callback("iniparser: memory allocation failure\n");
+            ini_parts_free(parts, n) ;
+            dictionary_del(ld.dict) ;
+            return NULL ;
+        }
+        parts[i].path = paths[i] ;
+    }
+    ini_run_parts(parts, n, opts ? opts->threads : 0) ;
+    ini_parts_reserve(ld.dict, parts, n) ;
+
+    /* Merge the files in order, skipping those that failed */
+    for (i = 0 ; i < n ; i++) {
+        d = NULL ;
+        if (ret == 0 && parts[i].open_err) {
+            iniparser_error_callback("iniparser: cannot open %s\n", paths[i]);
+        } else if (ret == 0) {
+            for (e = parts[i].errs ; e ; e = e->next)
+                load_error((const char*)(e + 1), e->lineno, &parts[i].ld) ;
+            d = ini_loader_end(&parts[i].ld, parts[i].ret) ;
+            parts[i].ld.dict = NULL ;
+            if (d && dictionary_merge(ld.dict, d) != 0)
+                ld.mem_err = ret = -1 ;
+        }
+        if (failed)
+            failed[i] = d == NULL || ret != 0 ;
+        dictionary_del(d) ;
+    }
+    ini_parts_free(parts, n) ;
+    return ini_loader_end(&ld, ret) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compare two strings for qsort()
+  @param    a   Pointer to the first string
+  @param    b   Pointer to the second string
+  @return   strcmp() of the strings
+ */
+/*--------------------------------------------------------------------------*/
+static int ini_strcmp(const void * a, const void * b)
+{
+    return strcmp(*(const char * const *)a, *(const char * const *)b) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the ini files of a directory into a single dictionary
+  @param    dirname Name of the directory to read
+  @param    suffix  Suffix of the files to read, such as ".ini", or NULL
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load_many() on the regular files of dirname ending
+  with suffix, sorted by name. Hidden files are ignored.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_dir(const char * dirname, const char * suffix,
+                                const iniparser_options * opts)
+{
+#ifndef _WIN32
+    DIR             *   dir ;
+    struct dirent   *   ent ;
+    struct stat         st ;
+    char            **  paths = NULL ;
+    char            **  grown ;
+    dictionary      *   d = NULL ;
+    size_t              n = 0, size = 0, len, i ;
+    size_t              dirlen, suflen = suffix ? strlen(suffix) : 0 ;
+    int                 err = 0 ;
+
+    if (dirname == NULL)
+        return NULL ;
+    if ((dir = opendir(dirname)) == NULL) {
+        iniparser_error_callback("iniparser: cannot open %s\n", dirname);
+        return NULL ;
+    }
+    dirlen = strlen(dirname) ;
+    while ((ent = readdir(dir)) != NULL) {
+        len = strlen(ent->d_name) ;
+        if (ent->d_name[0] == '.' || len < suflen ||
+            (suflen != 0 && memcmp(ent->d_name + len - suflen, suffix, suflen) != 0))
+            continue ;
+        if (n == size) {
+            size = size ? size * 2 : 16 ;
+            grown = (char**) realloc(paths, size * sizeof *paths) ;
+            if (grown == NULL) {
+                err = 1 ;
+                break ;
+            }
+            paths = grown ;
+        }
+        paths[n] = (char*) malloc(dirlen + len + 2) ;
+        if (paths[n] == NULL) {
+            err = 1 ;
+            break ;
+        }
+        memcpy(paths[n], dirname, dirlen) ;
+        paths[n][dirlen] = '/' ;
+        memcpy(paths[n] + dirlen + 1, ent->d_name, len + 1) ;
+        if (stat(paths[n], &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(paths[n]) ;
+            continue ;
+        }
+        n++ ;
+    }
+    closedir(dir) ;
+    if (err) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+    } else {
+        if (n > 1)
+            qsort(paths, n, sizeof *paths, ini_strcmp) ;
+        d = iniparser_load_many((const char **)paths, n, opts, NULL) ;
+    }
+    for (i = 0 ; i < n ; i++)
+        free(paths[i]) ;
+    free(paths) ;
+    return d ;
+#else
+    (void)suffix ;
+    (void)opts ;
+    iniparser_error_callback("iniparser: cannot open %s\n", dirname);
+    return NULL ;
+#endif
+}
+
+/** Incremental parser, see iniparser_parser_new() */
+struct _iniparser_parser_ {
+    ini_parser      core ;  /** Parser state */
+    ini_loader      ld ;    /** Loader the parser fills */
+    int             ret ;   /** First non-zero value returned by the parser */
+} ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create an incremental parser
+  @param    ininame Name of the input (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Newly allocated parser, or NULL in case of allocation failure
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_parser * iniparser_parser_new(const char * ininame,
+                                        const iniparser_options * opts)
+{
+    iniparser_parser * p ;
+    char * name ;
+    size_t len ;
+
+    if (ininame == NULL)
+        ininame = "" ;
+    len = strlen(ininame) ;
+    p = (iniparser_parser*) malloc(sizeof *p + len + 1) ;
+    if (p == NULL)
+        return NULL ;
+    /* Keep a copy of the name after the parser */
+    name = (char*)(p + 1) ;
+    memcpy(name, ininame, len + 1) ;
+    if (ini_loader_start(&p->ld, name, opts) != 0) {
+        dictionary_del(p->ld.dict) ;
+        free(p) ;
+        return NULL ;
+    }
+    if (ini_parser_init(&p->core, NULL, INIFEEDSZ, name, load_section,
+                        load_keyvalue, load_error, &p->ld, &p->ld.filter) != 0) {
+        dictionary_del(p->ld.dict) ;
+        free(p) ;
+        return NULL ;
+    }
+    p->ret = 0 ;
+    return p ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Feed a chunk of input to an incremental parser
+  @param    p   Parser
+  @param    buf Next bytes of the input
+  @param    len Number of bytes in buf
+  @return   0, or -1 if the input cannot be loaded
+
+  The complete lines of the chunk are parsed right away. What is left of
+  the last line is copied in the parser until the next chunk completes it.
+  The buffer of the parser starts at INIFEEDSZ bytes and only doubles when
+  a line fills more than half of it.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_feed(iniparser_parser * p, const char * buf, size_t len)
+{
+    ini_parser * c ;
+    size_t start, n ;
+
+    if (p == NULL || (buf == NULL && len > 0))
+        return -1 ;
+    c = &p->core ;
+    while (p->ret == 0 && len > 0) {
+        if (c->have == c->size) {
+            if (c->have - c->pos > c->size / 2 && ini_parser_grow(c, 1) != 0) {
+                iniparser_error_callback("iniparser: memory allocation failure\n");
+                p->ret = -1 ;
+                break ;
+            }
+            if (c->pos > 0) {
+                /* Move the incomplete line to the start of the buffer */
+                memmove(c->buf, c->buf + c->pos, c->have - c->pos) ;
+                c->have -= c->pos ;
+                c->pos = 0 ;
+                scan_structural(c->buf, c->have, c->bits) ;
+            }
+        }
+        n = c->size - c->have ;
+        if (n > len)
+            n = len ;
+        memcpy(c->buf + c->have, buf, n) ;
+        /* Index the new bytes, from the start of the word holding the first */
+        start = c->have & ~(size_t)63 ;
+        c->have += n ;
+        scan_structural(c->buf + start, c->have - start, c->bits + start / 64) ;
+        buf += n ;
+        len -= n ;
+        p->ret = ini_parse_block(c) ;
+    }
+    return p->ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the end of the input of an incremental parser
+  @param    p   Parser, freed by the call
+  @return   Pointer to newly allocated dictionary
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_finish(iniparser_parser * p)
+{
+    dictionary * dict ;
+
+    if (p == NULL)
+        return NULL ;
+    if (p->ret == 0) {
+        p->core.eof = 1 ;
+        p->ret = ini_parse_block(&p->core) ;
+    }
+    dict = ini_loader_end(&p->ld, p->ret) ;
+    p->ld.dict = NULL ;
+    iniparser_parser_free(p) ;
+    return dict ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free an incremental parser without finishing it
+  @param    p   Parser to free, may be NULL
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_parser_free(iniparser_parser * p)
+{
+    if (p == NULL)
+        return ;
+    dictionary_del(p->ld.dict) ;
+    free(p->ld.tmp) ;
+    ini_parser_free(&p->core, NULL) ;
+    free(p) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file and return an allocated dictionary object
+  @param    ininame Name of the ini file to read.
+  @return   Pointer to newly allocated dictionary
+
+  This is the parser for ini files. This function is called, providing
+  the name of the file to be read. It returns a dictionary object that
+  should not be accessed directly, but through accessor functions
+  instead.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load(const char * ininame)
+{
+    return iniparser_load_opts(ininame, NULL);
+}
+
 
 /*-------------------------------------------------------------------------*/
 /**
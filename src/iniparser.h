@@ -21,6 +21,136 @@
 extern "C" {
 #endif
 
+/*---------------------------------------------------------------------------
+                                New types
+ ---------------------------------------------------------------------------*/
+
+/** Load flag: hash keys with a random secret seed, for untrusted input */
+#define INIPARSER_SEEDED    0x1
+/** Load flag: allocate each key and value separately instead of in an arena */
+#define INIPARSER_NO_ARENA  0x2
+/** Load flag: keep the case of sections and keys instead of lowercasing them */
+#define INIPARSER_CASE_SENSITIVE    0x4
+/** Load flag: parse each section on its first lookup, see iniparser_options */
+#define INIPARSER_LAZY      0x8
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Options for loading an ini file
+
+  Options passed to iniparser_load_opts() and iniparser_load_file_opts().
+  Initialize the whole structure to zero before setting the options you
+  need, so that options added in the future keep their default value.
+
+  With INIPARSER_SEEDED, the dictionary is created with
+  dictionary_new_seeded(): crafted files cannot make their keys collide in
+  the dictionary, and loading them stays linear in their size.
+
+  By default, keys and values are stored in an arena (see DICTIONARY_ARENA
+  in dictionary.h): the space of values later overwritten with
+  iniparser_set() is only reclaimed by dictionary_compact(). Use
+  INIPARSER_NO_ARENA to get a dictionary that frees them right away.
+
+  With INIPARSER_CASE_SENSITIVE, sections and keys are stored as written
+  in the file, and the accessors of the returned dictionary look keys up
+  as given (see DICTIONARY_CASE_SENSITIVE): "Sec:Key" and "sec:key" are
+  then different keys. This saves lowercasing every key while loading
+  and looking up files whose keys are known to be lowercase.
+
+  With threads set to more than 1, iniparser_load_mmap(),
+  iniparser_load_buffer() and iniparser_load_buffer_insitu() split large
+  inputs at section lines into up to that many parts, parsed at once on
+  as many threads, and iniparser_load_many() parses that many files at
+  once. The resulting dictionary, and the syntax errors reported, are the
+  same as with a single thread. Other inputs read from a FILE are always
+  parsed on the calling thread, as is everything on platforms without
+  POSIX threads.
+
+  With INIPARSER_LAZY, iniparser_load_mmap() and
+  iniparser_load_buffer_insitu() only look for section lines and record
+  where each section is in the input, which the dictionary keeps. The
+  keys of a section are parsed and stored on the first lookup of a key
+  of that section, or of the section itself, through the iniparser_*
+  accessors, so that loading costs little more than reading the input
+  and the dictionary only grows with the sections used. The dump
+  functions parse every section left. Keys before the first section are
+  parsed while loading. Syntax errors in a section are reported when it
+  is parsed, and the lines at fault are left out of the dictionary
+  instead of making the load fail. Lookups parse sections under a lock
+  kept by the dictionary, so that it may be looked up by several threads
+  at once like any other dictionary, while dictionary_* functions called
+  directly do not see the sections left. Other loaders ignore this flag.
+
+  With filter set, only the sections and keys matching one of its
+  patterns are loaded, with '*' matching any characters and '?' one,
+  ignoring case unless INIPARSER_CASE_SENSITIVE is set. A pattern without
+  ':', such as "server" or "cache.*", matches whole sections, and
+  "section:key" patterns, such as "db:host" or "*:port", match single
+  keys together with their section. Keys before any section belong to
+  the section "". The lines of sections left out are only looked at to
+  find the next section line: they are neither parsed nor stored, and
+  their syntax errors are not reported. Keys left out of a kept section
+  are not stored.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_options_ {
+    unsigned                flags ; /** Combination of INIPARSER_* flags */
+    const unsigned char *   seed ;  /** 16-byte seed for INIPARSER_SEEDED, NULL for random */
+    unsigned                threads ; /** Number of threads parsing memory, 0 for 1 */
+    const char * const *    filter ; /** NULL-terminated patterns of what to load, NULL for all */
+} iniparser_options ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compiled key
+
+  A key prepared by iniparser_key_compile() for repeated lookups: it is
+  normalized and hashed once, so that the iniparser_get*_key() functions
+  find it without copying, lowercasing or hashing it again.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_key_ {
+    char        *   key ;   /** Normalized key */
+    size_t          len ;   /** Length of key */
+    unsigned        hash ;  /** dictionary_hash_n() of key */
+    char        *   exact ; /** Key as given, for case-sensitive dictionaries */
+    unsigned        exact_hash ; /** dictionary_hash_n() of exact */
+} iniparser_key ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Incremental parser
+
+  A parser fed with the input one chunk at a time, see
+  iniparser_parser_new(). Its contents are private.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_parser_ iniparser_parser ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Callbacks of iniparser_parse_cb()
+
+  Names, keys and values are passed as spans of the input: they are not
+  NUL-terminated and are only valid during the call. Sections and keys
+  are passed as written in the input, values are unquoted. A callback
+  returning non-zero stops the parsing, see iniparser_parse_cb().
+ */
+/*--------------------------------------------------------------------------*/
+/** Called for each section, with its name */
+typedef int (*iniparser_section_cb)(const char * name, size_t len, void * user);
+/** Called for each key, with its section ("" before the first one) */
+typedef int (*iniparser_keyvalue_cb)(const char * section, size_t seclen,
+                                     const char * key, size_t keylen,
+                                     const char * val, size_t vallen,
+                                     void * user);
+/** Called for each line with a syntax error, with the NUL-terminated line */
+typedef int (*iniparser_line_error_cb)(const char * line, int lineno, void * user);
+
+/*---------------------------------------------------------------------------
+                            Function prototypes
+ ---------------------------------------------------------------------------*/
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Configure a function to receive the error messages.
@@ -166,6 +296,25 @@ const char ** iniparser_getseckeys(const dictionary * d, const char * s, const c
 /*--------------------------------------------------------------------------*/
 const char * iniparser_getstring(const dictionary * d, const char * key, const char * def);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key of known length
+  @param    d       Dictionary to search
+  @param    key     Key string to look for, need not be NUL-terminated
+  @param    keylen  Length of key
+  @param    def     Default value to return if key not found.
+  @param    vallen  If not NULL, set to the length of the returned string
+  @return   pointer to statically allocated character string
+
+  This function works like iniparser_getstring(), but the key is given
+  by a pointer and a length and the length of the value is returned, so
+  that neither has to be scanned for its terminating NUL. If the key
+  cannot be found, vallen is set to the length of def (0 if def is NULL).
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_getstring_n(const dictionary * d, const char * key, size_t keylen,
+                                   const char * def, size_t * vallen);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Get the string associated to a key, convert to an int
@@ -347,6 +496,23 @@ int iniparser_getboolean(const dictionary * d, const char * key, int notfound);
 /*--------------------------------------------------------------------------*/
 int iniparser_set(dictionary * ini, const char * entry, const char * val);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry of known length in a dictionary.
+  @param    ini      Dictionary to modify.
+  @param    entry    Entry to modify (entry name), need not be NUL-terminated
+  @param    entrylen Length of entry
+  @param    val      New value to associate to the entry, may be NULL.
+  @param    vallen   Length of val, ignored if val is NULL.
+  @return   int 0 if Ok, -1 otherwise.
+
+  This function works like iniparser_set(), but entry and value are given
+  by a pointer and a length, so that they can be slices of a larger buffer.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_set_n(dictionary * ini, const char * entry, size_t entrylen,
+                    const char * val, size_t vallen);
+
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -373,6 +539,128 @@ void iniparser_unset(dictionary * ini, const char * entry);
 /*--------------------------------------------------------------------------*/
 int iniparser_find_entry(const dictionary * ini, const char * entry) ;
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compile a key for repeated lookups
+  @param    key     Key string, as given to iniparser_getstring()
+  @return   Newly allocated handle, or NULL in case of error
+
+  The returned handle holds the key lowercased, its length and its hash.
+  It can be used with any dictionary by the iniparser_get*_key()
+  functions, which behave like their counterparts taking a key string but
+  skip the normalization and hashing of the key. Dictionaries loaded with
+  INIPARSER_SEEDED still hash the key on each lookup. In dictionaries
+  loaded with INIPARSER_CASE_SENSITIVE, the key is looked up as given.
+
+  The handle must be freed with iniparser_key_free().
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_key * iniparser_key_compile(const char * key);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a compiled key
+  @param    k   Handle returned by iniparser_key_compile(), may be NULL
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_key_free(iniparser_key * k);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key
+  @param    d   Dictionary to search
+  @param    k   Compiled key to look for
+  @param    def Default value to return if key not found.
+  @return   pointer to statically allocated character string
+
+  See iniparser_getstring().
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_getstring_key(const dictionary * d, const iniparser_key * k,
+                                     const char * def);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to an int
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
+
+  See iniparser_getint().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_getint_key(const dictionary * d, const iniparser_key * k, int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to a long int
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   long integer
+
+  See iniparser_getlongint().
+ */
+/*--------------------------------------------------------------------------*/
+long int iniparser_getlongint_key(const dictionary * d, const iniparser_key * k,
+                                  long int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to an int64_t
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
+
+  See iniparser_getint64().
+ */
+/*--------------------------------------------------------------------------*/
+int64_t iniparser_getint64_key(const dictionary * d, const iniparser_key * k,
+                               int64_t notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to an uint64_t
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
+
+  See iniparser_getuint64().
+ */
+/*--------------------------------------------------------------------------*/
+uint64_t iniparser_getuint64_key(const dictionary * d, const iniparser_key * k,
+                                 uint64_t notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to a double
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   double
+
+  See iniparser_getdouble().
+ */
+/*--------------------------------------------------------------------------*/
+double iniparser_getdouble_key(const dictionary * d, const iniparser_key * k,
+                               double notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a compiled key, convert to a boolean
+  @param    d           Dictionary to search
+  @param    k           Compiled key to look for
+  @param    notfound    Value to return in case of error
+  @return   integer
+
+  See iniparser_getboolean().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_getboolean_key(const dictionary * d, const iniparser_key * k, int notfound);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Parse an ini file and return an allocated dictionary object
@@ -427,6 +715,243 @@ dictionary * iniparser_load(const char * ininame);
 /*--------------------------------------------------------------------------*/
 dictionary * iniparser_load_file(FILE * in, const char * ininame);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file and return an allocated dictionary object
+  @param    ininame Name of the ini file to read.
+  @param    opts Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load() with options, see iniparser_options.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_opts(const char * ininame, const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file and return an allocated dictionary object
+  @param    in File to read.
+  @param    ininame Name of the ini file to read (only used for nicer error messages)
+  @param    opts Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This is iniparser_load_file() with options, see iniparser_options.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_file_opts(FILE * in, const char * ininame,
+                                      const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse a memory-mapped ini file and return a dictionary object
+  @param    ininame Name of the ini file to read.
+  @param    opts Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This works like iniparser_load_opts(), but the file is mapped in memory
+  instead of being read line by line. Values are not copied: the
+  dictionary points into a private copy-on-write mapping of the file,
+  which stays mapped until the dictionary is freed. Sections and keys,
+  which are stored lowercased and prefixed by their section, are still
+  copied, as are values that are short or span several lines.
+
+  Pages holding long values are modified to NUL-terminate them, so that
+  the system gives the process its own copy of these pages, while the
+  others are shared with the page cache. Changing the file while the
+  dictionary is in use is undefined.
+
+  Files that cannot be mapped, such as pipes, and platforms without mmap
+  fall back to iniparser_load_opts().
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_mmap(const char * ininame, const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini data in memory and return a dictionary object
+  @param    buf     Ini data, need not be NUL-terminated.
+  @param    len     Size of buf.
+  @param    ininame Name of the data (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This works like iniparser_load_file_opts() on a file holding the len
+  bytes of buf, without going through stdio. buf is left unchanged and
+  may be freed as soon as the function returns.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_buffer(const char * buf, size_t len, const char * ininame,
+                                   const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini data in memory in place and return a dictionary object
+  @param    buf     Ini data, need not be NUL-terminated, modified.
+  @param    len     Size of buf.
+  @param    ininame Name of the data (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary
+
+  This works like iniparser_load_buffer(), but buf is parsed in place:
+  quoted values are unescaped where they are and values are
+  NUL-terminated in buf. Long values are not copied, the dictionary
+  points to them in buf. Sections and keys are still copied, since the
+  dictionary stores each key together with its section, as are short
+  values and values spanning several lines.
+
+  The contents of buf are unspecified after the call. buf must stay
+  valid and unchanged until the dictionary is freed, which does not
+  free buf.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_buffer_insitu(char * buf, size_t len, const char * ininame,
+                                          const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse several ini files into a single dictionary
+  @param    paths   Names of the ini files to read, in increasing precedence
+  @param    n       Number of files
+  @param    opts    Load options, NULL for the defaults
+  @param    failed  If not NULL, array of n flags set to whether each file
+                    was left out
+  @return   Pointer to newly allocated dictionary
+
+  The files are parsed at once on a pool of opts->threads threads, and
+  merged in the order of paths: a key set in several files keeps the
+  value of the last one, and its position in the dictionary from the
+  first one, as if the files were loaded and merged one after the other
+  with dictionary_merge(). With threads set to 0 or 1, the files are
+  parsed in turn on the calling thread.
+
+  Errors are reported through the error callback file by file, in the
+  order of paths, once all files are parsed. A file that cannot be opened
+  or has syntax errors is left out of the dictionary, and flagged in
+  failed. NULL is only returned if memory runs out.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_many(const char ** paths, size_t n,
+                                 const iniparser_options * opts, int * failed);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the ini files of a directory into a single dictionary
+  @param    dirname Name of the directory to read, such as "conf.d"
+  @param    suffix  Suffix of the files to read, such as ".ini", or NULL for all
+  @param    opts    Load options, NULL for the defaults
+  @return   Pointer to newly allocated dictionary, or NULL if the directory
+            cannot be read
+
+  This is iniparser_load_many() on the regular files of dirname whose name
+  ends with suffix, in increasing precedence by name as sorted by
+  strcmp(). Hidden files, whose name starts with a dot, are ignored.
+  Directories cannot be read on Windows.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_dir(const char * dirname, const char * suffix,
+                                const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file without building a dictionary
+  @param    in          File to read.
+  @param    ininame     Name of the ini file (only used for nicer error messages)
+  @param    on_section  Called for each section, may be NULL
+  @param    on_keyvalue Called for each key, may be NULL
+  @param    on_error    Called for each line with a syntax error, may be NULL
+  @param    user        Passed to the callbacks
+  @return   0 once the whole file is parsed, -1 on a fatal error, or the
+            non-zero value returned by a callback
+
+  This parses the file like iniparser_load_file(), but hands sections,
+  keys and values to the callbacks as they are found instead of storing
+  them: nothing is allocated per entry, and the caller decides what to
+  keep. iniparser_load_file() is itself built on it.
+
+  Parsing goes on after a syntax error unless on_error returns non-zero.
+  Lines may be of any length. Allocation failures are fatal errors,
+  reported through the error callback set with
+  iniparser_set_error_callback().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_parse_cb(FILE * in, const char * ininame,
+                       iniparser_section_cb on_section,
+                       iniparser_keyvalue_cb on_keyvalue,
+                       iniparser_line_error_cb on_error,
+                       void * user);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a parser fed with the input one chunk at a time
+  @param    ininame Name of the input (only used for nicer error messages)
+  @param    opts    Load options, NULL for the defaults
+  @return   Newly allocated parser, or NULL in case of allocation failure
+
+  This is for input arriving in pieces, such as from a pipe or a socket
+  in an event loop: pass each piece to iniparser_feed() as it arrives,
+  then call iniparser_finish() to get the dictionary. Nothing blocks, and
+  the input is parsed as it comes instead of being buffered: the parser
+  only keeps the incomplete line at the end of the last chunk.
+
+  The result is the same as iniparser_load_buffer() on the whole input,
+  whatever the chunk boundaries, even within quoted values or lines
+  continued with a backslash.
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_parser * iniparser_parser_new(const char * ininame,
+                                        const iniparser_options * opts);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Feed the next chunk of input to a parser
+  @param    p   Parser created with iniparser_parser_new()
+  @param    buf Next bytes of the input, need not be NUL-terminated
+  @param    len Number of bytes in buf
+  @return   0, or -1 if the input cannot be loaded
+
+  The chunk may end anywhere, buf can be reused as soon as the function
+  returns. Syntax errors are reported through the error callback and make
+  iniparser_finish() fail, but do not stop the parser. After a fatal error,
+  such as an allocation failure, the rest of the input is ignored.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_feed(iniparser_parser * p, const char * buf, size_t len);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the end of the input and return a dictionary object
+  @param    p   Parser created with iniparser_parser_new(), freed by the call
+  @return   Pointer to newly allocated dictionary, or NULL on errors
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_finish(iniparser_parser * p);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a parser without finishing it
+  @param    p   Parser created with iniparser_parser_new(), may be NULL
+
+  Use this to drop input that will not be completed.
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_parser_free(iniparser_parser * p);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Free all memory associated to an ini dictionary
@@ -1,3 +1,5 @@
+#include <stddef.h>
+
 #include <unity.h>
 
 /* We need to directly insert the .c file in order to test the */
@@ -12,7 +14,7 @@ void tearDown(void)
 {
 }
 
-void test_xstrdup(void)
+void test_xmemdup(void)
 {
     size_t i;
     char *dup_str;
@@ -23,26 +25,47 @@ void test_xstrdup(void)
     };
     char *string_very_long;
 
-    /* NULL test */
-    TEST_ASSERT_NULL(xstrdup(NULL));
-
     for (i = 0 ; i < sizeof(strings) / sizeof(char *) ; ++i) {
-        dup_str = xstrdup(strings[i]);
+        dup_str = xmemdup(strings[i], strlen(strings[i]));
         TEST_ASSERT_EQUAL_STRING(strings[i], dup_str);
         free(dup_str);
     }
 
+    /* the copy is terminated after len bytes */
+    dup_str = xmemdup("testing", 4);
+    TEST_ASSERT_EQUAL_STRING("test", dup_str);
+    free(dup_str);
+
     /* test a overflowing string */
     string_very_long = (char*) malloc(10 * 1024);
     memset(string_very_long, '#', 10 * 1024);
     string_very_long[10 * 1024 - 1] = '\0';
-    dup_str = xstrdup(string_very_long);
+    dup_str = xmemdup(string_very_long, strlen(string_very_long));
     TEST_ASSERT_EQUAL_STRING(string_very_long, dup_str);
 
     free(string_very_long);
     free(dup_str);
 }
 
+/* The fields of the 4.2 dictionary stay first, so that clients walking
+ * d->key and d->val keep working */
+struct dictionary_4_2 {
+    unsigned n;
+    size_t size;
+    char **val;
+    char **key;
+    unsigned *hash;
+};
+
+void test_dictionary_layout(void)
+{
+    TEST_ASSERT_EQUAL(offsetof(struct dictionary_4_2, n), offsetof(dictionary, n));
+    TEST_ASSERT_EQUAL(offsetof(struct dictionary_4_2, size), offsetof(dictionary, size));
+    TEST_ASSERT_EQUAL(offsetof(struct dictionary_4_2, val), offsetof(dictionary, val));
+    TEST_ASSERT_EQUAL(offsetof(struct dictionary_4_2, key), offsetof(dictionary, key));
+    TEST_ASSERT_EQUAL(offsetof(struct dictionary_4_2, hash), offsetof(dictionary, hash));
+}
+
 void test_dictionary_grow(void)
 {
     unsigned i;
@@ -63,8 +86,35 @@ void test_dictionary_grow(void)
 
 void test_dictionary_hash(void)
 {
+    size_t i;
+    const char *strings[] = {
+        "",
+        "a",
+        "section",
+        "section:key",
+        "a rather long section name:with a rather long key"
+    };
+    const char buffer[] = "section:key=value";
+
     /* NULL test */
     TEST_ASSERT_EQUAL(0, dictionary_hash(NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_hash_n(NULL, 3));
+
+    /* Both entry points agree on NUL-terminated strings */
+    for (i = 0 ; i < sizeof(strings) / sizeof(char *) ; ++i) {
+        TEST_ASSERT_EQUAL(dictionary_hash(strings[i]),
+                          dictionary_hash_n(strings[i], strlen(strings[i])));
+    }
+
+    /* Only len bytes are hashed */
+    TEST_ASSERT_EQUAL(dictionary_hash("section:key"),
+                      dictionary_hash_n(buffer, 11));
+    TEST_ASSERT(dictionary_hash("section:ke") != dictionary_hash_n(buffer, 11));
+
+    /* Every byte of the tail matters */
+    for (i = 1 ; i < 17 ; ++i) {
+        TEST_ASSERT(dictionary_hash_n(buffer, i) != dictionary_hash_n(buffer, i - 1));
+    }
 }
 
 void test_dictionary_growing(void)
@@ -293,3 +343,891 @@ void test_dictionary_get(void)
 
     dictionary_del(dic);
 }
+
+void test_dictionary_get_n(void)
+{
+    dictionary *dic;
+    const char *buf = "sec:keysec:key2=value2;";
+    const char *val;
+    size_t len;
+
+    /*NULL test*/
+    len = 42;
+    TEST_ASSERT_NULL(dictionary_get_n(NULL, NULL, 0, NULL, &len));
+    TEST_ASSERT_EQUAL(0, len);
+    TEST_ASSERT_EQUAL_STRING("def",
+                             dictionary_get_n(NULL, "key", 3, "def", &len));
+    TEST_ASSERT_EQUAL(3, len);
+
+    dic = dictionary_new(DICTMINSZ);
+    TEST_ASSERT_NOT_NULL(dic);
+
+    /*Keys and values are slices of a larger buffer*/
+    TEST_ASSERT_EQUAL(0, dictionary_set_n(dic, buf, 7, buf + 16, 6));
+    TEST_ASSERT_EQUAL(0, dictionary_set_n(dic, buf + 7, 8, buf + 7, 3));
+    TEST_ASSERT_EQUAL(2, dic->n);
+    TEST_ASSERT_EQUAL_STRING("value2", dictionary_get(dic, "sec:key", NULL));
+    TEST_ASSERT_EQUAL_STRING("sec", dictionary_get(dic, "sec:key2", NULL));
+
+    /*A key is not matched by a prefix or an extension of it*/
+    TEST_ASSERT_NULL(dictionary_get_n(dic, "sec:key", 6, NULL, NULL));
+    TEST_ASSERT_NULL(dictionary_get(dic, "sec:key22", NULL));
+
+    val = dictionary_get_n(dic, "sec:key2=", 8, NULL, &len);
+    TEST_ASSERT_EQUAL_STRING("sec", val);
+    TEST_ASSERT_EQUAL(3, len);
+    val = dictionary_get_n(dic, buf, 7, NULL, &len);
+    TEST_ASSERT_EQUAL_STRING("value2", val);
+    TEST_ASSERT_EQUAL(6, len);
+
+    /*Embedded NUL bytes are part of the value*/
+    TEST_ASSERT_EQUAL(0, dictionary_set_n(dic, "bin", 3, "a\0b", 3));
+    val = dictionary_get_n(dic, "bin", 3, NULL, &len);
+    TEST_ASSERT_EQUAL(3, len);
+    TEST_ASSERT_EQUAL_MEMORY("a\0b", val, 4);
+
+    /*NULL values have a zero length*/
+    TEST_ASSERT_EQUAL(0, dictionary_set_n(dic, "sec", 3, NULL, 12));
+    len = 42;
+    TEST_ASSERT_NULL(dictionary_get_n(dic, "sec", 3, "def", &len));
+    TEST_ASSERT_EQUAL(0, len);
+
+    /*Overwriting updates the length*/
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:key", "v"));
+    dictionary_get_n(dic, "sec:key", 7, NULL, &len);
+    TEST_ASSERT_EQUAL(1, len);
+
+    dictionary_del(dic);
+}
+
+void test_dictionary_index(void)
+{
+    int i;
+    size_t j, used;
+    char key_name[64];
+    char key_value[64];
+    dictionary *dic;
+
+    dic = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->isize & (dic->isize - 1));
+    TEST_ASSERT_GREATER_OR_EQUAL(2 * dic->size, dic->isize);
+
+    /* Fill well past the initial size so that the index is rebuilt */
+    for (i = 0 ; i < 5000 ; ++i) {
+        sprintf(key_name, "sec%d:key%d", i % 17, i);
+        sprintf(key_value, "value-%d", i);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, key_value));
+    }
+    TEST_ASSERT_EQUAL(5000, dic->n);
+
+    /* Punch holes in the probe sequences */
+    for (i = 0 ; i < 5000 ; i += 3) {
+        sprintf(key_name, "sec%d:key%d", i % 17, i);
+        dictionary_unset(dic, key_name);
+    }
+
+    for (i = 0 ; i < 5000 ; ++i) {
+        sprintf(key_name, "sec%d:key%d", i % 17, i);
+        sprintf(key_value, "value-%d", i);
+        if (i % 3 == 0) {
+            TEST_ASSERT_NULL(dictionary_get(dic, key_name, NULL));
+        } else {
+            TEST_ASSERT_EQUAL_STRING(key_value,
+                                     dictionary_get(dic, key_name, NULL));
+        }
+    }
+
+    /* Every used bucket must point to a live entry, one bucket per entry */
+    used = 0;
+    for (j = 0 ; j < dic->isize ; ++j) {
+        if (dic->index[j] == 0)
+            continue;
+        TEST_ASSERT_NOT_NULL(dic->key[dic->index[j] - 1]);
+        used++;
+    }
+    TEST_ASSERT_EQUAL(dic->n, used);
+
+    dictionary_del(dic);
+}
+
+void test_dictionary_resize(void)
+{
+    int i;
+    int resized = 0;
+    size_t size;
+    char key_name[64];
+    char key_value[64];
+    dictionary *dic;
+
+    dic = dictionary_new(DICTMINSZ);
+    TEST_ASSERT_NOT_NULL(dic);
+    size = dic->size;
+
+    for (i = 0 ; i < 20000 ; ++i) {
+        sprintf(key_name, "key%d", i);
+        sprintf(key_value, "value-%d", i);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, key_value));
+        /* The storage must never fill up while a resize is ongoing */
+        TEST_ASSERT(dic->n < dic->size);
+        if (dic->resize) {
+            resized = 1;
+            /* Churn entries on both sides of the migration cursor */
+            if (i % 2) {
+                sprintf(key_name, "key%d", i - 1);
+                dictionary_unset(dic, key_name);
+                TEST_ASSERT_NULL(dictionary_get(dic, key_name, NULL));
+                TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, "again"));
+            }
+            sprintf(key_name, "key%d", i / 2);
+            TEST_ASSERT_NOT_NULL(dictionary_get(dic, key_name, NULL));
+        }
+    }
+    TEST_ASSERT(resized);
+    TEST_ASSERT(dic->size > size);
+    TEST_ASSERT_EQUAL(20000, dic->n);
+
+    for (i = 0 ; i < 20000 ; ++i) {
+        sprintf(key_name, "key%d", i);
+        dictionary_unset(dic, key_name);
+        TEST_ASSERT_NULL(dictionary_get(dic, key_name, NULL));
+    }
+    TEST_ASSERT_EQUAL(0, dic->n);
+
+    dictionary_del(dic);
+}
+
+/* Number of index buckets visited to find a key */
+static size_t probe_count(const dictionary *d, const char *key)
+{
+    size_t mask = d->isize - 1;
+    size_t pos, probes = 1;
+    unsigned hash = dictionary_key_hash(d, key, strlen(key), 0);
+
+    for (pos = hash & mask ; d->index[pos] ; pos = (pos + 1) & mask, probes++) {
+        if (!strcmp(d->key[d->index[pos] - 1], key))
+            break;
+    }
+    return probes;
+}
+
+void test_dictionary_seeded(void)
+{
+    const unsigned char seed[16] = "0123456789abcdef";
+    const unsigned mask = (1 << 14) - 1;
+    const size_t nkeys = 1000;
+    char (*keys)[32];
+    dictionary *plain, *seeded, *other;
+    size_t i, n, plain_probes, seeded_probes;
+    unsigned long c;
+
+    /* Generate keys colliding in the low bits of the unseeded hash, which
+       is what an attacker knowing dictionary_hash() would do */
+    keys = malloc(nkeys * sizeof *keys);
+    TEST_ASSERT_NOT_NULL(keys);
+    for (c = 0, n = 0 ; n < nkeys ; c++) {
+        sprintf(keys[n], "sec:key%lu", c);
+        if ((dictionary_hash(keys[n]) & mask) == 0x2a)
+            n++;
+    }
+
+    plain = dictionary_new(0);
+    seeded = dictionary_new_seeded(0, seed);
+    other = dictionary_new_seeded(0, NULL);
+    TEST_ASSERT_NOT_NULL(plain);
+    TEST_ASSERT_NOT_NULL(seeded);
+    TEST_ASSERT_NOT_NULL(other);
+    TEST_ASSERT_EQUAL(0, plain->flags & DICTIONARY_SEEDED);
+    TEST_ASSERT_EQUAL(DICTIONARY_SEEDED, seeded->flags & DICTIONARY_SEEDED);
+    TEST_ASSERT_EQUAL(0, memcmp(seed, seeded->seed, sizeof seed));
+    for (i = 0 ; i < nkeys ; i++) {
+        TEST_ASSERT_EQUAL(0, dictionary_set(plain, keys[i], "v"));
+        TEST_ASSERT_EQUAL(0, dictionary_set(seeded, keys[i], "v"));
+        TEST_ASSERT_EQUAL(0, dictionary_set(other, keys[i], "v"));
+    }
+    /* Finish any resize so that all entries are in d->index */
+    dictionary_grow(plain);
+    dictionary_grow(seeded);
+    TEST_ASSERT(plain->isize - 1 <= mask);
+
+    plain_probes = seeded_probes = 0;
+    for (i = 0 ; i < nkeys ; i++) {
+        TEST_ASSERT_EQUAL_STRING("v", dictionary_get(seeded, keys[i], NULL));
+        TEST_ASSERT_EQUAL_STRING("v", dictionary_get(other, keys[i], NULL));
+        plain_probes += probe_count(plain, keys[i]);
+        seeded_probes += probe_count(seeded, keys[i]);
+    }
+    /* Unseeded: every key lands in the same probe sequence, O(n^2) */
+    TEST_ASSERT(plain_probes >= nkeys * (nkeys + 1) / 2);
+    /* Seeded: the attack is defeated, about one probe per key */
+    TEST_ASSERT(seeded_probes < 4 * nkeys);
+
+    /* Same seed, same hashes */
+    TEST_ASSERT_EQUAL(dictionary_key_hash(seeded, "a:b", 3, 0),
+                      dictionary_key_hash(seeded, "a:b", 3, 0));
+    TEST_ASSERT(dictionary_key_hash(seeded, "a:b", 3, 0) != dictionary_hash("a:b"));
+
+    dictionary_del(plain);
+    dictionary_del(seeded);
+    dictionary_del(other);
+    free(keys);
+}
+
+/* Number of chunks in the arena of a dictionary */
+static size_t chunk_count(const dictionary *d)
+{
+    const struct _dictionary_chunk_ *c;
+    size_t n = 0;
+
+    for (c = d->arena ; c ; c = c->next)
+        n++;
+    return n;
+}
+
+void test_dictionary_arena(void)
+{
+    dictionary *dic;
+    char key_name[32];
+    char val_name[32];
+    char *big;
+    size_t i;
+    const size_t nkeys = 10000;
+
+    dic = dictionary_new_flags(0, DICTIONARY_ARENA, NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(DICTIONARY_ARENA, dic->flags);
+
+    /* Grow through several resizes, strings come from a few chunks */
+    for (i = 0 ; i < nkeys ; i++) {
+        sprintf(key_name, "arena-section:key%zu", i);
+        sprintf(val_name, "arena-test-value-%zu", i);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, val_name));
+    }
+    TEST_ASSERT_EQUAL(nkeys, dic->n);
+    TEST_ASSERT(chunk_count(dic) < nkeys / 500);
+    TEST_ASSERT_EQUAL(0, dic->waste);
+
+    /* A large string does not waste the room left in the current chunk,
+       and short keys are not in the arena */
+    big = malloc(DICTARENASZ);
+    TEST_ASSERT_NOT_NULL(big);
+    memset(big, 'x', DICTARENASZ - 1);
+    big[DICTARENASZ - 1] = '\0';
+    i = dic->arena->used;
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "big", big));
+    TEST_ASSERT_EQUAL(i, dic->arena->used);
+    TEST_ASSERT_EQUAL_STRING(big, dictionary_get(dic, "big", NULL));
+
+    /* Overwritten and deleted strings are accounted for */
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "big", NULL));
+    TEST_ASSERT_EQUAL(DICTARENASZ, dic->waste);
+    for (i = 0 ; i < nkeys ; i += 2) {
+        sprintf(key_name, "arena-section:key%zu", i);
+        dictionary_unset(dic, key_name);
+    }
+    for (i = 1 ; i < nkeys ; i += 2) {
+        sprintf(key_name, "arena-section:key%zu", i);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, "new"));
+    }
+    TEST_ASSERT(dic->waste > DICTARENASZ);
+
+    /* Compaction keeps the content and releases the waste */
+    TEST_ASSERT_EQUAL(0, dictionary_compact(dic));
+    TEST_ASSERT_EQUAL(0, dic->waste);
+    TEST_ASSERT_EQUAL(1, chunk_count(dic));
+    TEST_ASSERT_EQUAL(nkeys / 2 + 1, dic->n);
+    TEST_ASSERT_NULL(dictionary_get(dic, "big", "def"));
+    for (i = 0 ; i < nkeys ; i++) {
+        sprintf(key_name, "arena-section:key%zu", i);
+        TEST_ASSERT_EQUAL_STRING(i % 2 ? "new" : NULL,
+                                 dictionary_get(dic, key_name, NULL));
+    }
+    /* The dictionary is still usable */
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:key0", "back"));
+    TEST_ASSERT_EQUAL_STRING("back", dictionary_get(dic, "sec:key0", NULL));
+
+    free(big);
+    dictionary_del(dic);
+
+    /* Compaction is a no-op for other dictionaries */
+    TEST_ASSERT(dictionary_compact(NULL) != 0);
+    dic = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "key", "a"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "key", "b"));
+    TEST_ASSERT_EQUAL(0, dictionary_compact(dic));
+    TEST_ASSERT_NULL(dic->arena);
+    TEST_ASSERT_EQUAL_STRING("b", dictionary_get(dic, "key", NULL));
+    dictionary_del(dic);
+}
+
+/* Check the section table of a dictionary against a scan of its keys */
+static void check_sections(const dictionary *d)
+{
+    const dictionary_section *sec;
+    size_t i, nkeys, nset = 0;
+    unsigned j, k, prev;
+
+    for (k = d->secfirst, prev = 0 ; k ; prev = k, k = sec->next) {
+        sec = d->sec + k - 1;
+        TEST_ASSERT_EQUAL(prev, sec->prev);
+        TEST_ASSERT_NOT_EQUAL(0, sec->entry);
+        TEST_ASSERT_EQUAL(sec->len, d->klen[sec->entry - 1]);
+        TEST_ASSERT_EQUAL(0, memcmp(sec->name, d->key[sec->entry - 1], sec->len));
+        nset++;
+    }
+    TEST_ASSERT_EQUAL(prev, d->seclast);
+    for (k = 0 ; k < d->nsec ; k++) {
+        sec = d->sec + k;
+        nkeys = 0;
+        for (j = sec->first, prev = 0 ; j ; prev = j, j = d->link[j - 1].next) {
+            TEST_ASSERT_NOT_NULL(d->key[j - 1]);
+            TEST_ASSERT_EQUAL(prev, d->link[j - 1].prev);
+            TEST_ASSERT_EQUAL(k, d->link[j - 1].sec);
+            TEST_ASSERT_EQUAL(':', d->key[j - 1][sec->len]);
+            nkeys++;
+        }
+        TEST_ASSERT_EQUAL(prev, sec->last);
+        TEST_ASSERT_EQUAL(nkeys, sec->nkeys);
+        if (sec->entry)
+            nset--;
+        /* Brute force count of the keys of the section */
+        for (i = 0 ; i < d->size ; i++) {
+            if (d->key[i] && d->klen[i] > sec->len
+                && !memcmp(d->key[i], sec->name, sec->len)
+                && d->key[i][sec->len] == ':')
+                nkeys--;
+        }
+        TEST_ASSERT_EQUAL(0, nkeys);
+    }
+    TEST_ASSERT_EQUAL(0, nset);
+}
+
+void test_dictionary_sections(void)
+{
+    dictionary *dic;
+    const dictionary_section *sec;
+    char key_name[32];
+    unsigned j;
+    int i;
+
+    dic = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_NULL(dictionary_get_section(dic, "sec", 3));
+
+    /* Keys may be set before their section */
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:a", "1"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:b:c", "2"));
+    sec = dictionary_get_section(dic, "sec:a", 3);
+    TEST_ASSERT_NOT_NULL(sec);
+    TEST_ASSERT_EQUAL(0, sec->entry);
+    TEST_ASSERT_EQUAL(2, sec->nkeys);
+    TEST_ASSERT_EQUAL(0, dic->secfirst);
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "other", NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec", NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:d", "3"));
+    sec = dictionary_get_section(dic, "sec", 3);
+    TEST_ASSERT_NOT_NULL(sec);
+    TEST_ASSERT_EQUAL(3, sec->nkeys);
+    TEST_ASSERT_EQUAL_STRING("sec", dic->key[sec->entry - 1]);
+    /* Sections are listed in the order they were set */
+    TEST_ASSERT_EQUAL_STRING("other", dic->sec[dic->secfirst - 1].name);
+    TEST_ASSERT_EQUAL_STRING("sec", dic->sec[dic->seclast - 1].name);
+    /* Keys are listed in insertion order */
+    j = sec->first;
+    TEST_ASSERT_EQUAL_STRING("sec:a", dic->key[j - 1]);
+    j = dic->link[j - 1].next;
+    TEST_ASSERT_EQUAL_STRING("sec:b:c", dic->key[j - 1]);
+    j = dic->link[j - 1].next;
+    TEST_ASSERT_EQUAL_STRING("sec:d", dic->key[j - 1]);
+    TEST_ASSERT_EQUAL(0, dic->link[j - 1].next);
+    /* Overwriting does not change anything */
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:a", "4"));
+    TEST_ASSERT_EQUAL(3, sec->nkeys);
+    check_sections(dic);
+
+    /* Deleting */
+    dictionary_unset(dic, "sec:b:c");
+    TEST_ASSERT_EQUAL(2, sec->nkeys);
+    check_sections(dic);
+    dictionary_unset(dic, "other");
+    TEST_ASSERT_NULL(dictionary_get_section(dic, "other", 5));
+    TEST_ASSERT_EQUAL(dic->secfirst, dic->seclast);
+    dictionary_unset(dic, "sec");
+    TEST_ASSERT_EQUAL(0, dic->secfirst);
+    TEST_ASSERT_EQUAL(0, dic->seclast);
+    TEST_ASSERT_NOT_NULL(dictionary_get_section(dic, "sec", 3));
+    dictionary_unset(dic, "sec:a");
+    dictionary_unset(dic, "sec:d");
+    TEST_ASSERT_NULL(dictionary_get_section(dic, "sec", 3));
+    check_sections(dic);
+    dictionary_del(dic);
+
+    /* Sections stay consistent while the dictionary is resized */
+    dic = dictionary_new_seeded(0, NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    for (i = 0 ; i < 5000 ; i++) {
+        if (i % 10 == 0) {
+            sprintf(key_name, "sec%d", i / 10);
+        } else {
+            sprintf(key_name, "sec%d:key%d", i % 37, i);
+        }
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, "v"));
+        if (i % 3 == 0) {
+            sprintf(key_name, "sec%d:key%d", (i / 2) % 37, i / 2);
+            dictionary_unset(dic, key_name);
+        }
+        if (dic->resize && i % 7 == 0)
+            check_sections(dic);
+    }
+    check_sections(dic);
+    TEST_ASSERT_EQUAL(500, dic->nsec);
+    dictionary_del(dic);
+}
+
+void test_dictionary_order(void)
+{
+    dictionary *dic;
+    char key_name[32];
+    size_t i, j, size;
+
+    dic = dictionary_new(DICTMINSZ);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->used);
+
+    /* A key set again after being deleted goes to the end */
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "a", "1"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "b", "2"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "c", "3"));
+    dictionary_unset(dic, "a");
+    TEST_ASSERT_EQUAL(3, dic->used);
+    TEST_ASSERT_NULL(dic->key[0]);
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "a", "4"));
+    TEST_ASSERT_EQUAL(4, dic->used);
+    TEST_ASSERT_EQUAL_STRING("b", dic->key[1]);
+    TEST_ASSERT_EQUAL_STRING("c", dic->key[2]);
+    TEST_ASSERT_EQUAL_STRING("a", dic->key[3]);
+    /* Holes at the end are not kept */
+    dictionary_unset(dic, "a");
+    dictionary_unset(dic, "c");
+    TEST_ASSERT_EQUAL(2, dic->used);
+    dictionary_del(dic);
+
+    /* Deleting and inserting keys reuses the holes instead of growing */
+    dic = dictionary_new(DICTMINSZ);
+    TEST_ASSERT_NOT_NULL(dic);
+    size = dic->size;
+    for (i = 0 ; i < 10 * size ; i++) {
+        sprintf(key_name, "sec%zu:key%zu", i % 7, i);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, "v"));
+        if (i >= 8) {
+            sprintf(key_name, "sec%zu:key%zu", (i - 8) % 7, i - 8);
+            dictionary_unset(dic, key_name);
+        }
+        TEST_ASSERT(dic->used <= dic->size);
+    }
+    TEST_ASSERT_EQUAL(size, dic->size);
+    TEST_ASSERT_EQUAL(8, dic->n);
+    /* The remaining keys are the last ones, in insertion order */
+    for (i = 10 * size - 8, j = 0 ; j < dic->used ; j++) {
+        if (dic->key[j] == NULL)
+            continue;
+        sprintf(key_name, "sec%zu:key%zu", i % 7, i);
+        TEST_ASSERT_EQUAL_STRING(key_name, dic->key[j]);
+        TEST_ASSERT_EQUAL_STRING("v", dictionary_get(dic, key_name, NULL));
+        i++;
+    }
+    TEST_ASSERT_EQUAL(10 * size, i);
+    check_sections(dic);
+    dictionary_del(dic);
+}
+
+/* Number of free cells of a dictionary */
+static size_t free_cells(const dictionary *d)
+{
+    const union _dictionary_cell_ *c;
+    size_t n = 0;
+
+    for (c = d->freecell ; c ; c = c->next)
+        n++;
+    return n;
+}
+
+void test_dictionary_inline(void)
+{
+    static const unsigned modes[] = { 0, DICTIONARY_ARENA };
+    const char *long_val = "a value that is too long to be inlined";
+    const char *ptrs[100];
+    dictionary *dic;
+    char key_name[32];
+    const char *v;
+    size_t m, i, nfree;
+
+    for (m = 0 ; m < sizeof(modes) / sizeof(modes[0]) ; m++) {
+        dic = dictionary_new_flags(0, modes[m], NULL);
+        TEST_ASSERT_NOT_NULL(dic);
+
+        /* Short key and value share a cell */
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", "8080"));
+        TEST_ASSERT_NOT_NULL(dic->cellpages);
+        TEST_ASSERT_EQUAL(DICTCELLPAGE - 1, free_cells(dic));
+        TEST_ASSERT_EQUAL_PTR(dic->key[0] + DICTSSOSZ, dic->val[0]);
+        TEST_ASSERT_EQUAL_PTR(dictionary_cell(dic, 0), dic->key[0]);
+        TEST_ASSERT_NULL(dic->arena);
+
+        /* Longest inline strings and shortest allocated ones */
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "fifteen-chars-k", "fifteen-chars-v"));
+        TEST_ASSERT_EQUAL_PTR(dic->key[1] + DICTSSOSZ, dic->val[1]);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sixteen-chars-ke", "sixteen-chars-va"));
+        TEST_ASSERT_NULL(dictionary_cell(dic, 2));
+        TEST_ASSERT_EQUAL(DICTCELLPAGE - 2, free_cells(dic));
+        TEST_ASSERT_EQUAL_STRING("sixteen-chars-va",
+                                 dictionary_get(dic, "sixteen-chars-ke", NULL));
+
+        /* Short values are overwritten in place */
+        v = dictionary_get(dic, "port", NULL);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", "443"));
+        TEST_ASSERT_EQUAL_PTR(v, dictionary_get(dic, "port", NULL));
+        TEST_ASSERT_EQUAL_STRING("443", v);
+        /* Setting a value to itself */
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", v));
+        TEST_ASSERT_EQUAL_STRING("443", dictionary_get(dic, "port", NULL));
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", long_val));
+        TEST_ASSERT_EQUAL_STRING(long_val, dictionary_get(dic, "port", NULL));
+        v = dictionary_get(dic, "port", NULL);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", v));
+        TEST_ASSERT_EQUAL_STRING(long_val, dictionary_get(dic, "port", NULL));
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", NULL));
+        TEST_ASSERT_NULL(dictionary_get(dic, "port", "def"));
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "port", "80"));
+        TEST_ASSERT_EQUAL_STRING("80", dictionary_get(dic, "port", NULL));
+
+        /* A long key only needs a cell for a short value */
+        nfree = free_cells(dic);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sixteen-chars-ke", "short"));
+        TEST_ASSERT_EQUAL(nfree - 1, free_cells(dic));
+        TEST_ASSERT_EQUAL_PTR(dictionary_cell(dic, 2), dic->val[2] - DICTSSOSZ);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sixteen-chars-ke", long_val));
+        TEST_ASSERT_EQUAL(nfree, free_cells(dic));
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sixteen-chars-ke", "short"));
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sixteen-chars-ke", NULL));
+        TEST_ASSERT_EQUAL(nfree, free_cells(dic));
+        TEST_ASSERT_NULL(dictionary_get(dic, "sixteen-chars-ke", "def"));
+
+        /* Deleting releases the cell */
+        nfree = free_cells(dic);
+        dictionary_unset(dic, "fifteen-chars-k");
+        TEST_ASSERT_EQUAL(nfree + 1, free_cells(dic));
+        TEST_ASSERT_NULL(dictionary_get(dic, "fifteen-chars-k", NULL));
+
+        /* Pointers stay valid while the dictionary grows */
+        for (i = 0 ; i < 100 ; i++) {
+            sprintf(key_name, "k%zu", i);
+            TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, key_name));
+            ptrs[i] = dictionary_get(dic, key_name, NULL);
+        }
+        for (i = 100 ; i < 10000 ; i++) {
+            sprintf(key_name, "k%zu", i);
+            TEST_ASSERT_EQUAL(0, dictionary_set(dic, key_name, key_name));
+        }
+        for (i = 0 ; i < 100 ; i++) {
+            sprintf(key_name, "k%zu", i);
+            TEST_ASSERT_EQUAL_PTR(ptrs[i], dictionary_get(dic, key_name, NULL));
+            TEST_ASSERT_EQUAL_STRING(key_name, ptrs[i]);
+        }
+        TEST_ASSERT_EQUAL(0, dictionary_compact(dic));
+        TEST_ASSERT_EQUAL_PTR(ptrs[0], dictionary_get(dic, "k0", NULL));
+        dictionary_del(dic);
+    }
+}
+
+void test_dictionary_lower(void)
+{
+    static const unsigned char seed[16] = "0123456789abcdef";
+    dictionary *dic;
+    const dictionary_section *sec;
+    char lower[64];
+    char mixed[64];
+    unsigned char bytes[8];
+    uint64_t w;
+    size_t len, vallen;
+    unsigned c, i, j;
+
+    /* Every byte value, at every position of a word */
+    for (c = 0 ; c < 256 ; c++) {
+        for (j = 0 ; j < 8 ; j++) {
+            for (i = 0 ; i < 8 ; i++)
+                bytes[i] = (unsigned char)(i == j ? c : 'Z' + i);
+            memcpy(&w, bytes, sizeof w);
+            w = dictionary_fold8(w);
+            memcpy(bytes, &w, sizeof w);
+            for (i = 0 ; i < 8 ; i++) {
+                TEST_ASSERT_EQUAL(dictionary_fold1((unsigned char)(i == j ? c : 'Z' + i)),
+                                  bytes[i]);
+            }
+        }
+        if (c >= 'A' && c <= 'Z')
+            TEST_ASSERT_EQUAL(c + 32, dictionary_fold1((unsigned char)c));
+        else
+            TEST_ASSERT_EQUAL(c, dictionary_fold1((unsigned char)c));
+    }
+
+    /* A mixed case key hashes like its lowercase form, at any length */
+    dic = dictionary_new_seeded(0, seed);
+    for (len = 0 ; len < sizeof(mixed) ; len++) {
+        for (i = 0 ; i < len ; i++) {
+            mixed[i] = (char)((i % 3 ? 'A' : 'a') + i % 26);
+            lower[i] = (char)('a' + i % 26);
+        }
+        TEST_ASSERT_EQUAL(dictionary_hash_n(lower, len),
+                          dictionary_murmur(mixed, len, 1));
+        TEST_ASSERT_EQUAL(dictionary_key_hash(dic, lower, len, 0),
+                          dictionary_key_hash(dic, mixed, len, 1));
+        TEST_ASSERT_TRUE(dictionary_key_eq(lower, mixed, len, 1));
+        if (len > 0) {
+            /* A difference in the last byte is not missed */
+            mixed[len - 1] = '!';
+            TEST_ASSERT_TRUE(!dictionary_key_eq(lower, mixed, len, 1));
+        }
+    }
+    dictionary_del(dic);
+
+    dic = dictionary_new(0);
+    /* Keys are stored in lowercase */
+    TEST_ASSERT_EQUAL(0, dictionary_set_lower(dic, "Section:A-Long-Mixed-Case-Key",
+                                              strlen("Section:A-Long-Mixed-Case-Key"),
+                                              "v1", 2));
+    TEST_ASSERT_EQUAL(0, dictionary_set_lower(dic, "Section:KEY", 11, "v2", 2));
+    TEST_ASSERT_EQUAL_STRING("section:a-long-mixed-case-key", dic->key[0]);
+    TEST_ASSERT_EQUAL_STRING("section:key", dic->key[1]);
+    TEST_ASSERT_EQUAL_STRING("v2", dictionary_get(dic, "section:key", NULL));
+    TEST_ASSERT_NULL(dictionary_get(dic, "Section:KEY", NULL));
+    /* The same key in another case replaces the value */
+    TEST_ASSERT_EQUAL(0, dictionary_set_lower(dic, "SECTION:key", 11, "v3", 2));
+    TEST_ASSERT_EQUAL(2, dic->n);
+    TEST_ASSERT_EQUAL_STRING("v3", dictionary_get_lower(dic, "sEcTiOn:KeY", 11, NULL, &vallen));
+    TEST_ASSERT_EQUAL(2, vallen);
+    TEST_ASSERT_EQUAL_STRING("v1", dictionary_get_lower(dic, "SECTION:A-LONG-MIXED-CASE-KEY",
+                             strlen("SECTION:A-LONG-MIXED-CASE-KEY"), NULL, NULL));
+    /* Not a prefix match */
+    TEST_ASSERT_NULL(dictionary_get_lower(dic, "SECTION:KEY", 10, NULL, NULL));
+    /* Only one section was created */
+    TEST_ASSERT_EQUAL(1, dic->nsec);
+    TEST_ASSERT_EQUAL_STRING("section", dic->sec[0].name);
+    sec = dictionary_get_section_lower(dic, "SeCtIoN", 7);
+    TEST_ASSERT_NOT_NULL(sec);
+    TEST_ASSERT_EQUAL(2, sec->nkeys);
+    TEST_ASSERT_EQUAL_PTR(sec, dictionary_get_section(dic, "section", 7));
+    TEST_ASSERT_NULL(dictionary_get_section(dic, "SeCtIoN", 7));
+    /* Bytes outside ASCII are not folded */
+    TEST_ASSERT_EQUAL(0, dictionary_set_lower(dic, "\xC3\x89T\xC3\x89", 5, "summer", 6));
+    TEST_ASSERT_EQUAL_STRING("\xC3\x89t\xC3\x89", dic->key[2]);
+    TEST_ASSERT_EQUAL_STRING("summer", dictionary_get_lower(dic, "\xC3\x89t\xC3\x89", 5, NULL, NULL));
+    TEST_ASSERT_NULL(dictionary_get_lower(dic, "\xC3\xA9t\xC3\xA9", 5, NULL, NULL));
+
+    dictionary_unset_lower(dic, "Section:Key", 11);
+    TEST_ASSERT_NULL(dictionary_get(dic, "section:key", NULL));
+    TEST_ASSERT_EQUAL(2, dic->n);
+    dictionary_unset_lower(dic, "section:a-long-mixed-case-key", 29);
+    TEST_ASSERT_EQUAL(1, dic->n);
+    dictionary_del(dic);
+}
+
+/* Release function counting its calls */
+static int released;
+static void release_buffer(char *buf, size_t size)
+{
+    (void)size;
+    free(buf);
+    released++;
+}
+
+void test_dictionary_borrowed(void)
+{
+    static const unsigned modes[] = { 0, DICTIONARY_ARENA };
+    const char *text = "short;a value long enough to be borrowed;"
+                       "Another value borrowed from the buffer";
+    const size_t size = strlen(text);
+    dictionary *dic;
+    char *buf;
+    const char *v;
+    size_t m;
+
+    for (m = 0 ; m < sizeof(modes) / sizeof(modes[0]) ; m++) {
+        dic = dictionary_new_flags(0, modes[m], NULL);
+        TEST_ASSERT_NOT_NULL(dic);
+        buf = (char*) malloc(size);
+        TEST_ASSERT_NOT_NULL(buf);
+        memcpy(buf, text, size);
+
+        /* Without an attached buffer, values are copied */
+        TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(dic, "K", 1, buf + 6, 34));
+        TEST_ASSERT_NOT_EQUAL(buf + 6, dictionary_get(dic, "k", NULL));
+        TEST_ASSERT_EQUAL(';', buf[40]);
+
+        TEST_ASSERT_EQUAL(0, dictionary_attach(dic, buf, size, release_buffer));
+        TEST_ASSERT_EQUAL(-1, dictionary_attach(dic, buf, size, release_buffer));
+
+        /* Long values are NUL-terminated in place */
+        TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(dic, "K", 1, buf + 6, 34));
+        TEST_ASSERT_EQUAL_PTR(buf + 6, dictionary_get(dic, "k", NULL));
+        TEST_ASSERT_EQUAL_STRING("a value long enough to be borrowed", buf + 6);
+        /* Short ones are inlined */
+        TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(dic, "s", 1, buf, 5));
+        TEST_ASSERT_EQUAL_PTR(dic->key[1] + DICTSSOSZ, dictionary_get(dic, "s", NULL));
+        TEST_ASSERT_EQUAL(';', buf[5]);
+        /* No room for the terminator */
+        TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(dic, "last", 4, buf + 41, size - 41));
+        v = dictionary_get(dic, "last", NULL);
+        TEST_ASSERT_FALSE(dictionary_borrowed(dic, v));
+        TEST_ASSERT_EQUAL_STRING("Another value borrowed from the buffer", v);
+        TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(dic, "last", 4, buf + 41, 22));
+        TEST_ASSERT_EQUAL_STRING("Another value borrowed", dictionary_get(dic, "last", NULL));
+        TEST_ASSERT_EQUAL_PTR(buf + 41, dictionary_get(dic, "last", NULL));
+        /* Other setters still copy */
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "copy", buf + 6));
+        TEST_ASSERT_NOT_EQUAL(buf + 6, dictionary_get(dic, "copy", NULL));
+
+        /* Borrowed values are never freed nor moved */
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, "k", "a new value, owned by the dictionary"));
+        TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(dic, "K", 1, buf + 6, 34));
+        dictionary_unset(dic, "copy");
+        TEST_ASSERT_EQUAL(0, dictionary_compact(dic));
+        TEST_ASSERT_EQUAL_PTR(buf + 6, dictionary_get(dic, "k", NULL));
+        TEST_ASSERT_EQUAL_PTR(buf + 41, dictionary_get(dic, "last", NULL));
+
+        released = 0;
+        dictionary_del(dic);
+        TEST_ASSERT_EQUAL(1, released);
+    }
+}
+
+void test_dictionary_reserve(void)
+{
+    dictionary *dic;
+    char key[32];
+    size_t size;
+    unsigned i, secsize;
+
+    /* Reserved entries are added without growing */
+    dic = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dictionary_reserve(dic, 0, 0));
+    TEST_ASSERT_EQUAL(DICTMINSZ, dic->size);
+    TEST_ASSERT_EQUAL(0, dic->secsize);
+    TEST_ASSERT_EQUAL(0, dictionary_reserve(dic, 5050, 50));
+    size = dic->size;
+    secsize = dic->secsize;
+    TEST_ASSERT_TRUE(size * 3 >= 5050 * 4);
+    TEST_ASSERT_TRUE(secsize >= 50);
+    for (i = 0 ; i < 5050 ; i++) {
+        if (i % 101 == 0)
+            sprintf(key, "s%u", i / 101);
+        else
+            sprintf(key, "s%u:k%u", i / 101, i % 101);
+        TEST_ASSERT_EQUAL(0, dictionary_set(dic, key, "v"));
+        TEST_ASSERT_EQUAL(size, dic->size);
+        TEST_ASSERT_NULL(dic->resize);
+    }
+    TEST_ASSERT_EQUAL(50, dic->nsec);
+    TEST_ASSERT_EQUAL(secsize, dic->secsize);
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "one:more", "v"));
+
+    /* Reserving in a filled dictionary keeps its entries */
+    TEST_ASSERT_EQUAL(0, dictionary_reserve(dic, 20000, 1000));
+    TEST_ASSERT_NULL(dic->resize);
+    TEST_ASSERT_TRUE(dic->size * 3 >= (dic->used + 20000) * 4);
+    TEST_ASSERT_TRUE(dic->secsize >= 1051);
+    for (i = 0 ; i < 5050 ; i++) {
+        if (i % 101 == 0)
+            sprintf(key, "s%u", i / 101);
+        else
+            sprintf(key, "s%u:k%u", i / 101, i % 101);
+        TEST_ASSERT_EQUAL_STRING("v", dictionary_get(dic, key, NULL));
+    }
+    TEST_ASSERT_EQUAL(100, dictionary_get_section(dic, "s7", 2)->nkeys);
+    TEST_ASSERT_EQUAL_STRING("v", dictionary_get(dic, "one:more", NULL));
+
+    /* Impossible requests fail, leaving the dictionary unchanged */
+    size = dic->size;
+    TEST_ASSERT_EQUAL(-1, dictionary_reserve(dic, (size_t)-1, 0));
+    TEST_ASSERT_EQUAL(size, dic->size);
+    TEST_ASSERT_EQUAL(-1, dictionary_reserve(NULL, 1, 1));
+    dictionary_del(dic);
+}
+
+void test_dictionary_merge(void)
+{
+    static const unsigned char seed[16] = "0123456789abcdef";
+    dictionary *dic, *from, *seeded;
+    char buf[] = "a value long enough to be borrowed";
+    char key[32];
+    unsigned i;
+
+    dic = dictionary_new(0);
+    from = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_NOT_NULL(from);
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec", NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:a", "1"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(dic, "sec:b", "2"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(from, "other", NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_set(from, "other:c", "3"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(from, "sec:b", "two"));
+    TEST_ASSERT_EQUAL(0, dictionary_set(from, "sec:d", NULL));
+
+    /* Values of from win, new keys are appended in their order */
+    TEST_ASSERT_EQUAL(0, dictionary_merge(dic, from));
+    TEST_ASSERT_EQUAL(6, dic->n);
+    TEST_ASSERT_EQUAL_STRING("1", dictionary_get(dic, "sec:a", NULL));
+    TEST_ASSERT_EQUAL_STRING("two", dictionary_get(dic, "sec:b", NULL));
+    TEST_ASSERT_EQUAL_STRING("3", dictionary_get(dic, "other:c", NULL));
+    TEST_ASSERT_NULL(dictionary_get(dic, "sec:d", "x"));
+    TEST_ASSERT_EQUAL_STRING("sec:b", dic->key[2]);
+    TEST_ASSERT_EQUAL_STRING("other", dic->key[3]);
+    TEST_ASSERT_EQUAL_STRING("other:c", dic->key[4]);
+    TEST_ASSERT_EQUAL_STRING("sec:d", dic->key[5]);
+    TEST_ASSERT_EQUAL(3, dictionary_get_section(dic, "sec", 3)->nkeys);
+    TEST_ASSERT_EQUAL(1, dictionary_get_section(dic, "other", 5)->nkeys);
+    /* from is left unchanged */
+    TEST_ASSERT_EQUAL(4, from->n);
+    TEST_ASSERT_EQUAL_STRING("two", dictionary_get(from, "sec:b", NULL));
+
+    /* Dictionaries hashing differently */
+    seeded = dictionary_new_seeded(0, seed);
+    TEST_ASSERT_NOT_NULL(seeded);
+    for (i = 0 ; i < 1000 ; i++) {
+        sprintf(key, "s%u:k%u", i % 10, i);
+        TEST_ASSERT_EQUAL(0, dictionary_set(seeded, key, key));
+    }
+    TEST_ASSERT_EQUAL(0, dictionary_merge(seeded, dic));
+    TEST_ASSERT_EQUAL(0, dictionary_merge(dic, seeded));
+    TEST_ASSERT_EQUAL(1006, seeded->n);
+    TEST_ASSERT_EQUAL(1006, dic->n);
+    for (i = 0 ; i < 1000 ; i++) {
+        sprintf(key, "s%u:k%u", i % 10, i);
+        TEST_ASSERT_EQUAL_STRING(key, dictionary_get(dic, key, NULL));
+        TEST_ASSERT_EQUAL_STRING(key, dictionary_get(seeded, key, NULL));
+    }
+    TEST_ASSERT_EQUAL_STRING("two", dictionary_get(seeded, "sec:b", NULL));
+    dictionary_del(seeded);
+
+    /* Keys are not lowercased again, borrowed values stay borrowed */
+    dictionary_del(from);
+    from = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(from);
+    TEST_ASSERT_EQUAL(0, dictionary_set(from, "Sec:Upper", "U"));
+    TEST_ASSERT_EQUAL(0, dictionary_attach(from, buf, sizeof(buf), NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_attach(dic, buf, sizeof(buf), NULL));
+    TEST_ASSERT_EQUAL(0, dictionary_set_borrowed(from, "sec:long", 8, buf, sizeof(buf) - 1));
+    TEST_ASSERT_EQUAL(0, dictionary_merge(dic, from));
+    TEST_ASSERT_EQUAL_STRING("U", dictionary_get_n(dic, "Sec:Upper", 9, NULL, NULL));
+    TEST_ASSERT_NULL(dictionary_get(dic, "sec:upper", NULL));
+    TEST_ASSERT_EQUAL_PTR(buf, dictionary_get(dic, "sec:long", NULL));
+
+    TEST_ASSERT_EQUAL(-1, dictionary_merge(dic, dic));
+    TEST_ASSERT_EQUAL(-1, dictionary_merge(NULL, from));
+    TEST_ASSERT_EQUAL(-1, dictionary_merge(dic, NULL));
+    dictionary_del(from);
+    dictionary_del(dic);
+}
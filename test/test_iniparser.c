@@ -8,6 +8,9 @@
 /* static functions as well */
 #include "iniparser.c"
 
+/* Size of the line buffers of the reference parsers below */
+#define ASCIILINESZ (1024)
+
 #define GOOD_INI_PATH "ressources/good_ini"
 #define BAD_INI_PATH "ressources/bad_ini"
 #define OLD_INI_PATH "ressources/old.ini"
@@ -121,6 +124,249 @@ void test_iniparser_strlwc(void)
     TEST_ASSERT_EQUAL_STRING("overwrite me !", out_buffer);
 }
 
+/*
+ * Reference implementation: the line parser iniparser_line() replaced,
+ * made of sscanf() calls. iniparser_line() must accept exactly the same
+ * grammar.
+ */
+static char * xstrdup(const char * s)
+{
+    char * t ;
+    size_t len ;
+    if (!s)
+        return NULL ;
+
+    len = strlen(s) + 1 ;
+    t = (char*) malloc(len) ;
+    if (t) {
+        memcpy(t, s, len) ;
+    }
+    return t ;
+}
+
+static unsigned strstrip(char * s)
+{
+    char *last = NULL ;
+    char *dest = s;
+
+    if (s==NULL) return 0;
+
+    last = s + strlen(s);
+    while (isspace((unsigned char)*s) && *s) s++;
+    while (last > s) {
+        if (!isspace((unsigned char)*(last-1)))
+            break ;
+        last -- ;
+    }
+    *last = (char)0;
+
+    memmove(dest,s,last - s + 1);
+    return last - s;
+}
+
+static void parse_quoted_value(char *value, char quote) {
+    char c;
+    char *quoted;
+    int q = 0, v = 0;
+    int esc = 0;
+
+    if(!value)
+        return;
+
+    quoted = xstrdup(value);
+
+    if(!quoted) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        goto end_of_value;
+    }
+
+    while((c = quoted[q]) != '\0') {
+        if(!esc) {
+            if(c == '\\') {
+                esc = 1;
+                q++;
+                continue;
+            }
+
+            if(c == quote) {
+                goto end_of_value;
+            }
+        }
+        esc = 0;
+        value[v] = c;
+        v++;
+        q++;
+    }
+end_of_value:
+    value[v] = '\0';
+    free(quoted);
+}
+
+static line_status sscanf_line(
+    const char * input_line,
+    char * section,
+    char * key,
+    char * value)
+{
+    line_status sta ;
+    char * line = NULL;
+    size_t      len ;
+    int d_quote;
+
+    line = xstrdup(input_line);
+    len = strstrip(line);
+
+    sta = LINE_UNPROCESSED ;
+    if (len<1) {
+        /* Empty line */
+        sta = LINE_EMPTY ;
+    } else if (line[0]=='#' || line[0]==';') {
+        /* Comment line */
+        sta = LINE_COMMENT ;
+    } else if (line[0]=='[' && line[len-1]==']') {
+        /* Section name without opening square bracket */
+        sscanf(line, "[%[^\n]", section);
+        len = strlen(section);
+        /* Section name without closing square bracket */
+        if(section[len-1] == ']')
+        {
+            section[len-1] = '\0';
+        }
+        strstrip(section);
+        sta = LINE_SECTION ;
+    } else if ((d_quote = sscanf (line, "%[^=] = \"%[^\n]\"", key, value)) == 2
+               ||  sscanf (line, "%[^=] = '%[^\n]'",   key, value) == 2) {
+        /* Usual key=value with quotes, with or without comments */
+        strstrip(key);
+        if(d_quote == 2)
+            parse_quoted_value(value, '"');
+        else
+            parse_quoted_value(value, '\'');
+        /* Don't strip spaces from values surrounded with quotes */
+        sta = LINE_VALUE ;
+    } else if (sscanf (line, "%[^=] = %[^;#]", key, value) == 2) {
+        /* Usual key=value without quotes, with or without comments */
+        strstrip(key);
+        strstrip(value);
+        /*
+         * sscanf cannot handle '' or "" as empty values
+         * this is done here
+         */
+        if (!strcmp(value, "\"\"") || (!strcmp(value, "''"))) {
+            value[0]=0 ;
+        }
+        sta = LINE_VALUE ;
+    } else if (sscanf(line, "%[^=] = %[;#]", key, value)==2
+           ||  sscanf(line, "%[^=] %[=]", key, value) == 2) {
+        /*
+         * Special cases:
+         * key=
+         * key=;
+         * key=#
+         */
+        strstrip(key);
+        value[0]=0 ;
+        sta = LINE_VALUE ;
+    } else {
+        /* Generate syntax error */
+        sta = LINE_ERROR ;
+    }
+
+    free(line);
+    return sta ;
+}
+
+/*
+ * Tool function running iniparser_line() with NUL-terminated outputs. With
+ * an offset, the line is copied at that offset of a scanned buffer and
+ * parsed with its structural index.
+ */
+static line_status parse_line_at(const char *input, size_t offset,
+                                 char *section, char *key, char *val)
+{
+    char buf[ASCIILINESZ+128];
+    uint64_t bits[(ASCIILINESZ+128)/64];
+    line_index idx;
+    char *line = buf + offset;
+    line_span name, value;
+    line_status sta;
+    size_t len = strlen(input);
+
+    memset(buf, 'x', offset);
+    memcpy(line, input, len + 1);
+    if (offset) {
+        scan_structural(buf, offset + len, bits);
+        idx.base = buf;
+        idx.bits = bits;
+    }
+    sta = iniparser_line(line, len, &name, &value, offset ? &idx : NULL);
+    if (sta == LINE_SECTION) {
+        memcpy(section, name.s, name.len);
+        section[name.len] = '\0';
+    } else if (sta == LINE_VALUE) {
+        memcpy(key, name.s, name.len);
+        key[name.len] = '\0';
+        memcpy(val, value.s, value.len);
+        val[value.len] = '\0';
+    }
+    return sta;
+}
+
+static line_status parse_line(const char *input, char *section, char *key, char *val)
+{
+    return parse_line_at(input, 0, section, key, val);
+}
+
+/* Tool function checking that iniparser_line() parses a line like sscanf_line() */
+static void check_line(const char *input)
+{
+    static const size_t offsets[] = { 0, 1, 59, 64 };
+    char section[ASCIILINESZ+1], key[ASCIILINESZ+1], val[ASCIILINESZ+1];
+    char ref_section[ASCIILINESZ+1], ref_key[ASCIILINESZ+1], ref_val[ASCIILINESZ+1];
+    char error_msg[ASCIILINESZ+64];
+    line_status sta, ref;
+    size_t i;
+
+    /* sscanf_line() leaves section untouched on "[\n...]" */
+    strcpy(ref_section, "\x01");
+    ref = sscanf_line(input, ref_section, ref_key, ref_val);
+    for (i = 0 ; i < sizeof(offsets) / sizeof(offsets[0]) ; i++) {
+        sta = parse_line_at(input, offsets[i], section, key, val);
+        sprintf(error_msg, "line \"%s\" at offset %u", input, (unsigned)offsets[i]);
+        TEST_ASSERT_EQUAL_MESSAGE(ref, sta, error_msg);
+        if (sta == LINE_SECTION && strcmp(ref_section, "\x01")) {
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(ref_section, section, error_msg);
+        } else if (sta == LINE_VALUE) {
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(ref_key, key, error_msg);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(ref_val, val, error_msg);
+        }
+    }
+}
+
+/* Tool function checking every line of a file, joined like the loader does */
+static void check_file_lines(const char *path)
+{
+    char line[ASCIILINESZ+1];
+    int last = 0, len;
+    FILE *in = fopen(path, "r");
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(in, path);
+    while (fgets(line+last, ASCIILINESZ-last, in) != NULL) {
+        len = (int)strlen(line)-1;
+        if (len <= 0)
+            continue;
+        while (len >= 0 && isspace((unsigned char)line[len]))
+            line[len--] = 0;
+        if (len >= 0 && line[len] == '\\') {
+            last = len;
+            continue;
+        }
+        last = 0;
+        check_line(line);
+    }
+    fclose(in);
+}
+
 void test_iniparser_strstrip(void)
 {
     /* First element in the array is the expected stripping result */
@@ -308,6 +554,19 @@ void test_iniparser_getseckeys(void)
 
     dictionary_del(dic);
     dic = NULL;
+
+    /* Sections whose name holds a ':' keep their keys */
+    dic = iniparser_load_buffer("[a:b]\nx=1\ny=2\n[a]\nz=3\n", 22, "colon", NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL_STRING("1", iniparser_getstring(dic, "a:b:x", NULL));
+    TEST_ASSERT_EQUAL(2, iniparser_getsecnkeys(dic, "a:b"));
+    TEST_ASSERT_EQUAL(2, iniparser_getsecnkeys(dic, "A:B"));
+    TEST_ASSERT_EQUAL_STRING(keys, iniparser_getseckeys(dic, "a:b", keys));
+    TEST_ASSERT_EQUAL_STRING("a:b:x", keys[0]);
+    TEST_ASSERT_EQUAL_STRING("a:b:y", keys[1]);
+    TEST_ASSERT_EQUAL(4, iniparser_getsecnkeys(dic, "a"));
+    dictionary_del(dic);
+    dic = NULL;
 }
 
 void test_iniparser_getstring(void)
@@ -338,6 +597,33 @@ void test_iniparser_getstring(void)
     dic = NULL;
 }
 
+void test_iniparser_getstring_n(void)
+{
+    const char *buf = "Sec42:Key5 and more";
+    size_t len;
+
+    len = 42;
+    TEST_ASSERT_NULL(iniparser_getstring_n(NULL, "dummy", 5, NULL, &len));
+    TEST_ASSERT_EQUAL(0, len);
+
+    dic = generate_dictionary(100, 10);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL_STRING("value-42/5",
+                             iniparser_getstring_n(dic, buf, 10, NULL, &len));
+    TEST_ASSERT_EQUAL(10, len);
+    TEST_ASSERT_EQUAL_STRING("def",
+                             iniparser_getstring_n(dic, buf, 9, "def", &len));
+    TEST_ASSERT_EQUAL(3, len);
+
+    /* iniparser_set_n lowercases the slice it is given */
+    TEST_ASSERT_EQUAL(0, iniparser_set_n(dic, buf, 10, buf + 11, 3));
+    TEST_ASSERT_EQUAL_STRING("and", iniparser_getstring(dic, "sec42:key5", NULL));
+    TEST_ASSERT_EQUAL(0, iniparser_set_n(dic, "NEW:KEY", 7, NULL, 0));
+    TEST_ASSERT_EQUAL(1, iniparser_find_entry(dic, "new:key"));
+    dictionary_del(dic);
+    dic = NULL;
+}
+
 void test_iniparser_getint(void)
 {
     unsigned i;
@@ -755,79 +1041,315 @@ void test_iniparser_line(void)
     char val     [ASCIILINESZ+1] ;
 
     /* Test empty line */
-    TEST_ASSERT_EQUAL(LINE_EMPTY, iniparser_line("", section, key, val));
-    TEST_ASSERT_EQUAL(LINE_EMPTY, iniparser_line("    ", section, key, val));
-    TEST_ASSERT_EQUAL(LINE_EMPTY, iniparser_line("\t", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_EMPTY, parse_line("", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_EMPTY, parse_line("    ", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_EMPTY, parse_line("\t", section, key, val));
 
     /* Test valid syntax */
-    TEST_ASSERT_EQUAL(LINE_SECTION, iniparser_line("[s]", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_SECTION, parse_line("[s]", section, key, val));
     TEST_ASSERT_EQUAL_STRING("s", section);
 
-    TEST_ASSERT_EQUAL(LINE_SECTION, iniparser_line("[section 0]", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_SECTION, parse_line("[section 0]", section, key, val));
     TEST_ASSERT_EQUAL_STRING("section 0", section);
 
-    TEST_ASSERT_EQUAL(LINE_SECTION, iniparser_line("[ section 0 ]", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_SECTION, parse_line("[ section 0 ]", section, key, val));
     TEST_ASSERT_EQUAL_STRING("section 0", section);
 
-    TEST_ASSERT_EQUAL(LINE_SECTION, iniparser_line("[ section ]", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_SECTION, parse_line("[ section ]", section, key, val));
     TEST_ASSERT_EQUAL_STRING("section", section);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("k=1", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("k=1", section, key, val));
     TEST_ASSERT_EQUAL_STRING("k", key);
     TEST_ASSERT_EQUAL_STRING("1", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key = 0x42", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key = 0x42", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("0x42", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key= value with spaces", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key= value with spaces", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("value with spaces", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("k =_!<>''", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("k =_!<>''", section, key, val));
     TEST_ASSERT_EQUAL_STRING("k", key);
     TEST_ASSERT_EQUAL_STRING("_!<>''", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("empty_value =", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("empty_value =", section, key, val));
     TEST_ASSERT_EQUAL_STRING("empty_value", key);
     TEST_ASSERT_EQUAL_STRING("", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("empty_value =        \t\n", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("empty_value =        \t\n", section, key, val));
     TEST_ASSERT_EQUAL_STRING("empty_value", key);
     TEST_ASSERT_EQUAL_STRING("", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key =\tval # comment", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key =\tval # comment", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("val", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key \n\n = \n val", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key \n\n = \n val", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("val", val);
 
-    TEST_ASSERT_EQUAL(LINE_COMMENT, iniparser_line(";comment", section, key, val));
-    TEST_ASSERT_EQUAL(LINE_COMMENT, iniparser_line(" # comment", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_COMMENT, parse_line(";comment", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_COMMENT, parse_line(" # comment", section, key, val));
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key = \"  do_not_strip  \"", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key = \"  do_not_strip  \"", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("  do_not_strip  ", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key = '    '", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key = '    '", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("    ", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key = \"\"", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key = \"\"", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("", val);
 
-    TEST_ASSERT_EQUAL(LINE_VALUE, iniparser_line("key = ''", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_VALUE, parse_line("key = ''", section, key, val));
     TEST_ASSERT_EQUAL_STRING("key", key);
     TEST_ASSERT_EQUAL_STRING("", val);
 
     /* Test syntax error */
-    TEST_ASSERT_EQUAL(LINE_ERROR, iniparser_line("empty_value", section, key, val));
-    TEST_ASSERT_EQUAL(LINE_ERROR, iniparser_line("not finished\\", section, key, val));
-    TEST_ASSERT_EQUAL(LINE_ERROR, iniparser_line("0x42 / 0b101010", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_ERROR, parse_line("empty_value", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_ERROR, parse_line("not finished\\", section, key, val));
+    TEST_ASSERT_EQUAL(LINE_ERROR, parse_line("0x42 / 0b101010", section, key, val));
+
+}
+
+void test_iniparser_line_grammar(void)
+{
+    /* Characters that matter to the grammar, and a letter */
+    static const char alphabet[] = "a=[]\"'\\;# \t\n";
+    const size_t nchars = sizeof(alphabet) - 1;
+    static const char *files[] = {
+        OLD_INI_PATH, GRUEZI_INI_PATH, UTF8_INI_PATH, QUOTES_INI_PATH
+    };
+    struct dirent *curr;
+    char ini_path[276];
+    char line[16];
+    size_t len, i, n, digits, total;
+    unsigned seed = 42;
+
+    /* Every line of the test files */
+    for (i = 0 ; i < sizeof(files) / sizeof(files[0]) ; i++)
+        check_file_lines(files[i]);
+    dir = opendir(GOOD_INI_PATH);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dir, "cannot open " GOOD_INI_PATH);
+    while ((curr = readdir(dir)) != NULL) {
+        if (strstr(curr->d_name, ".ini") == NULL)
+            continue;
+        sprintf(ini_path, "%s/%s", GOOD_INI_PATH, curr->d_name);
+        check_file_lines(ini_path);
+    }
+    closedir(dir);
+    dir = opendir(BAD_INI_PATH);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dir, "cannot open " BAD_INI_PATH);
+    while ((curr = readdir(dir)) != NULL) {
+        if (strstr(curr->d_name, ".ini") == NULL)
+            continue;
+        sprintf(ini_path, "%s/%s", BAD_INI_PATH, curr->d_name);
+        check_file_lines(ini_path);
+    }
+
+    /* Every line of up to 5 of these characters */
+    for (len = 0, total = 1 ; len <= 5 ; len++, total *= nchars) {
+        for (n = 0 ; n < total ; n++) {
+            for (i = 0, digits = n ; i < len ; i++, digits /= nchars)
+                line[i] = alphabet[digits % nchars];
+            line[len] = '\0';
+            check_line(line);
+        }
+    }
+    /* And longer random ones */
+    for (n = 0 ; n < 100000 ; n++) {
+        len = 6 + n % (sizeof(line) - 6);
+        for (i = 0 ; i < len ; i++) {
+            seed = seed * 1103515245 + 12345;
+            line[i] = alphabet[(seed >> 16) % nchars];
+        }
+        line[len] = '\0';
+        check_line(line);
+    }
+}
+
+void test_iniparser_scan(void)
+{
+    /* Structural characters, NUL, and bytes that only differ by a bit */
+    static const char alphabet[] = "\n=;#\"'\\\0aZ[\x0a\x1d\x3b\xa3\xdc\xff";
+    const size_t nchars = sizeof(alphabet) - 1;
+    static char eqs[64 * 1024 + 5];
+    char buf[300];
+    uint64_t ref[(sizeof(buf) + 63) / 64], bits[(sizeof(buf) + 63) / 64];
+    size_t n, i, round, eq, br, ref_eq, ref_br, nl, ref_nl;
+    unsigned seed = 7;
+
+    for (round = 0 ; round < 50 ; round++) {
+        for (n = 0 ; n <= sizeof(buf) ; n++) {
+            for (i = 0 ; i < n ; i++) {
+                seed = seed * 1103515245 + 12345;
+                buf[i] = alphabet[(seed >> 16) % nchars];
+            }
+            /* Reference bitmap, with clear bits past the end */
+            memset(ref, 0, sizeof(ref));
+            for (i = 0 ; i < n ; i++) {
+                if (memchr("\n=;#\"'\\", buf[i], 8) != NULL)
+                    ref[i / 64] |= (uint64_t)1 << (i % 64);
+            }
+            memset(bits, 0xff, sizeof(bits));
+            scan_scalar(buf, n, bits);
+            TEST_ASSERT_EQUAL_MEMORY(ref, bits, (n + 63) / 64 * sizeof(*bits));
+#ifdef INISCAN_X86
+            memset(bits, 0xff, sizeof(bits));
+            scan_sse2(buf, n, bits);
+            TEST_ASSERT_EQUAL_MEMORY(ref, bits, (n + 63) / 64 * sizeof(*bits));
+            if (__builtin_cpu_supports("avx2")) {
+                memset(bits, 0xff, sizeof(bits));
+                scan_avx2(buf, n, bits);
+                TEST_ASSERT_EQUAL_MEMORY(ref, bits, (n + 63) / 64 * sizeof(*bits));
+            }
+#endif
+            /* Counts of '=', '[' and '\n' */
+            ref_eq = ref_br = ref_nl = 0;
+            for (i = 0 ; i < n ; i++) {
+                ref_eq += buf[i] == '=';
+                ref_br += buf[i] == '[';
+                ref_nl += buf[i] == '\n';
+            }
+            eq = br = nl = 1;
+            count_scalar(buf, n, &eq, &br, &nl);
+            TEST_ASSERT_EQUAL(ref_eq + 1, eq);
+            TEST_ASSERT_EQUAL(ref_br + 1, br);
+            TEST_ASSERT_EQUAL(ref_nl + 1, nl);
+#ifdef INISCAN_X86
+            eq = br = nl = 1;
+            count_sse2(buf, n, &eq, &br, &nl);
+            TEST_ASSERT_EQUAL(ref_eq + 1, eq);
+            TEST_ASSERT_EQUAL(ref_br + 1, br);
+            TEST_ASSERT_EQUAL(ref_nl + 1, nl);
+            if (__builtin_cpu_supports("avx2")) {
+                eq = br = nl = 1;
+                count_avx2(buf, n, &eq, &br, &nl);
+                TEST_ASSERT_EQUAL(ref_eq + 1, eq);
+                TEST_ASSERT_EQUAL(ref_br + 1, br);
+                TEST_ASSERT_EQUAL(ref_nl + 1, nl);
+            }
+#endif
+        }
+    }
+
+    /* More than 255 vectors of matches, which overflow a byte */
+    memset(eqs, '=', sizeof(eqs));
+    eq = br = nl = 0;
+    count_entries(eqs, sizeof(eqs), &eq, &br, &nl);
+    TEST_ASSERT_EQUAL(sizeof(eqs), eq);
+    TEST_ASSERT_EQUAL(0, br);
+    TEST_ASSERT_EQUAL(0, nl);
+}
+
+/* Tool function writing a file made of a single long line */
+static void create_long_line_ini_file(const char *filename, size_t len, int newline)
+{
+    size_t i;
+
+    ini = fopen(filename, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open file");
+    fputs("a=", ini);
+    for (i = 2 ; i < len ; i++)
+        fputc('x', ini);
+    if (newline)
+        fputc('\n', ini);
+    fclose(ini);
+    ini = NULL;
+}
+
+void test_iniparser_load_blocks(void)
+{
+    static const size_t lens[] = { 1022, 1023, 1024, 70000, 300000 };
+    char val[ASCIILINESZ];
+    char key[32];
+    size_t len, i, n;
+    int ret;
+
+    /* Lines of all lengths, some of them continued, over several blocks */
+    ini = fopen(TMP_INI_PATH, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open " TMP_INI_PATH);
+    fputs("[s]\n", ini);
+    for (n = 0 ; n < 2000 ; n++) {
+        len = (n * 37) % 900 + 1;
+        for (i = 0 ; i < len ; i++)
+            val[i] = (char)('a' + (n + i) % 26);
+        val[len] = '\0';
+        if (n % 5 == 0) {
+            fprintf(ini, "key%u = \"%.*s;#=\\\"\" ; comment\n",
+                    (unsigned)n, (int)len, val);
+        } else if (n % 7 == 0) {
+            fprintf(ini, "key%u = %.*s\\\n%s\n",
+                    (unsigned)n, (int)(len / 2), val, val + len / 2);
+        } else {
+            fprintf(ini, "key%u=%s\r\n", (unsigned)n, val);
+        }
+    }
+    fclose(ini);
+    ini = NULL;
+    dic = iniparser_load(TMP_INI_PATH);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dic, "cannot load " TMP_INI_PATH);
+    TEST_ASSERT_EQUAL(2000, iniparser_getsecnkeys(dic, "s"));
+    for (n = 0 ; n < 2000 ; n++) {
+        len = (n * 37) % 900 + 1;
+        for (i = 0 ; i < len ; i++)
+            val[i] = (char)('a' + (n + i) % 26);
+        if (n % 5 == 0)
+            memcpy(val + len, ";#=\"", 5);
+        else
+            val[len] = '\0';
+        sprintf(key, "s:key%u", (unsigned)n);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(val, iniparser_getstring(dic, key, NULL), key);
+    }
+    iniparser_freedict(dic);
 
+    /* Lines of any length, within a block or over several ones */
+    for (n = 0 ; n < sizeof(lens) / sizeof(lens[0]) ; n++) {
+        for (i = 0 ; i < 2 ; i++) {
+            create_long_line_ini_file(TMP_INI_PATH, lens[n], (int)i);
+            dic = iniparser_load(TMP_INI_PATH);
+            TEST_ASSERT_NOT_NULL(dic);
+            TEST_ASSERT_EQUAL(lens[n] - 2, strlen(iniparser_getstring(dic, ":a", "")));
+            iniparser_freedict(dic);
+            dic = iniparser_load_mmap(TMP_INI_PATH, NULL);
+            TEST_ASSERT_NOT_NULL(dic);
+            TEST_ASSERT_EQUAL(lens[n] - 2, strlen(iniparser_getstring(dic, ":a", "")));
+            iniparser_freedict(dic);
+        }
+    }
+
+    /* Long multi-line values, such as certificates, survive a dump */
+    ini = fopen(TMP_INI_PATH, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open " TMP_INI_PATH);
+    fputs("[tls]\ncert = -----BEGIN CERTIFICATE----- \\\n", ini);
+    for (n = 0 ; n < 400 ; n++) {
+        for (i = 0 ; i < 64 ; i++)
+            fputc('A' + (int)((n + i) % 26), ini);
+        fputs(" \\\n", ini);
+    }
+    fputs("-----END CERTIFICATE-----\n", ini);
+    fclose(ini);
+    dic = iniparser_load(TMP_INI_PATH);
+    TEST_ASSERT_NOT_NULL(dic);
+    len = strlen(iniparser_getstring(dic, "tls:cert", ""));
+    TEST_ASSERT_EQUAL(400 * 65 + 53, len);
+    ini = fopen(TMP_INI_PATH, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open " TMP_INI_PATH);
+    iniparser_dump_ini(dic, ini);
+    fclose(ini);
+    ini = NULL;
+    iniparser_freedict(dic);
+    dic = iniparser_load(TMP_INI_PATH);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(len, strlen(iniparser_getstring(dic, "tls:cert", "")));
+    iniparser_freedict(dic);
+    dic = NULL;
+    ret = remove(TMP_INI_PATH);
+    TEST_ASSERT_GREATER_OR_EQUAL_MESSAGE(0, ret, "cannot remove " TMP_INI_PATH);
 }
 
 void test_iniparser_load(void)
@@ -873,6 +1395,136 @@ void test_iniparser_load(void)
     dir = NULL;
 }
 
+void test_iniparser_load_seeded(void)
+{
+    iniparser_options opts;
+    dictionary *plain;
+    int i;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.flags = INIPARSER_SEEDED;
+    dic = iniparser_load_opts(OLD_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dic, "cannot load " OLD_INI_PATH);
+    TEST_ASSERT_EQUAL(DICTIONARY_SEEDED, dic->flags & DICTIONARY_SEEDED);
+
+    /* Same content as a default load */
+    plain = iniparser_load(OLD_INI_PATH);
+    TEST_ASSERT_NOT_NULL(plain);
+    TEST_ASSERT_EQUAL(0, plain->flags & DICTIONARY_SEEDED);
+    TEST_ASSERT_EQUAL(plain->n, dic->n);
+    for (i = 0; i < (int)plain->size; ++i) {
+        if (plain->key[i] == NULL)
+            continue;
+        TEST_ASSERT_EQUAL_STRING(plain->val[i],
+                                 iniparser_getstring(dic, plain->key[i], NULL));
+    }
+    dictionary_del(plain);
+
+    /* NULL options are the defaults */
+    ini = fopen(OLD_INI_PATH, "r");
+    TEST_ASSERT_NOT_NULL(ini);
+    plain = iniparser_load_file_opts(ini, OLD_INI_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(plain);
+    TEST_ASSERT_EQUAL(0, plain->flags & DICTIONARY_SEEDED);
+    dictionary_del(plain);
+}
+
+void test_iniparser_load_arena(void)
+{
+    iniparser_options opts;
+    dictionary *plain;
+    int i;
+
+    /* Arena is the default */
+    dic = iniparser_load(OLD_INI_PATH);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dic, "cannot load " OLD_INI_PATH);
+    TEST_ASSERT_EQUAL(DICTIONARY_ARENA, dic->flags & DICTIONARY_ARENA);
+
+    memset(&opts, 0, sizeof(opts));
+    opts.flags = INIPARSER_NO_ARENA;
+    plain = iniparser_load_opts(OLD_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL(plain);
+    TEST_ASSERT_EQUAL(0, plain->flags & DICTIONARY_ARENA);
+    TEST_ASSERT_NULL(plain->arena);
+
+    /* Same content either way */
+    TEST_ASSERT_EQUAL(plain->n, dic->n);
+    for (i = 0; i < (int)plain->size; ++i) {
+        if (plain->key[i] == NULL)
+            continue;
+        TEST_ASSERT_EQUAL_STRING(plain->val[i],
+                                 iniparser_getstring(dic, plain->key[i], NULL));
+    }
+    dictionary_del(plain);
+
+    /* Long values set later are reclaimed by compaction */
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "section:key1", "Gouda, aged 24 months"));
+    TEST_ASSERT_NOT_NULL(dic->arena);
+    TEST_ASSERT_EQUAL(0, dic->waste);
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "section:key1", "Gouda, aged 36 months"));
+    TEST_ASSERT(dic->waste > 0);
+    TEST_ASSERT_EQUAL(0, dictionary_compact(dic));
+    TEST_ASSERT_EQUAL(0, dic->waste);
+    TEST_ASSERT_EQUAL_STRING("Gouda, aged 36 months",
+                             iniparser_getstring(dic, "section:key1", NULL));
+}
+
+void test_iniparser_load_case_sensitive(void)
+{
+    iniparser_options opts;
+    iniparser_key *k;
+    const char *keys[2];
+
+    memset(&opts, 0, sizeof(opts));
+    opts.flags = INIPARSER_CASE_SENSITIVE;
+    dic = iniparser_load_opts(GRUEZI_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dic, "cannot load " GRUEZI_INI_PATH);
+    TEST_ASSERT_EQUAL(DICTIONARY_CASE_SENSITIVE, dic->flags & DICTIONARY_CASE_SENSITIVE);
+
+    /* Names are stored and looked up as written */
+    TEST_ASSERT_EQUAL_STRING("Chuchichäschtli", iniparser_getsecname(dic, 0));
+    TEST_ASSERT_EQUAL_STRING("Grüzi",
+                             iniparser_getstring(dic, "Chuchichäschtli:Gruss", NULL));
+    TEST_ASSERT_NULL(iniparser_getstring(dic, "chuchichäschtli:gruss", NULL));
+    TEST_ASSERT_TRUE(iniparser_find_entry(dic, "Chuchichäschtli"));
+    TEST_ASSERT_FALSE(iniparser_find_entry(dic, "chuchichäschtli"));
+    TEST_ASSERT_EQUAL(2, iniparser_getsecnkeys(dic, "Chuchichäschtli"));
+    TEST_ASSERT_EQUAL(0, iniparser_getsecnkeys(dic, "CHUCHICHäSCHTLI"));
+    TEST_ASSERT_NOT_NULL(iniparser_getseckeys(dic, "Chuchichäschtli", keys));
+    TEST_ASSERT_EQUAL_STRING("Chuchichäschtli:10.123", keys[0]);
+
+    /* Compiled keys keep the case they were given */
+    k = iniparser_key_compile("Chuchichäschtli:Gruss");
+    TEST_ASSERT_NOT_NULL(k);
+    TEST_ASSERT_EQUAL_STRING("chuchichäschtli:gruss", k->key);
+    TEST_ASSERT_EQUAL_STRING("Chuchichäschtli:Gruss", k->exact);
+    TEST_ASSERT_EQUAL_STRING("Grüzi", iniparser_getstring_key(dic, k, NULL));
+
+    /* Keys set later are case sensitive too */
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "Chuchichäschtli:gruss", "Hoi"));
+    TEST_ASSERT_EQUAL_STRING("Grüzi",
+                             iniparser_getstring(dic, "Chuchichäschtli:Gruss", NULL));
+    TEST_ASSERT_EQUAL_STRING("Hoi",
+                             iniparser_getstring(dic, "Chuchichäschtli:gruss", NULL));
+    iniparser_unset(dic, "Chuchichäschtli:GRUSS");
+    TEST_ASSERT_EQUAL(3, iniparser_getsecnkeys(dic, "Chuchichäschtli"));
+    iniparser_unset(dic, "Chuchichäschtli:Gruss");
+    TEST_ASSERT_EQUAL(2, iniparser_getsecnkeys(dic, "Chuchichäschtli"));
+    iniparser_freedict(dic);
+
+    /* The same file loaded with default options is case insensitive */
+    dic = iniparser_load(GRUEZI_INI_PATH);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->flags & DICTIONARY_CASE_SENSITIVE);
+    TEST_ASSERT_EQUAL_STRING("chuchichäschtli", iniparser_getsecname(dic, 0));
+    TEST_ASSERT_EQUAL_STRING("Grüzi", iniparser_getstring_key(dic, k, NULL));
+    TEST_ASSERT_EQUAL_STRING("Grüzi",
+                             iniparser_getstring(dic, "CHUCHICHäSCHTLI:GRUSS", NULL));
+    iniparser_key_free(k);
+    iniparser_freedict(dic);
+    dic = NULL;
+}
+
 void test_dictionary_wrapper(void)
 {
     dic = dictionary_new(10);
@@ -1072,6 +1724,23 @@ void test_iniparser_dumpsection_ini(void)
     TEST_ASSERT_EQUAL_STRING("321abc", str);
     iniparser_freedict(dic);
     dic = NULL;
+    /*section names are looked up ignoring case*/
+    dic = iniparser_load_buffer("[Sec]\na=1\nb=2\n[sec:x]\nc=3\n", 26, "mixed", NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    ini = fopen(TEST_INI_PATH,"w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open " TEST_INI_PATH);
+    iniparser_dumpsection_ini(dic,"SEC",ini);
+    iniparser_dumpsection_ini(dic,"SEC:X",ini);
+    fclose(ini);
+    ini = NULL;
+    iniparser_freedict(dic);
+    dic = iniparser_load(TEST_INI_PATH);
+    TEST_ASSERT_NOT_NULL_MESSAGE(dic, "cannot load " TEST_INI_PATH);
+    TEST_ASSERT_EQUAL_STRING("1", iniparser_getstring(dic,"sec:a",NULL));
+    TEST_ASSERT_EQUAL_STRING("2", iniparser_getstring(dic,"sec:b",NULL));
+    TEST_ASSERT_EQUAL_STRING("3", iniparser_getstring(dic,"sec:x:c",NULL));
+    iniparser_freedict(dic);
+    dic = NULL;
     /*test extra large keys*/
     dic = dictionary_new(0);
     TEST_ASSERT_NOT_NULL(dic);
@@ -1123,6 +1792,109 @@ void test_iniparser_find_entry(void)
     dic = NULL;
 }
 
+void test_iniparser_key(void)
+{
+    iniparser_key *k, *num, *flag, *missing;
+    dictionary *seeded;
+
+    /* NULL test */
+    TEST_ASSERT_NULL(iniparser_key_compile(NULL));
+    iniparser_key_free(NULL);
+
+    k = iniparser_key_compile("Sec42:KEY5");
+    TEST_ASSERT_NOT_NULL(k);
+    TEST_ASSERT_EQUAL_STRING("sec42:key5", k->key);
+    TEST_ASSERT_EQUAL(10, k->len);
+    TEST_ASSERT_EQUAL(dictionary_hash("sec42:key5"), k->hash);
+    TEST_ASSERT_EQUAL_STRING("def", iniparser_getstring_key(NULL, k, "def"));
+
+    dic = generate_dictionary(100, 10);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL_STRING("def", iniparser_getstring_key(dic, NULL, "def"));
+    TEST_ASSERT_EQUAL_STRING("value-42/5", iniparser_getstring_key(dic, k, NULL));
+
+    num = iniparser_key_compile("Numbers:Answer");
+    flag = iniparser_key_compile("numbers:FLAG");
+    missing = iniparser_key_compile("numbers:missing");
+    TEST_ASSERT_NOT_NULL(num);
+    TEST_ASSERT_NOT_NULL(flag);
+    TEST_ASSERT_NOT_NULL(missing);
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "numbers", NULL));
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "numbers:answer", "0x2a"));
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "numbers:flag", "Yes"));
+    TEST_ASSERT_EQUAL(42, iniparser_getint_key(dic, num, -1));
+    TEST_ASSERT_EQUAL(42, iniparser_getlongint_key(dic, num, -1));
+    TEST_ASSERT_EQUAL(42, iniparser_getint64_key(dic, num, -1));
+    TEST_ASSERT_EQUAL(42, iniparser_getuint64_key(dic, num, 0));
+    TEST_ASSERT_EQUAL(1, iniparser_getboolean_key(dic, flag, -1));
+    TEST_ASSERT_EQUAL(-1, iniparser_getint_key(dic, missing, -1));
+    TEST_ASSERT_EQUAL(-1, iniparser_getlongint_key(dic, missing, -1));
+    TEST_ASSERT_EQUAL(-1, iniparser_getint64_key(dic, missing, -1));
+    TEST_ASSERT_EQUAL(7, iniparser_getuint64_key(dic, missing, 7));
+    TEST_ASSERT_EQUAL(-1, iniparser_getboolean_key(dic, missing, -1));
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "numbers:answer", "4.5"));
+    TEST_ASSERT_EQUAL(4.5, iniparser_getdouble_key(dic, num, -1.0));
+    TEST_ASSERT_EQUAL(-1.0, iniparser_getdouble_key(dic, missing, -1.0));
+
+    /* Keyed hashes are computed on the fly */
+    seeded = dictionary_new_seeded(0, NULL);
+    TEST_ASSERT_NOT_NULL(seeded);
+    TEST_ASSERT_EQUAL(0, iniparser_set(seeded, "Sec42:Key5", "seeded"));
+    TEST_ASSERT_EQUAL_STRING("seeded", iniparser_getstring_key(seeded, k, NULL));
+    dictionary_del(seeded);
+
+    iniparser_key_free(k);
+    iniparser_key_free(num);
+    iniparser_key_free(flag);
+    iniparser_key_free(missing);
+    iniparser_freedict(dic);
+    dic = NULL;
+}
+
+void test_iniparser_long_key(void)
+{
+    char key[3 * ASCIILINESZ];
+    char lower[3 * ASCIILINESZ];
+    size_t i, len = sizeof(key) - 1;
+
+    for (i = 0 ; i < len ; i++) {
+        key[i] = (char)((i & 1 ? 'A' : 'a') + i % 26);
+        lower[i] = (char)('a' + i % 26);
+    }
+    key[len] = lower[len] = '\0';
+    key[4] = lower[4] = ':';
+
+    dic = dictionary_new(10);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, key, "long"));
+    /* The whole key is stored, not its first ASCIILINESZ characters */
+    TEST_ASSERT_EQUAL(len, dic->klen[0]);
+    TEST_ASSERT_EQUAL_STRING(lower, dic->key[0]);
+    TEST_ASSERT_EQUAL_STRING("long", iniparser_getstring(dic, key, NULL));
+    TEST_ASSERT_EQUAL_STRING("long", iniparser_getstring(dic, lower, NULL));
+    TEST_ASSERT_TRUE(iniparser_find_entry(dic, key));
+    key[ASCIILINESZ] = '\0';
+    TEST_ASSERT_NULL(iniparser_getstring(dic, key, NULL));
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, key, "prefix"));
+    TEST_ASSERT_EQUAL(2, dic->n);
+    TEST_ASSERT_EQUAL_STRING("long", iniparser_getstring(dic, lower, NULL));
+    /* The section of both keys is found whatever its case */
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "AbCd", NULL));
+    TEST_ASSERT_EQUAL(2, iniparser_getsecnkeys(dic, "aBcD"));
+
+    iniparser_unset(dic, lower);
+    TEST_ASSERT_NULL(iniparser_getstring(dic, lower, NULL));
+    TEST_ASSERT_EQUAL_STRING("prefix", iniparser_getstring(dic, key, NULL));
+    iniparser_unset(dic, key);
+    iniparser_unset(dic, NULL);
+    TEST_ASSERT_EQUAL(1, dic->n);
+    /* Values are not truncated either */
+    TEST_ASSERT_EQUAL(0, iniparser_set(dic, "abcd:value", lower));
+    TEST_ASSERT_EQUAL_STRING(lower, iniparser_getstring(dic, "abcd:value", NULL));
+    iniparser_freedict(dic);
+    dic = NULL;
+}
+
 void test_iniparser_utf8(void)
 {
     const char *str;
@@ -1161,6 +1933,1084 @@ static void create_empty_ini_file(const char *filename)
     ini = NULL;
 }
 
+/* Tool function checking that two dictionaries hold the same entries */
+static void check_same_entries(const dictionary *ref, const dictionary *d, const char *msg)
+{
+    size_t i;
+
+    TEST_ASSERT_EQUAL_MESSAGE(ref->n, d->n, msg);
+    for (i = 0 ; i < ref->used ; i++) {
+        if (ref->key[i] == NULL)
+            continue;
+        TEST_ASSERT_TRUE_MESSAGE(iniparser_find_entry(d, ref->key[i]), ref->key[i]);
+        if (ref->val[i] == NULL)
+            TEST_ASSERT_EQUAL_PTR_MESSAGE(NULL, iniparser_getstring(d, ref->key[i], NULL),
+                                          ref->key[i]);
+        else
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(ref->val[i],
+                                             iniparser_getstring(d, ref->key[i], NULL),
+                                             ref->key[i]);
+    }
+}
+
+/* Tool function telling whether a string points into the mapped file */
+static int borrowed(const dictionary *d, const char *s)
+{
+    return d->ext != NULL && s >= d->ext && s < d->ext + d->extsize;
+}
+
+/* Tool function writing sections of short keys and values, size bytes at least */
+static void create_short_values_ini_file(const char *filename, long size)
+{
+    long i;
+
+    ini = fopen(filename, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, filename);
+    for (i = 0 ; ftell(ini) < size ; i++) {
+        if (i % 100 == 0)
+            fprintf(ini, "[sec%ld]\n", i / 100);
+        fprintf(ini, "key%ld = %ld\n", i % 100, i);
+    }
+    fclose(ini);
+    ini = NULL;
+}
+
+/*
+ * Tool function returning the private dirty memory, in kB, of the mapping
+ * holding p, which counts the pages the process got its own copy of, or
+ * -1 where /proc/self/smaps is not available
+ */
+static long private_dirty_kb(const void *p)
+{
+    FILE *in = fopen("/proc/self/smaps", "r");
+    char line[512];
+    unsigned long lo, hi, kb;
+    long total = -1;
+    int found = 0;
+
+    if (in == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            found = lo <= (unsigned long)p && (unsigned long)p < hi;
+            if (found)
+                total = 0;
+        } else if (found && sscanf(line, "Private_Dirty: %lu", &kb) == 1) {
+            total += (long)kb;
+        }
+    }
+    fclose(in);
+    return total;
+}
+
+void test_iniparser_load_mmap(void)
+{
+    static const char *dirs[] = { GOOD_INI_PATH, BAD_INI_PATH };
+    iniparser_options opts;
+    struct dirent *curr;
+    char ini_path[276];
+    dictionary *ref;
+    const char *v;
+    size_t i;
+    long kb;
+    int ret;
+
+    iniparser_set_error_callback(_error_callback);
+    dic = iniparser_load_mmap("/you/shall/not/path", NULL);
+    TEST_ASSERT_NULL(dic);
+
+    /* Same result as iniparser_load() on every test file */
+    for (i = 0 ; i < sizeof(dirs) / sizeof(dirs[0]) ; i++) {
+        dir = opendir(dirs[i]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(dir, dirs[i]);
+        while ((curr = readdir(dir)) != NULL) {
+            if (strstr(curr->d_name, ".ini") == NULL)
+                continue;
+            sprintf(ini_path, "%s/%s", dirs[i], curr->d_name);
+            ref = iniparser_load(ini_path);
+            dic = iniparser_load_mmap(ini_path, NULL);
+            if (ref == NULL) {
+                TEST_ASSERT_EQUAL_PTR_MESSAGE(NULL, dic, ini_path);
+            } else {
+                TEST_ASSERT_NOT_NULL_MESSAGE(dic, ini_path);
+                check_same_entries(ref, dic, ini_path);
+            }
+            dictionary_del(ref);
+            dictionary_del(dic);
+        }
+        closedir(dir);
+    }
+    dir = NULL;
+    iniparser_set_error_callback(NULL);
+
+    /* Long values point into the mapping, other strings are copied */
+    ini = fopen(TMP_INI_PATH, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open " TMP_INI_PATH);
+    fputs("[Section]\n"
+          "Plain = a value long enough to be borrowed ; comment\n"
+          "Quoted = \"a quoted value with \\\"escapes\\\"\"\n"
+          "Multi = a value spanning \\\n"
+          "        two lines\n"
+          "Short = 42\n"
+          "Last = a value right at the end of the file", ini);
+    fclose(ini);
+    ini = NULL;
+    memset(&opts, 0, sizeof(opts));
+    for (i = 0 ; i < 2 ; i++) {
+        opts.flags = i ? INIPARSER_NO_ARENA : 0;
+        dic = iniparser_load_mmap(TMP_INI_PATH, &opts);
+        TEST_ASSERT_NOT_NULL(dic);
+        TEST_ASSERT_NOT_NULL(dic->ext);
+        v = iniparser_getstring(dic, "section:plain", NULL);
+        TEST_ASSERT_EQUAL_STRING("a value long enough to be borrowed", v);
+        TEST_ASSERT_TRUE(borrowed(dic, v));
+        v = iniparser_getstring(dic, "section:quoted", NULL);
+        TEST_ASSERT_EQUAL_STRING("a quoted value with \"escapes\"", v);
+        TEST_ASSERT_TRUE(borrowed(dic, v));
+        v = iniparser_getstring(dic, "section:multi", NULL);
+        TEST_ASSERT_EQUAL_STRING("a value spanning         two lines", v);
+        TEST_ASSERT_FALSE(borrowed(dic, v));
+        TEST_ASSERT_EQUAL(42, iniparser_getint(dic, "section:short", 0));
+        v = iniparser_getstring(dic, "section:last", NULL);
+        TEST_ASSERT_EQUAL_STRING("a value right at the end of the file", v);
+        TEST_ASSERT_FALSE(borrowed(dic, v));
+        TEST_ASSERT_EQUAL_STRING("section", iniparser_getsecname(dic, 0));
+        TEST_ASSERT_FALSE(borrowed(dic, dic->key[0]));
+
+        /* Borrowed values can be overwritten and survive compaction */
+        TEST_ASSERT_EQUAL(0, iniparser_set(dic, "section:plain", "a value set later"));
+        TEST_ASSERT_EQUAL(0, dictionary_compact(dic));
+        TEST_ASSERT_TRUE(borrowed(dic,
+                         iniparser_getstring(dic, "section:quoted", NULL)));
+        iniparser_freedict(dic);
+    }
+
+    /* Pages holding no long value stay shared with the page cache */
+    create_short_values_ini_file(TMP_INI_PATH, 4 << 20);
+    dic = iniparser_load_mmap(TMP_INI_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_NOT_NULL(dic->ext);
+    kb = private_dirty_kb(dic->ext);
+    if (kb >= 0)
+        TEST_ASSERT_LESS_THAN(512, kb);
+    iniparser_freedict(dic);
+
+    /* Empty files are not mapped */
+    create_empty_ini_file(TMP_INI_PATH);
+    dic = iniparser_load_mmap(TMP_INI_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->n);
+    TEST_ASSERT_NULL(dic->ext);
+    iniparser_freedict(dic);
+    dic = NULL;
+    ret = remove(TMP_INI_PATH);
+    TEST_ASSERT_GREATER_OR_EQUAL_MESSAGE(0, ret, "cannot remove " TMP_INI_PATH);
+}
+
+/* Tool function reading a whole file into an allocated buffer */
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *in = fopen(path, "rb");
+    char *buf;
+    long size;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(in, path);
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+    rewind(in);
+    buf = (char*) malloc((size_t)size + 1);
+    TEST_ASSERT_NOT_NULL(buf);
+    *len = fread(buf, 1, (size_t)size, in);
+    TEST_ASSERT_EQUAL((size_t)size, *len);
+    fclose(in);
+    return buf;
+}
+
+void test_iniparser_load_buffer(void)
+{
+    static const char *dirs[] = { GOOD_INI_PATH, BAD_INI_PATH };
+    static const char text[] = "[Section]\n"
+                               "Key = a value long enough to be borrowed\n"
+                               "Quoted = \"a quoted value with \\\"escapes\\\"\"";
+    struct dirent *curr;
+    char ini_path[276];
+    dictionary *ref, *insitu;
+    char *buf, *orig;
+    const char *v;
+    size_t len, i;
+
+    iniparser_set_error_callback(_error_callback);
+    /* Same result as iniparser_load() on every test file */
+    for (i = 0 ; i < sizeof(dirs) / sizeof(dirs[0]) ; i++) {
+        dir = opendir(dirs[i]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(dir, dirs[i]);
+        while ((curr = readdir(dir)) != NULL) {
+            if (strstr(curr->d_name, ".ini") == NULL)
+                continue;
+            sprintf(ini_path, "%s/%s", dirs[i], curr->d_name);
+            ref = iniparser_load(ini_path);
+            buf = read_file(ini_path, &len);
+            orig = (char*) malloc(len + 1);
+            TEST_ASSERT_NOT_NULL(orig);
+            memcpy(orig, buf, len);
+            dic = iniparser_load_buffer(buf, len, ini_path, NULL);
+            TEST_ASSERT_EQUAL_MEMORY_MESSAGE(orig, buf, len, ini_path);
+            insitu = iniparser_load_buffer_insitu(buf, len, ini_path, NULL);
+            free(orig);
+            if (ref == NULL) {
+                TEST_ASSERT_EQUAL_PTR_MESSAGE(NULL, dic, ini_path);
+                TEST_ASSERT_EQUAL_PTR_MESSAGE(NULL, insitu, ini_path);
+            } else {
+                TEST_ASSERT_NOT_NULL_MESSAGE(dic, ini_path);
+                TEST_ASSERT_NOT_NULL_MESSAGE(insitu, ini_path);
+                check_same_entries(ref, dic, ini_path);
+                check_same_entries(ref, insitu, ini_path);
+            }
+            dictionary_del(ref);
+            dictionary_del(dic);
+            dictionary_del(insitu);
+            free(buf);
+        }
+        closedir(dir);
+    }
+    dir = NULL;
+    iniparser_set_error_callback(NULL);
+
+    /* The copying loader does not keep the buffer */
+    buf = (char*) malloc(sizeof(text));
+    TEST_ASSERT_NOT_NULL(buf);
+    memcpy(buf, text, sizeof(text));
+    dic = iniparser_load_buffer(buf, sizeof(text) - 1, "text", NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_NULL(dic->ext);
+    free(buf);
+    TEST_ASSERT_EQUAL_STRING("a value long enough to be borrowed",
+                             iniparser_getstring(dic, "section:key", NULL));
+    TEST_ASSERT_EQUAL_STRING("a quoted value with \"escapes\"",
+                             iniparser_getstring(dic, "section:quoted", NULL));
+    iniparser_freedict(dic);
+
+    /* The in-situ loader borrows from it */
+    buf = (char*) malloc(sizeof(text));
+    TEST_ASSERT_NOT_NULL(buf);
+    memcpy(buf, text, sizeof(text));
+    dic = iniparser_load_buffer_insitu(buf, sizeof(text) - 1, "text", NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    v = iniparser_getstring(dic, "section:key", NULL);
+    TEST_ASSERT_EQUAL_STRING("a value long enough to be borrowed", v);
+    TEST_ASSERT_TRUE(borrowed(dic, v));
+    v = iniparser_getstring(dic, "section:quoted", NULL);
+    TEST_ASSERT_EQUAL_STRING("a quoted value with \"escapes\"", v);
+    TEST_ASSERT_TRUE(borrowed(dic, v));
+    iniparser_freedict(dic);
+    free(buf);
+
+    /* Empty buffers */
+    dic = iniparser_load_buffer(NULL, 0, "empty", NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->n);
+    iniparser_freedict(dic);
+    dic = iniparser_load_buffer_insitu(NULL, 0, "empty", NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->n);
+    iniparser_freedict(dic);
+    dic = NULL;
+}
+
+/* Tool function writing the output of twisted-genhuge.py */
+static void create_genhuge_ini_file(const char *filename)
+{
+    int i, j;
+
+    ini = fopen(filename, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open file");
+    for (i = 0 ; i < 100 ; i++) {
+        fprintf(ini, "[%03d]\n", i);
+        for (j = 0 ; j < 100 ; j++)
+            fprintf(ini, "key-%03d=1;\n", j);
+    }
+    fclose(ini);
+    ini = NULL;
+}
+
+void test_iniparser_load_presized(void)
+{
+    dictionary *ref, *loaded[4];
+    char *buf;
+    size_t len, i;
+
+    /* What the loaders should allocate: room for every entry, at once */
+    ref = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(ref);
+    TEST_ASSERT_EQUAL(0, dictionary_reserve(ref, 100 * 101, 100));
+
+    create_genhuge_ini_file(TMP_INI_PATH);
+    buf = read_file(TMP_INI_PATH, &len);
+    loaded[0] = iniparser_load(TMP_INI_PATH);
+    loaded[1] = iniparser_load_mmap(TMP_INI_PATH, NULL);
+    loaded[2] = iniparser_load_buffer(buf, len, TMP_INI_PATH, NULL);
+    loaded[3] = iniparser_load_buffer_insitu(buf, len, TMP_INI_PATH, NULL);
+    for (i = 0 ; i < sizeof(loaded) / sizeof(loaded[0]) ; i++) {
+        TEST_ASSERT_NOT_NULL(loaded[i]);
+        TEST_ASSERT_EQUAL(100 * 101, loaded[i]->n);
+        TEST_ASSERT_EQUAL(100, loaded[i]->nsec);
+        /* Neither the storage nor the section table ever grew */
+        TEST_ASSERT_EQUAL(ref->size, loaded[i]->size);
+        TEST_ASSERT_NULL(loaded[i]->resize);
+        TEST_ASSERT_EQUAL(ref->secsize, loaded[i]->secsize);
+        iniparser_freedict(loaded[i]);
+    }
+    free(buf);
+    remove(TMP_INI_PATH);
+
+    /* Values full of '=' and '[' are no reason to reserve more */
+    dictionary_del(ref);
+    ref = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(ref);
+    len = 200 * 1024;
+    buf = (char*) malloc(len);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, '=', len / 2);
+    memset(buf + len / 2, '[', len / 2);
+    memcpy(buf, "[s]\nk", 5);
+    loaded[0] = iniparser_load_buffer(buf, len, "equals", NULL);
+    loaded[1] = iniparser_load_buffer_insitu(buf, len, "equals", NULL);
+    for (i = 0 ; i < 2 ; i++) {
+        TEST_ASSERT_NOT_NULL(loaded[i]);
+        TEST_ASSERT_EQUAL(2, loaded[i]->n);
+        TEST_ASSERT_EQUAL(ref->size, loaded[i]->size);
+        iniparser_freedict(loaded[i]);
+    }
+    free(buf);
+    dictionary_del(ref);
+}
+
+/* Tool function writing a file large enough to be split in parts */
+static void create_parts_ini_file(const char *filename, int bad)
+{
+    int i;
+
+    ini = fopen(filename, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, "cannot open file");
+    fputs("top = before any section\n", ini);
+    for (i = 0 ; i < 12000 ; i++) {
+        /* Sections come back, their keys are set again */
+        fprintf(ini, "[Sec%03d]\n", i % 700);
+        fprintf(ini, "Key%d = %d ; comment\n", i % 3, i);
+        fprintf(ini, "Quoted = \"value \\\"%d\\\" of a quoted key\"\n", i);
+        /* A section line ending a multi-line value is part of it */
+        fprintf(ini, "Multi = start of %d \\\n", i);
+        fputs("[not a section]\n", ini);
+        if (bad && i % 5000 == 4999)
+            fputs("this is not a key\n", ini);
+    }
+    fclose(ini);
+    ini = NULL;
+}
+
+/* Tool function checking that two dictionaries hold the same entries in the same order */
+static void check_same_order(const dictionary *ref, const dictionary *d, const char *msg)
+{
+    size_t i, j;
+
+    check_same_entries(ref, d, msg);
+    for (i = 0, j = 0 ; i < ref->used ; i++, j++) {
+        if (ref->key[i] == NULL)
+            continue;
+        while (d->key[j] == NULL)
+            j++;
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(ref->key[i], d->key[j], msg);
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(iniparser_getnsec(ref), iniparser_getnsec(d), msg);
+    for (i = 0 ; i < (size_t)iniparser_getnsec(ref) ; i++)
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(iniparser_getsecname(ref, (int)i),
+                                         iniparser_getsecname(d, (int)i), msg);
+}
+
+void test_iniparser_load_threads(void)
+{
+    static const unsigned threads[] = { 0, 1, 2, 3, 8 };
+    static const char text[] = "k=v\\\n[s1]\nx=1\n[s2]\ny=2\n";
+    static const char nul[] = "a=1\n[s1]\nb\0=2\n[s2]\nc=3\n";
+    iniparser_options opts;
+    dictionary *ref, *loaded[3];
+    char *buf, *copy;
+    char ref_error[1024];
+    size_t len, cut[5], i, j, k;
+
+    /* Parts start at a section line, never in a multi-line value */
+    TEST_ASSERT_EQUAL(2, ini_split(text, sizeof(text) - 1, 4, cut));
+    TEST_ASSERT_EQUAL(0, cut[0]);
+    TEST_ASSERT_EQUAL(14, cut[1]);
+    TEST_ASSERT_EQUAL(sizeof(text) - 1, cut[2]);
+    TEST_ASSERT_EQUAL(1, ini_split(nul, sizeof(nul) - 1, 2, cut));
+    TEST_ASSERT_EQUAL(sizeof(nul) - 1, cut[1]);
+    TEST_ASSERT_EQUAL(1, ini_split("a=1\nb=2\n", 8, 2, cut));
+    TEST_ASSERT_EQUAL(2, ini_split("a=1\nb=2\nc=3\n  [s] \nd=4\n", 23, 2, cut));
+    TEST_ASSERT_EQUAL(12, cut[1]);
+
+    /* Same dictionary as a single parse, whatever the number of threads */
+    memset(&opts, 0, sizeof(opts));
+    create_parts_ini_file(TMP_INI_PATH, 0);
+    buf = read_file(TMP_INI_PATH, &len);
+    TEST_ASSERT_TRUE(len > 3 * INIPARTMIN);
+    copy = (char*) malloc(len);
+    TEST_ASSERT_NOT_NULL(copy);
+    ref = iniparser_load(TMP_INI_PATH);
+    TEST_ASSERT_NOT_NULL(ref);
+    TEST_ASSERT_EQUAL_STRING("11999", iniparser_getstring(ref, "sec099:key2", NULL));
+    TEST_ASSERT_EQUAL_STRING("start of 11999 [not a section]",
+                             iniparser_getstring(ref, "sec099:multi", NULL));
+    for (i = 0 ; i < sizeof(threads) / sizeof(threads[0]) ; i++) {
+        opts.threads = threads[i];
+        for (j = 0 ; j < 2 ; j++) {
+            opts.flags = j ? INIPARSER_SEEDED : 0;
+            memcpy(copy, buf, len);
+            loaded[0] = iniparser_load_mmap(TMP_INI_PATH, &opts);
+            loaded[1] = iniparser_load_buffer(buf, len, TMP_INI_PATH, &opts);
+            loaded[2] = iniparser_load_buffer_insitu(copy, len, TMP_INI_PATH, &opts);
+            for (k = 0 ; k < 3 ; k++) {
+                TEST_ASSERT_NOT_NULL(loaded[k]);
+                check_same_order(ref, loaded[k], "threads");
+                iniparser_freedict(loaded[k]);
+            }
+        }
+    }
+    iniparser_freedict(ref);
+    free(copy);
+    free(buf);
+
+    /* Same errors, with their line number in the whole file */
+    iniparser_set_error_callback(_error_callback);
+    create_parts_ini_file(TMP_INI_PATH, 1);
+    ref = iniparser_load(TMP_INI_PATH);
+    TEST_ASSERT_NULL(ref);
+    strcpy(ref_error, _last_error);
+    TEST_ASSERT_NOT_NULL(strstr(ref_error, "(50003)"));
+    memset(&opts, 0, sizeof(opts));
+    opts.threads = 4;
+    _last_error[0] = '\0';
+    TEST_ASSERT_NULL(iniparser_load_mmap(TMP_INI_PATH, &opts));
+    TEST_ASSERT_EQUAL_STRING(ref_error, _last_error);
+    iniparser_set_error_callback(NULL);
+    remove(TMP_INI_PATH);
+}
+
+#ifdef INITHREADS
+/* Tool function looking up every key of the first sections of a lazy dictionary */
+static void *lazy_lookups(void *arg)
+{
+    const dictionary *d = (const dictionary *)arg;
+    char key[32];
+    long i, n = 0;
+
+    for (i = 0 ; i < 20000 ; i++) {
+        sprintf(key, "sec%ld:key%ld", (i * 7919) % 200, i % 100);
+        if (iniparser_getint(d, key, -1) != ((i * 7919) % 200) * 100 + i % 100)
+            n++;
+    }
+    return (void *)n;
+}
+#endif
+
+void test_iniparser_load_lazy(void)
+{
+    iniparser_options opts;
+    dictionary *ref, *d;
+    char *buf, *copy;
+    size_t len, k;
+    FILE *out;
+    long kb;
+#ifdef INITHREADS
+    pthread_t tids[4];
+    void *res;
+#endif
+
+    memset(&opts, 0, sizeof(opts));
+    opts.flags = INIPARSER_LAZY;
+    create_parts_ini_file(TMP_INI_PATH, 0);
+    buf = read_file(TMP_INI_PATH, &len);
+    ref = iniparser_load(TMP_INI_PATH);
+    TEST_ASSERT_NOT_NULL(ref);
+    for (k = 0 ; k < 2 ; k++) {
+        copy = NULL;
+        if (k == 0) {
+            d = iniparser_load_mmap(TMP_INI_PATH, &opts);
+        } else {
+            copy = (char*) malloc(len);
+            TEST_ASSERT_NOT_NULL(copy);
+            memcpy(copy, buf, len);
+            d = iniparser_load_buffer_insitu(copy, len, TMP_INI_PATH, &opts);
+        }
+        TEST_ASSERT_NOT_NULL(d);
+        /* Only the sections and the keys before them are loaded */
+        TEST_ASSERT_NOT_NULL(d->lazy);
+        TEST_ASSERT_EQUAL(701, d->n);
+        TEST_ASSERT_EQUAL(700, iniparser_getnsec(d));
+        TEST_ASSERT_EQUAL_STRING("sec000", iniparser_getsecname(d, 0));
+        TEST_ASSERT_EQUAL_STRING("before any section", iniparser_getstring(d, ":top", NULL));
+        /* A lookup parses the section of the key, every time it occurs */
+        TEST_ASSERT_EQUAL_STRING("11999", iniparser_getstring(d, "Sec099:Key2", NULL));
+        TEST_ASSERT_EQUAL_STRING("start of 11999 [not a section]",
+                                 iniparser_getstring(d, "sec099:multi", NULL));
+        TEST_ASSERT_EQUAL(706, d->n);
+        TEST_ASSERT_EQUAL(5, iniparser_getsecnkeys(d, "sec100"));
+        TEST_ASSERT_EQUAL(711, d->n);
+        TEST_ASSERT_EQUAL(-1, iniparser_getint(d, "sec101", -1));
+        TEST_ASSERT_EQUAL(716, d->n);
+        /* Dumping parses the rest, the entries are those of a full load */
+        out = tmpfile();
+        TEST_ASSERT_NOT_NULL(out);
+        iniparser_dump(d, out);
+        fclose(out);
+        TEST_ASSERT_EQUAL(0, ((ini_lazy*)d->lazy)->left);
+        TEST_ASSERT_NULL(((ini_lazy*)d->lazy)->ranges);
+        check_same_entries(ref, d, "lazy");
+        iniparser_freedict(d);
+        free(copy);
+    }
+    /* Setting a key keeps the keys of its section */
+    d = iniparser_load_mmap(TMP_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL(d);
+    TEST_ASSERT_EQUAL(0, iniparser_set(d, "sec200:key0", "new"));
+    TEST_ASSERT_EQUAL(5, iniparser_getsecnkeys(d, "sec200"));
+    TEST_ASSERT_EQUAL_STRING("new", iniparser_getstring(d, "sec200:key0", NULL));
+    iniparser_freedict(d);
+    iniparser_freedict(ref);
+    free(buf);
+
+    /* Errors are reported with the section, the load does not fail */
+    iniparser_set_error_callback(_error_callback);
+    create_parts_ini_file(TMP_INI_PATH, 1);
+    _last_error[0] = '\0';
+    d = iniparser_load_mmap(TMP_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL(d);
+    TEST_ASSERT_EQUAL_STRING("", _last_error);
+    TEST_ASSERT_EQUAL(5, iniparser_getsecnkeys(d, "sec098"));
+    TEST_ASSERT_EQUAL_STRING("", _last_error);
+    TEST_ASSERT_EQUAL(5, iniparser_getsecnkeys(d, "sec199"));
+    TEST_ASSERT_NOT_NULL(strstr(_last_error, "(50003)"));
+    TEST_ASSERT_NOT_NULL(strstr(_last_error, "this is not a key"));
+    iniparser_freedict(d);
+    iniparser_set_error_callback(NULL);
+
+    /* Looking a key up leaves the pages of the other sections shared */
+    create_short_values_ini_file(TMP_INI_PATH, 4 << 20);
+    d = iniparser_load_mmap(TMP_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL(d);
+    TEST_ASSERT_EQUAL(1703, iniparser_getint(d, "sec17:key3", -1));
+    kb = private_dirty_kb(d->ext);
+    if (kb >= 0)
+        TEST_ASSERT_LESS_THAN(512, kb);
+    iniparser_freedict(d);
+
+#ifdef INITHREADS
+    /* Several threads may look a lazy dictionary up at once */
+    d = iniparser_load_mmap(TMP_INI_PATH, &opts);
+    TEST_ASSERT_NOT_NULL(d);
+    for (k = 0 ; k < 4 ; k++)
+        TEST_ASSERT_EQUAL(0, pthread_create(&tids[k], NULL, lazy_lookups, d));
+    for (k = 0 ; k < 4 ; k++) {
+        TEST_ASSERT_EQUAL(0, pthread_join(tids[k], &res));
+        TEST_ASSERT_NULL(res);
+    }
+    /* Each section looked up was parsed once */
+    TEST_ASSERT_EQUAL(iniparser_getnsec(d) + 200 * 100, d->n);
+    iniparser_freedict(d);
+#endif
+    remove(TMP_INI_PATH);
+}
+
+void test_iniparser_load_filter(void)
+{
+    static const char text[] =
+        "top = 1\n"
+        "[Server]\nHost = a\nport = 80\n"
+        "[db]\nhost = b\nport = \"5432\"\nmulti = x \\\n[server]\n"
+        "[cache.main]\nsize = 1\n"
+        "[other]\nthis is not a key\nsize = 2\n"
+        "[cache.aux]\nsize = 3\n"
+        "[cache]\nsize = 4\n";
+    const char *filter[] = { "server", "cache.*", "db:h?st", NULL };
+    char lazy_pattern[] = "db:host";
+    const char *lazy_filter[] = { lazy_pattern, "*.main", NULL };
+    iniparser_options opts;
+    iniparser_parser *p;
+    dictionary *d[3];
+    char buf[sizeof(text)];
+    size_t i;
+
+    TEST_ASSERT_TRUE(ini_glob("cache.*", 7, "cache.main", 10, 0));
+    TEST_ASSERT_TRUE(ini_glob("cache.*", 7, "cache.", 6, 0));
+    TEST_ASSERT_FALSE(ini_glob("cache.*", 7, "cache", 5, 0));
+    TEST_ASSERT_TRUE(ini_glob("*a*b", 4, "xaayaab", 7, 0));
+    TEST_ASSERT_FALSE(ini_glob("*a*b", 4, "xaayaaba", 8, 0));
+    TEST_ASSERT_TRUE(ini_glob("S?rv*", 5, "server", 6, 1));
+    TEST_ASSERT_FALSE(ini_glob("S?rv*", 5, "server", 6, 0));
+    TEST_ASSERT_TRUE(ini_glob("", 0, "", 0, 0));
+
+    iniparser_set_error_callback(_error_callback);
+    _last_error[0] = '\0';
+    memset(&opts, 0, sizeof(opts));
+    opts.filter = filter;
+    d[0] = iniparser_load_buffer(text, sizeof(text) - 1, "filter", &opts);
+    memcpy(buf, text, sizeof(text));
+    d[1] = iniparser_load_buffer_insitu(buf, sizeof(text) - 1, "filter", &opts);
+    p = iniparser_parser_new("filter", &opts);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL(0, iniparser_feed(p, text, sizeof(text) - 1));
+    d[2] = iniparser_finish(p);
+    for (i = 0 ; i < 3 ; i++) {
+        TEST_ASSERT_NOT_NULL(d[i]);
+        /* Sections left out are not parsed, their errors are not reported */
+        TEST_ASSERT_EQUAL_STRING("", _last_error);
+        TEST_ASSERT_EQUAL(4, iniparser_getnsec(d[i]));
+        TEST_ASSERT_EQUAL_STRING("server", iniparser_getsecname(d[i], 0));
+        TEST_ASSERT_EQUAL_STRING("db", iniparser_getsecname(d[i], 1));
+        TEST_ASSERT_EQUAL_STRING("cache.main", iniparser_getsecname(d[i], 2));
+        TEST_ASSERT_EQUAL_STRING("cache.aux", iniparser_getsecname(d[i], 3));
+        TEST_ASSERT_EQUAL(2, iniparser_getsecnkeys(d[i], "server"));
+        TEST_ASSERT_EQUAL(1, iniparser_getsecnkeys(d[i], "db"));
+        TEST_ASSERT_EQUAL_STRING("b", iniparser_getstring(d[i], "db:host", NULL));
+        TEST_ASSERT_NULL(iniparser_getstring(d[i], "db:port", NULL));
+        TEST_ASSERT_EQUAL_STRING("3", iniparser_getstring(d[i], "cache.aux:size", NULL));
+        TEST_ASSERT_FALSE(iniparser_find_entry(d[i], "cache"));
+        TEST_ASSERT_FALSE(iniparser_find_entry(d[i], "other"));
+        TEST_ASSERT_NULL(iniparser_getstring(d[i], ":top", NULL));
+        TEST_ASSERT_EQUAL(9, d[i]->n);
+        iniparser_freedict(d[i]);
+    }
+
+    /* Patterns match as given in case-sensitive dictionaries */
+    opts.flags = INIPARSER_CASE_SENSITIVE;
+    d[0] = iniparser_load_buffer(text, sizeof(text) - 1, "filter", &opts);
+    TEST_ASSERT_NOT_NULL(d[0]);
+    TEST_ASSERT_EQUAL(3, iniparser_getnsec(d[0]));
+    TEST_ASSERT_FALSE(iniparser_find_entry(d[0], "Server"));
+    iniparser_freedict(d[0]);
+
+    /* A lazy dictionary keeps its own copy of the patterns */
+    opts.flags = INIPARSER_LAZY;
+    opts.filter = lazy_filter;
+    memcpy(buf, text, sizeof(text));
+    d[0] = iniparser_load_buffer_insitu(buf, sizeof(text) - 1, "filter", &opts);
+    TEST_ASSERT_NOT_NULL(d[0]);
+    lazy_pattern[0] = 'x';
+    TEST_ASSERT_EQUAL(2, iniparser_getnsec(d[0]));
+    TEST_ASSERT_EQUAL_STRING("b", iniparser_getstring(d[0], "db:host", NULL));
+    TEST_ASSERT_NULL(iniparser_getstring(d[0], "db:multi", NULL));
+    TEST_ASSERT_EQUAL_STRING("1", iniparser_getstring(d[0], "cache.main:size", NULL));
+    TEST_ASSERT_FALSE(iniparser_find_entry(d[0], "server"));
+    TEST_ASSERT_EQUAL_STRING("", _last_error);
+    iniparser_freedict(d[0]);
+    iniparser_set_error_callback(NULL);
+}
+
+#define TMP_DIR_PATH "ressources/tmp.d"
+
+/* Tool function writing a file of TMP_DIR_PATH */
+static void create_dir_file(const char *name, const char *contents)
+{
+    char path[64];
+
+    sprintf(path, "%s/%s", TMP_DIR_PATH, name);
+    ini = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(ini, path);
+    fputs(contents, ini);
+    fclose(ini);
+    ini = NULL;
+}
+
+void test_iniparser_load_many(void)
+{
+    static const unsigned threads[] = { 0, 1, 4, 16 };
+    static const char *names[] = {
+        "10-base.ini", "20-override.ini", "30-broken.ini", "40-last.ini",
+        "notes.txt", ".hidden.ini"
+    };
+    const char *paths[64];
+    char path[64 * 64];
+    int failed[64];
+    iniparser_options opts;
+    dictionary *ref;
+    size_t i, j;
+
+    TEST_ASSERT_EQUAL(0, mkdir(TMP_DIR_PATH, 0755));
+    TEST_ASSERT_EQUAL(0, mkdir(TMP_DIR_PATH "/sub.ini", 0755));
+    create_dir_file(names[0], "[Server]\nport = 80\nhost = base\n[db]\nname = main\n");
+    create_dir_file(names[1], "[server]\nport = 8080\n[cache]\nsize = 10\n");
+    create_dir_file(names[2], "[db]\nname = broken\nnot a key\n");
+    create_dir_file(names[3], "[DB]\nuser = admin\n");
+    create_dir_file(names[4], "not an ini file\n");
+    create_dir_file(names[5], "[server]\nport = 1\n");
+
+    /* Files sorted by name, later ones take precedence */
+    iniparser_set_error_callback(_error_callback);
+    memset(&opts, 0, sizeof(opts));
+    for (i = 0 ; i < sizeof(threads) / sizeof(threads[0]) ; i++) {
+        opts.threads = threads[i];
+        _last_error[0] = '\0';
+        dic = iniparser_load_dir(TMP_DIR_PATH, ".ini", &opts);
+        TEST_ASSERT_NOT_NULL(dic);
+        TEST_ASSERT_EQUAL_STRING("iniparser: syntax error in " TMP_DIR_PATH
+                                 "/30-broken.ini (3):\n-> not a key\n", _last_error);
+        TEST_ASSERT_EQUAL(8, dic->n);
+        TEST_ASSERT_EQUAL(8080, iniparser_getint(dic, "server:port", 0));
+        TEST_ASSERT_EQUAL_STRING("base", iniparser_getstring(dic, "server:host", NULL));
+        TEST_ASSERT_EQUAL_STRING("main", iniparser_getstring(dic, "db:name", NULL));
+        TEST_ASSERT_EQUAL_STRING("admin", iniparser_getstring(dic, "db:user", NULL));
+        TEST_ASSERT_EQUAL(10, iniparser_getint(dic, "cache:size", 0));
+        TEST_ASSERT_EQUAL(3, iniparser_getnsec(dic));
+        TEST_ASSERT_EQUAL_STRING("server", iniparser_getsecname(dic, 0));
+        TEST_ASSERT_EQUAL_STRING("db", iniparser_getsecname(dic, 1));
+        TEST_ASSERT_EQUAL_STRING("cache", iniparser_getsecname(dic, 2));
+        iniparser_freedict(dic);
+    }
+
+    /* Precedence follows the order of the paths, failures are flagged */
+    paths[0] = TMP_DIR_PATH "/20-override.ini";
+    paths[1] = TMP_DIR_PATH "/10-base.ini";
+    paths[2] = TMP_DIR_PATH "/missing.ini";
+    paths[3] = TMP_DIR_PATH "/30-broken.ini";
+    for (i = 0 ; i < sizeof(threads) / sizeof(threads[0]) ; i++) {
+        opts.threads = threads[i];
+        memset(failed, -1, sizeof(failed));
+        dic = iniparser_load_many(paths, 4, &opts, failed);
+        TEST_ASSERT_NOT_NULL(dic);
+        TEST_ASSERT_EQUAL_STRING("iniparser: syntax error in " TMP_DIR_PATH
+                                 "/30-broken.ini (3):\n-> not a key\n", _last_error);
+        TEST_ASSERT_EQUAL(0, failed[0]);
+        TEST_ASSERT_EQUAL(0, failed[1]);
+        TEST_ASSERT_EQUAL(1, failed[2]);
+        TEST_ASSERT_EQUAL(1, failed[3]);
+        TEST_ASSERT_EQUAL(80, iniparser_getint(dic, "server:port", 0));
+        TEST_ASSERT_EQUAL_STRING("main", iniparser_getstring(dic, "db:name", NULL));
+        TEST_ASSERT_EQUAL_STRING("server", iniparser_getsecname(dic, 0));
+        TEST_ASSERT_EQUAL_STRING("cache", iniparser_getsecname(dic, 1));
+        iniparser_freedict(dic);
+    }
+    dic = iniparser_load_many(NULL, 0, NULL, NULL);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->n);
+    iniparser_freedict(dic);
+    TEST_ASSERT_NULL(iniparser_load_dir(TMP_DIR_PATH "/missing", NULL, NULL));
+    TEST_ASSERT_EQUAL_STRING("iniparser: cannot open " TMP_DIR_PATH "/missing\n",
+                             _last_error);
+    iniparser_set_error_callback(NULL);
+    for (i = 0 ; i < sizeof(names) / sizeof(names[0]) ; i++) {
+        sprintf(path, "%s/%s", TMP_DIR_PATH, names[i]);
+        TEST_ASSERT_EQUAL(0, remove(path));
+    }
+    TEST_ASSERT_EQUAL(0, rmdir(TMP_DIR_PATH "/sub.ini"));
+
+    /* Many files: same dictionary as when merged one after the other */
+    for (i = 0 ; i < 64 ; i++) {
+        sprintf(path + i * 64, "%s/%02u.ini", TMP_DIR_PATH, (unsigned)i);
+        ini = fopen(path + i * 64, "w");
+        TEST_ASSERT_NOT_NULL(ini);
+        fprintf(ini, "[common]\nkey = %u\nfile%u = yes\n[file%u]\n",
+                (unsigned)i, (unsigned)i, (unsigned)i);
+        for (j = 0 ; j < 100 ; j++)
+            fprintf(ini, "key%u = %u\n", (unsigned)j, (unsigned)(i * j));
+        fclose(ini);
+        ini = NULL;
+        paths[i] = path + i * 64;
+    }
+    ref = dictionary_new(0);
+    TEST_ASSERT_NOT_NULL(ref);
+    for (i = 0 ; i < 64 ; i++) {
+        dic = iniparser_load(paths[i]);
+        TEST_ASSERT_NOT_NULL(dic);
+        TEST_ASSERT_EQUAL(0, dictionary_merge(ref, dic));
+        iniparser_freedict(dic);
+    }
+    for (i = 0 ; i < sizeof(threads) / sizeof(threads[0]) ; i++) {
+        opts.threads = threads[i];
+        dic = iniparser_load_dir(TMP_DIR_PATH, NULL, &opts);
+        TEST_ASSERT_NOT_NULL(dic);
+        check_same_order(ref, dic, "many files");
+        TEST_ASSERT_EQUAL(63, iniparser_getint(dic, "common:key", 0));
+        iniparser_freedict(dic);
+    }
+    dictionary_del(ref);
+    dic = NULL;
+    for (i = 0 ; i < 64 ; i++)
+        TEST_ASSERT_EQUAL(0, remove(paths[i]));
+    TEST_ASSERT_EQUAL(0, rmdir(TMP_DIR_PATH));
+}
+
+/* State of the callbacks of test_iniparser_parse_cb() */
+typedef struct {
+    dictionary *d;
+    int sections;
+    int keys;
+    int errors;
+    int last_error;
+    int stop_at;
+} parse_state;
+
+static int on_section(const char *name, size_t len, void *user)
+{
+    parse_state *st = (parse_state *) user;
+
+    st->sections++;
+    if (dictionary_set_lower(st->d, name, len, NULL, 0) < 0)
+        return -2;
+    return st->sections == st->stop_at ? 42 : 0;
+}
+
+static int on_keyvalue(const char *section, size_t seclen,
+                       const char *key, size_t keylen,
+                       const char *val, size_t vallen, void *user)
+{
+    parse_state *st = (parse_state *) user;
+    char *tmp = (char *) malloc(seclen + 1 + keylen);
+    int ret;
+
+    TEST_ASSERT_NOT_NULL(tmp);
+    st->keys++;
+    memcpy(tmp, section, seclen);
+    tmp[seclen] = ':';
+    memcpy(tmp + seclen + 1, key, keylen);
+    ret = dictionary_set_lower(st->d, tmp, seclen + 1 + keylen, val, vallen);
+    free(tmp);
+    return ret < 0 ? -2 : 0;
+}
+
+static int on_error(const char *line, int lineno, void *user)
+{
+    parse_state *st = (parse_state *) user;
+
+    (void) line;
+    st->errors++;
+    st->last_error = lineno;
+    return 0;
+}
+
+void test_iniparser_parse_cb(void)
+{
+    static const char *dirs[] = { GOOD_INI_PATH, BAD_INI_PATH };
+    struct dirent *curr;
+    char ini_path[276];
+    parse_state st;
+    dictionary *ref;
+    size_t i;
+    int ret;
+
+    iniparser_set_error_callback(_error_callback);
+    /* Same entries as iniparser_load(), which fails on syntax errors */
+    for (i = 0 ; i < sizeof(dirs) / sizeof(dirs[0]) ; i++) {
+        dir = opendir(dirs[i]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(dir, dirs[i]);
+        while ((curr = readdir(dir)) != NULL) {
+            if (strstr(curr->d_name, ".ini") == NULL)
+                continue;
+            sprintf(ini_path, "%s/%s", dirs[i], curr->d_name);
+            ref = iniparser_load(ini_path);
+            memset(&st, 0, sizeof(st));
+            st.d = dictionary_new(0);
+            ini = fopen(ini_path, "r");
+            TEST_ASSERT_NOT_NULL_MESSAGE(ini, ini_path);
+            ret = iniparser_parse_cb(ini, ini_path, on_section, on_keyvalue,
+                                     on_error, &st);
+            fclose(ini);
+            ini = NULL;
+            if (ret == 0 && st.errors == 0) {
+                TEST_ASSERT_NOT_NULL_MESSAGE(ref, ini_path);
+                check_same_entries(ref, st.d, ini_path);
+            } else {
+                TEST_ASSERT_EQUAL_PTR_MESSAGE(NULL, ref, ini_path);
+            }
+            dictionary_del(ref);
+            dictionary_del(st.d);
+        }
+        closedir(dir);
+    }
+    dir = NULL;
+    iniparser_set_error_callback(NULL);
+
+    /* Spans are passed as written, errors with their line number */
+    ini = fopen(TMP_INI_PATH, "w");
+    TEST_ASSERT_NOT_NULL(ini);
+    fprintf(ini, "top = level\n"
+                 "[First]\n"
+                 "Key = \"Quoted value\"\n"
+                 "not a key\n"
+                 "[Second]\n"
+                 "other = 1\n"
+                 "[Third]\n"
+                 "last = 2\n");
+    fclose(ini);
+    memset(&st, 0, sizeof(st));
+    st.d = dictionary_new_flags(0, DICTIONARY_CASE_SENSITIVE, NULL);
+    ini = fopen(TMP_INI_PATH, "r");
+    TEST_ASSERT_NOT_NULL(ini);
+    TEST_ASSERT_EQUAL(0, iniparser_parse_cb(ini, TMP_INI_PATH, on_section,
+                                            on_keyvalue, on_error, &st));
+    fclose(ini);
+    TEST_ASSERT_EQUAL(3, st.sections);
+    TEST_ASSERT_EQUAL(4, st.keys);
+    TEST_ASSERT_EQUAL(1, st.errors);
+    TEST_ASSERT_EQUAL(4, st.last_error);
+    TEST_ASSERT_EQUAL_STRING("level", dictionary_get(st.d, ":top", NULL));
+    TEST_ASSERT_EQUAL_STRING("Quoted value", dictionary_get(st.d, "First:Key", NULL));
+    dictionary_del(st.d);
+
+    /* A callback returning non-zero stops the parsing */
+    memset(&st, 0, sizeof(st));
+    st.d = dictionary_new(0);
+    st.stop_at = 2;
+    ini = fopen(TMP_INI_PATH, "r");
+    TEST_ASSERT_NOT_NULL(ini);
+    TEST_ASSERT_EQUAL(42, iniparser_parse_cb(ini, TMP_INI_PATH, on_section,
+                                             on_keyvalue, on_error, &st));
+    fclose(ini);
+    TEST_ASSERT_EQUAL(2, st.sections);
+    TEST_ASSERT_EQUAL(2, st.keys);
+    TEST_ASSERT_FALSE(iniparser_find_entry(st.d, "second:other"));
+    dictionary_del(st.d);
+
+    /* No callback at all only checks that the file can be parsed */
+    ini = fopen(TMP_INI_PATH, "r");
+    TEST_ASSERT_NOT_NULL(ini);
+    TEST_ASSERT_EQUAL(0, iniparser_parse_cb(ini, TMP_INI_PATH, NULL, NULL, NULL, NULL));
+    fclose(ini);
+    ini = NULL;
+    remove(TMP_INI_PATH);
+
+    /* Long lines are passed whole */
+    create_long_line_ini_file(TMP_INI_PATH, 100000, 1);
+    memset(&st, 0, sizeof(st));
+    st.d = dictionary_new(0);
+    ini = fopen(TMP_INI_PATH, "r");
+    TEST_ASSERT_NOT_NULL(ini);
+    TEST_ASSERT_EQUAL(0, iniparser_parse_cb(ini, TMP_INI_PATH, on_section,
+                                            on_keyvalue, on_error, &st));
+    fclose(ini);
+    ini = NULL;
+    remove(TMP_INI_PATH);
+    TEST_ASSERT_EQUAL(1, st.keys);
+    TEST_ASSERT_EQUAL(100000 - 2, strlen(dictionary_get(st.d, ":a", "")));
+    dictionary_del(st.d);
+    TEST_ASSERT_EQUAL(-1, iniparser_parse_cb(NULL, "null", NULL, NULL, NULL, NULL));
+}
+
+/* Tool function feeding a buffer to a push parser in chunks of chunk bytes */
+static dictionary *feed_chunks(const char *buf, size_t len, size_t chunk, const char *name)
+{
+    iniparser_parser *p;
+    size_t i, n;
+
+    p = iniparser_parser_new(name, NULL);
+    TEST_ASSERT_NOT_NULL(p);
+    for (i = 0 ; i < len ; i += n) {
+        n = len - i < chunk ? len - i : chunk;
+        iniparser_feed(p, buf + i, n);
+    }
+    return iniparser_finish(p);
+}
+
+void test_iniparser_feed(void)
+{
+    static const char *dirs[] = { GOOD_INI_PATH, BAD_INI_PATH };
+    static const size_t chunks[] = { 1, 2, 3, 7, 64, 1000, 5000 };
+    static const char text[] = "[Section]\n"
+                               "quoted = \"a \\\"quoted\\\" value ; not a comment\"\n"
+                               "multi = first \\\n"
+                               "second \\\n"
+                               "third\n"
+                               "last = no newline";
+    struct dirent *curr;
+    char ini_path[276];
+    iniparser_parser *p;
+    dictionary *ref;
+    char *buf;
+    size_t len, i, j;
+
+    iniparser_set_error_callback(_error_callback);
+    /* Same result as iniparser_load_buffer(), whatever the chunks */
+    for (i = 0 ; i < sizeof(dirs) / sizeof(dirs[0]) ; i++) {
+        dir = opendir(dirs[i]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(dir, dirs[i]);
+        while ((curr = readdir(dir)) != NULL) {
+            if (strstr(curr->d_name, ".ini") == NULL)
+                continue;
+            sprintf(ini_path, "%s/%s", dirs[i], curr->d_name);
+            buf = read_file(ini_path, &len);
+            ref = iniparser_load_buffer(buf, len, ini_path, NULL);
+            for (j = 0 ; j < sizeof(chunks) / sizeof(chunks[0]) ; j++) {
+                dic = feed_chunks(buf, len, chunks[j], ini_path);
+                if (ref == NULL) {
+                    TEST_ASSERT_EQUAL_PTR_MESSAGE(NULL, dic, ini_path);
+                } else {
+                    TEST_ASSERT_NOT_NULL_MESSAGE(dic, ini_path);
+                    check_same_entries(ref, dic, ini_path);
+                }
+                dictionary_del(dic);
+            }
+            dictionary_del(ref);
+            free(buf);
+        }
+        closedir(dir);
+    }
+    dir = NULL;
+
+    /* Quoted values and continuations split at every byte */
+    ref = iniparser_load_buffer(text, sizeof(text) - 1, "text", NULL);
+    TEST_ASSERT_NOT_NULL(ref);
+    TEST_ASSERT_EQUAL_STRING("a \"quoted\" value ; not a comment",
+                             iniparser_getstring(ref, "section:quoted", NULL));
+    TEST_ASSERT_EQUAL_STRING("first second third",
+                             iniparser_getstring(ref, "section:multi", NULL));
+    for (i = 1 ; i < sizeof(text) - 1 ; i++) {
+        p = iniparser_parser_new("text", NULL);
+        TEST_ASSERT_NOT_NULL(p);
+        TEST_ASSERT_EQUAL(0, iniparser_feed(p, text, i));
+        TEST_ASSERT_EQUAL(0, iniparser_feed(p, NULL, 0));
+        TEST_ASSERT_EQUAL(0, iniparser_feed(p, text + i, sizeof(text) - 1 - i));
+        dic = iniparser_finish(p);
+        TEST_ASSERT_NOT_NULL(dic);
+        check_same_entries(ref, dic, "text");
+        dictionary_del(dic);
+    }
+    dictionary_del(ref);
+
+    iniparser_set_error_callback(NULL);
+
+    /* Long lines, fed in small chunks */
+    len = 100000;
+    buf = (char*) malloc(len);
+    TEST_ASSERT_NOT_NULL(buf);
+    memcpy(buf, "a=", 2);
+    memset(buf + 2, 'x', len - 3);
+    buf[len - 1] = '\n';
+    p = iniparser_parser_new("long", NULL);
+    TEST_ASSERT_NOT_NULL(p);
+    for (i = 0 ; i < len ; i += 1000)
+        TEST_ASSERT_EQUAL(0, iniparser_feed(p, buf + i, 1000));
+    TEST_ASSERT_EQUAL(0, iniparser_feed(p, "b=1", 3));
+    dic = iniparser_finish(p);
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(len - 3, strlen(iniparser_getstring(dic, ":a", "")));
+    TEST_ASSERT_EQUAL_STRING("1", iniparser_getstring(dic, ":b", NULL));
+    dictionary_del(dic);
+    free(buf);
+
+    /* Empty input, and parsers dropped before the end */
+    dic = iniparser_finish(iniparser_parser_new(NULL, NULL));
+    TEST_ASSERT_NOT_NULL(dic);
+    TEST_ASSERT_EQUAL(0, dic->n);
+    dictionary_del(dic);
+    dic = NULL;
+    p = iniparser_parser_new("dropped", NULL);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL(0, iniparser_feed(p, text, 20));
+    iniparser_parser_free(p);
+    iniparser_parser_free(NULL);
+    TEST_ASSERT_NULL(iniparser_finish(NULL));
+    TEST_ASSERT_EQUAL(-1, iniparser_feed(NULL, text, 1));
+}
+
 void test_iniparser_misformed(void)
 {
     int ret;